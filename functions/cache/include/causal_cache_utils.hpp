@@ -95,8 +95,8 @@ struct VectorClockHash {
   std::size_t operator()(const VectorClock& vc) const {
     std::size_t result = std::hash<int>()(-1);
     for (const auto& pair : vc.reveal()) {
-      result = result ^ std::hash<string>()(pair.first) ^
-               std::hash<unsigned>()(pair.second.reveal());
+      result = result ^ std::hash<unsigned>()(pair.first) ^
+               std::hash<unsigned>()(pair.second);
     }
     return result;
   }
@@ -17,28 +17,15 @@
 unsigned causal_comparison(
     const std::shared_ptr<CrossCausalLattice<SetLattice<string>>>& lhs,
     const std::shared_ptr<CrossCausalLattice<SetLattice<string>>>& rhs) {
-  VectorClock lhs_prev_vc = lhs->reveal().vector_clock;
-  VectorClock lhs_vc = lhs->reveal().vector_clock;
-  VectorClock rhs_vc = rhs->reveal().vector_clock;
-  lhs_vc.merge(rhs_vc);
-  if (lhs_prev_vc == lhs_vc) {
-    return kCausalGreaterOrEqual;
-  } else if (lhs_vc == rhs_vc) {
-    return kCausalLess;
-  } else {
-    return kCausalConcurrent;
-  }
+  return vector_clock_comparison(lhs->reveal().vector_clock,
+                                 rhs->reveal().vector_clock);
 }
 
 unsigned vector_clock_comparison(const VectorClock& lhs,
                                  const VectorClock& rhs) {
-  VectorClock lhs_prev_vc = lhs;
-  VectorClock lhs_vc = lhs;
-  VectorClock rhs_vc = rhs;
-  lhs_vc.merge(rhs_vc);
-  if (lhs_prev_vc == lhs_vc) {
+  if (lhs.dominates(rhs)) {
     return kCausalGreaterOrEqual;
-  } else if (lhs_vc == rhs_vc) {
+  } else if (rhs.dominates(lhs)) {
     return kCausalLess;
   } else {
     return kCausalConcurrent;
@@ -289,7 +276,8 @@ void respond_to_client(
       auto ptr = vk->mutable_vector_clock();
       for (const auto& client_version_pair :
            pair.second->reveal().vector_clock.reveal()) {
-        (*ptr)[client_version_pair.first] = client_version_pair.second.reveal();
+        (*ptr)[NodeIds::name(client_version_pair.first)] =
+            client_version_pair.second;
       }
     }
   }
@@ -107,8 +107,8 @@ void versioned_key_response_handler(
             auto ptr = vk->mutable_vector_clock();
             for (const auto& client_version_pair :
                  pair.second->reveal().vector_clock.reveal()) {
-              (*ptr)[client_version_pair.first] =
-                  client_version_pair.second.reveal();
+              (*ptr)[NodeIds::name(client_version_pair.first)] =
+                  client_version_pair.second;
             }
           }
 
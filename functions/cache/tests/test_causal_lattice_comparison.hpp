@@ -78,7 +78,7 @@ TEST_F(CausalCacheTest, CausalMerge) {
   map<string, int> result;
 
   for (const auto& pair : ccl3->reveal().vector_clock.reveal()) {
-    result.insert(std::make_pair(pair.first, pair.second.reveal()));
+    result.insert(std::make_pair(NodeIds::name(pair.first), pair.second));
   }
   EXPECT_THAT(result, testing::UnorderedElementsAreArray(expected));
   EXPECT_EQ(ccl1.use_count(), 1);
@@ -16,9 +16,11 @@
 #define INCLUDE_COMMON_HPP_
 
 #include <algorithm>
+#include <array>
 #include <sstream>
 
 #include "kvs.pb.h"
+#include "lattices/counter_lattice.hpp"
 #include "lattices/cross_causal_lattice.hpp"
 #include "lattices/lww_pair_lattice.hpp"
 #include "lattices/vector_clock_pair_lattice.hpp"
@@ -43,6 +45,21 @@ inline void split(const string& s, char delim, vector<string>& elems) {
   }
 }
 
+// returns the smallest key that is greater than every key starting with the
+// given prefix, or an empty key if there is none
+inline string prefix_end(string prefix) {
+  while (!prefix.empty() &&
+         static_cast<unsigned char>(prefix.back()) == 0xff) {
+    prefix.pop_back();
+  }
+
+  if (!prefix.empty()) {
+    prefix.back() = static_cast<char>(prefix.back() + 1);
+  }
+
+  return prefix;
+}
+
 // form the timestamp given a time and a thread id
 inline unsigned long long get_time() {
   return std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -102,27 +119,34 @@ inline void prepare_put_tuple(KeyRequest& req, Key key,
   tp->set_payload(std::move(payload));
 }
 
-inline string serialize(const LWWPairLattice<string>& l) {
-  LWWValue lww_value;
-  lww_value.set_timestamp(l.reveal().timestamp);
-  lww_value.set_value(l.reveal().value);
-
-  string serialized;
-  lww_value.SerializeToString(&serialized);
-  return serialized;
+inline void append_varint(string& buf, unsigned long long v) {
+  while (v >= 0x80) {
+    buf.push_back(static_cast<char>((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  buf.push_back(static_cast<char>(v));
 }
 
+// writes the wire format of an LWWValue directly, so that the value is copied
+// once rather than into a message and then out of it
 inline string serialize(const unsigned long long& timestamp,
                         const string& value) {
-  LWWValue lww_value;
-  lww_value.set_timestamp(timestamp);
-  lww_value.set_value(value);
-
   string serialized;
-  lww_value.SerializeToString(&serialized);
+  serialized.reserve(value.size() + 22);
+
+  serialized.push_back(static_cast<char>((1 << 3) | 0));  // timestamp, varint
+  append_varint(serialized, timestamp);
+  serialized.push_back(static_cast<char>((2 << 3) | 2));  // value, bytes
+  append_varint(serialized, value.size());
+  serialized += value;
+
   return serialized;
 }
 
+inline string serialize(const LWWPairLattice<string>& l) {
+  return serialize(l.reveal().timestamp, l.reveal().value);
+}
+
 inline string serialize(const SetLattice<string>& l) {
   SetValue set_value;
   for (const string& val : l.reveal()) {
@@ -148,6 +172,17 @@ inline string serialize(const OrderedSetLattice<string>& l) {
   return serialized;
 }
 
+inline string serialize(const SortedSetLattice<string>& l) {
+  SetValue set_value;
+  for (const string& val : l.reveal()) {
+    set_value.add_values(val);
+  }
+
+  string serialized;
+  set_value.SerializeToString(&serialized);
+  return serialized;
+}
+
 inline string serialize(const set<string>& set) {
   SetValue set_value;
   for (const string& val : set) {
@@ -164,7 +199,7 @@ inline string serialize(const CausalPairLattice<SetLattice<string>>& l) {
   auto ptr = causal_value.mutable_vector_clock();
   // serialize vector clock
   for (const auto& pair : l.reveal().vector_clock.reveal()) {
-    (*ptr)[pair.first] = pair.second.reveal();
+    (*ptr)[NodeIds::name(pair.first)] = pair.second;
   }
   // serialize values
   for (const string& val : l.reveal().value.reveal()) {
@@ -181,7 +216,7 @@ inline string serialize(const CrossCausalLattice<SetLattice<string>>& l) {
   auto ptr = cross_causal_value.mutable_vector_clock();
   // serialize vector clock
   for (const auto& pair : l.reveal().vector_clock.reveal()) {
-    (*ptr)[pair.first] = pair.second.reveal();
+    (*ptr)[NodeIds::name(pair.first)] = pair.second;
   }
   // serialize dependency
   for (const auto& pair : l.reveal().dependency.reveal()) {
@@ -189,7 +224,7 @@ inline string serialize(const CrossCausalLattice<SetLattice<string>>& l) {
     dep->set_key(pair.first);
     auto vc_ptr = dep->mutable_vector_clock();
     for (const auto& vc_pair : pair.second.reveal()) {
-      (*vc_ptr)[vc_pair.first] = vc_pair.second.reveal();
+      (*vc_ptr)[NodeIds::name(vc_pair.first)] = vc_pair.second;
     }
   }
   // serialize values
@@ -202,12 +237,49 @@ inline string serialize(const CrossCausalLattice<SetLattice<string>>& l) {
   return serialized;
 }
 
+inline string serialize(const GCounterLattice& l) {
+  CounterValue counter_value;
+  auto ptr = counter_value.mutable_increments();
+  for (const auto& pair : l.reveal()) {
+    (*ptr)[NodeIds::name(pair.first)] = pair.second;
+  }
+
+  string serialized;
+  counter_value.SerializeToString(&serialized);
+  return serialized;
+}
+
+inline string serialize(const PNCounterLattice& l) {
+  CounterValue counter_value;
+  auto increments = counter_value.mutable_increments();
+  for (const auto& pair : l.reveal().increments.reveal()) {
+    (*increments)[NodeIds::name(pair.first)] = pair.second;
+  }
+  auto decrements = counter_value.mutable_decrements();
+  for (const auto& pair : l.reveal().decrements.reveal()) {
+    (*decrements)[NodeIds::name(pair.first)] = pair.second;
+  }
+
+  string serialized;
+  counter_value.SerializeToString(&serialized);
+  return serialized;
+}
+
+inline string serialize_increment(long long amount) {
+  CounterIncrement increment;
+  increment.set_amount(amount);
+
+  string serialized;
+  increment.SerializeToString(&serialized);
+  return serialized;
+}
+
 inline LWWPairLattice<string> deserialize_lww(const string& serialized) {
   LWWValue lww;
   lww.ParseFromString(serialized);
 
-  return LWWPairLattice<string>(
-      TimestampValuePair<string>(lww.timestamp(), lww.value()));
+  return LWWPairLattice<string>(TimestampValuePair<string>(
+      lww.timestamp(), std::move(*lww.mutable_value())));
 }
 
 inline SetLattice<string> deserialize_set(const string& serialized) {
@@ -216,11 +288,11 @@ inline SetLattice<string> deserialize_set(const string& serialized) {
 
   set<string> result;
 
-  for (const string& value : s.values()) {
-    result.insert(value);
+  for (string& value : *s.mutable_values()) {
+    result.insert(std::move(value));
   }
 
-  return SetLattice<string>(result);
+  return SetLattice<string>(std::move(result));
 }
 
 inline OrderedSetLattice<string> deserialize_ordered_set(
@@ -228,10 +300,10 @@ inline OrderedSetLattice<string> deserialize_ordered_set(
   SetValue s;
   s.ParseFromString(serialized);
   ordered_set<string> result;
-  for (const string& value : s.values()) {
-    result.insert(value);
+  for (string& value : *s.mutable_values()) {
+    result.insert(std::move(value));
   }
-  return OrderedSetLattice<string>(result);
+  return OrderedSetLattice<string>(std::move(result));
 }
 
 inline CausalValue deserialize_causal(const string& serialized) {
@@ -248,6 +320,31 @@ inline CrossCausalValue deserialize_cross_causal(const string& serialized) {
   return cross_causal;
 }
 
+inline GCounterLattice deserialize_gcounter(const string& serialized) {
+  CounterValue counter_value;
+  counter_value.ParseFromString(serialized);
+
+  GCounterLattice result;
+  for (const auto& pair : counter_value.increments()) {
+    result.insert(pair.first, pair.second);
+  }
+  return result;
+}
+
+inline PNCounterLattice deserialize_pncounter(const string& serialized) {
+  CounterValue counter_value;
+  counter_value.ParseFromString(serialized);
+
+  PNCounterPair p;
+  for (const auto& pair : counter_value.increments()) {
+    p.increments.insert(pair.first, pair.second);
+  }
+  for (const auto& pair : counter_value.decrements()) {
+    p.decrements.insert(pair.first, pair.second);
+  }
+  return PNCounterLattice(std::move(p));
+}
+
 inline VectorClockValuePair<SetLattice<string>> to_vector_clock_value_pair(
     const CausalValue& cv) {
   VectorClockValuePair<SetLattice<string>> p;
@@ -271,7 +368,7 @@ inline CrossCausalPayload<SetLattice<string>> to_cross_causal_payload(
     for (const auto& pair : dep.vector_clock()) {
       vc.insert(pair.first, pair.second);
     }
-    p.dependency.insert(dep.key(), vc);
+    p.dependency.insert(dep.key(), std::move(vc));
   }
   for (auto& val : ccv.values()) {
     p.value.insert(std::move(val));
@@ -279,9 +376,148 @@ inline CrossCausalPayload<SetLattice<string>> to_cross_causal_payload(
   return p;
 }
 
-struct lattice_type_hash {
-  std::size_t operator()(const LatticeType& lt) const {
-    return std::hash<string>()(LatticeType_Name(lt));
+// merge_serialized merges a serialized value straight into a lattice: the
+// elements are moved out of the parsed message, rather than copied into a
+// temporary lattice and then copied again by the merge
+inline void merge_serialized(LWWPairLattice<string>& l,
+                             const string& serialized) {
+  LWWValue lww;
+  lww.ParseFromString(serialized);
+  l.merge(lww.timestamp(), std::move(*lww.mutable_value()));
+}
+
+inline void merge_serialized(SetLattice<string>& l, const string& serialized) {
+  SetValue s;
+  s.ParseFromString(serialized);
+
+  for (string& value : *s.mutable_values()) {
+    l.insert(std::move(value));
+  }
+}
+
+inline void merge_serialized(OrderedSetLattice<string>& l,
+                             const string& serialized) {
+  SetValue s;
+  s.ParseFromString(serialized);
+
+  for (string& value : *s.mutable_values()) {
+    l.insert(std::move(value));
+  }
+}
+
+// the parsed elements are sorted once and merged in a single pass
+inline void merge_serialized(SortedSetLattice<string>& l,
+                             const string& serialized) {
+  SetValue s;
+  s.ParseFromString(serialized);
+
+  vector<string> values;
+  values.reserve(s.values_size());
+  for (string& value : *s.mutable_values()) {
+    values.push_back(std::move(value));
+  }
+
+  l.merge(std::move(values));
+}
+
+inline void merge_serialized(CausalPairLattice<SetLattice<string>>& l,
+                             const string& serialized) {
+  CausalValue causal;
+  causal.ParseFromString(serialized);
+
+  VectorClock vector_clock;
+  for (const auto& pair : causal.vector_clock()) {
+    vector_clock.insert(pair.first, pair.second);
+  }
+
+  l.merge(vector_clock,
+          std::make_move_iterator(causal.mutable_values()->begin()),
+          std::make_move_iterator(causal.mutable_values()->end()));
+}
+
+inline void merge_serialized(CrossCausalLattice<SetLattice<string>>& l,
+                             const string& serialized) {
+  CrossCausalValue cross_causal;
+  cross_causal.ParseFromString(serialized);
+
+  VectorClock vector_clock;
+  for (const auto& pair : cross_causal.vector_clock()) {
+    vector_clock.insert(pair.first, pair.second);
+  }
+
+  MapLattice<Key, VectorClock> dependency;
+  for (const auto& dep : cross_causal.deps()) {
+    VectorClock vc;
+    for (const auto& pair : dep.vector_clock()) {
+      vc.insert(pair.first, pair.second);
+    }
+    dependency.insert(dep.key(), vc);
+  }
+
+  l.merge(vector_clock, dependency,
+          std::make_move_iterator(cross_causal.mutable_values()->begin()),
+          std::make_move_iterator(cross_causal.mutable_values()->end()));
+}
+
+inline void merge_serialized(GCounterLattice& l, const string& serialized) {
+  l.merge(deserialize_gcounter(serialized));
+}
+
+inline void merge_serialized(PNCounterLattice& l, const string& serialized) {
+  l.merge(deserialize_pncounter(serialized));
+}
+
+// LatticeTypeMap maps lattice types to values. Lattice types are small,
+// dense enum values, so a lookup indexes a fixed array instead of hashing;
+// types outside of the enum all share one slot that is never reported as set.
+// Only set() gives a type a value, so looking a type up never adds it.
+template <typename V>
+class LatticeTypeMap {
+  std::array<V, LatticeType_ARRAYSIZE> values_;
+  std::array<bool, LatticeType_ARRAYSIZE> set_;
+  V unknown_;
+
+  static bool in_range(LatticeType type) {
+    return static_cast<unsigned>(type) <
+           static_cast<unsigned>(LatticeType_ARRAYSIZE);
+  }
+
+ public:
+  LatticeTypeMap() : values_(), set_(), unknown_() {}
+
+  // gives a type a value; values for types outside of the enum are dropped
+  void set(LatticeType type, V value) {
+    if (!in_range(type)) {
+      return;
+    }
+
+    values_[type] = std::move(value);
+    set_[type] = true;
+  }
+
+  // the value of a type, or a default value if it has none
+  const V& at(LatticeType type) const {
+    return in_range(type) ? values_[type] : unknown_;
+  }
+
+  // the value of a type, or nullptr if it has none
+  const V* find(LatticeType type) const {
+    return contains(type) ? &values_[type] : nullptr;
+  }
+
+  bool contains(LatticeType type) const {
+    return in_range(type) && set_[type];
+  }
+
+  // the types that have been given a value, in enum order
+  vector<LatticeType> types() const {
+    vector<LatticeType> result;
+    for (int i = 0; i < LatticeType_ARRAYSIZE; i++) {
+      if (set_[i]) {
+        result.push_back(static_cast<LatticeType>(i));
+      }
+    }
+    return result;
   }
 };
 
@@ -97,6 +97,22 @@ class KvsAsyncClient : public KvsAsyncClientInterface {
     return request.request_id();
   }
 
+  /**
+   * Issue an async INCREMENT request to the KVS for a counter (GCOUNTER or
+   * PNCOUNTER) value.
+   */
+  string increment_async(const Key& key, long long amount,
+                         LatticeType lattice_type) {
+    KeyRequest request;
+    KeyTuple* tuple = prepare_data_request(request, key);
+    request.set_type(RequestType::INCREMENT);
+    tuple->set_lattice_type(lattice_type);
+    tuple->set_payload(serialize_increment(amount));
+
+    try_request(request);
+    return request.request_id();
+  }
+
   /**
    * Issue an async GET request to the KVS.
    */
@@ -490,7 +506,8 @@ class KvsAsyncClient : public KvsAsyncClientInterface {
     KeyTuple* tp = resp.add_tuples();
     tp->set_key(req.tuples(0).key());
 
-    if (req.type() == RequestType::PUT) {
+    if (req.type() == RequestType::PUT ||
+        req.type() == RequestType::INCREMENT) {
       tp->set_lattice_type(req.tuples(0).lattice_type());
       tp->set_payload(req.tuples(0).payload());
     }
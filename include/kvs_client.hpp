@@ -21,6 +21,9 @@
 #include "threads.hpp"
 #include "types.hpp"
 
+// the maximum number of keys sent in a single bulk PUT or address request
+const unsigned kBulkRequestSize = 1000;
+
 class KvsClient {
  public:
   /**
@@ -145,6 +148,33 @@ class KvsClient {
     return !is_error_response(response);
   }
 
+  /**
+   * Issue an INCREMENT request to the KVS for a counter value.
+   *
+   * The amount is added to the counter by the server, so there is no need to
+   * read the counter first, and concurrent increments are never lost. The
+   * lattice type is either GCOUNTER (whose amounts cannot be negative) or
+   * PNCOUNTER. Unlike a PUT, an INCREMENT is not idempotent: one that is
+   * retried after its response was lost may be counted twice. Since no
+   * trial_limit is specified, we use a default value of 10.
+   */
+  bool increment(Key key, long long amount, LatticeType lattice_type) {
+    return increment(key, amount, lattice_type, 10);
+  }
+
+  bool increment(Key key, long long amount, LatticeType lattice_type,
+                 unsigned trial_limit) {
+    KeyRequest request;
+    KeyTuple* tuple = prepare_data_request(request, key);
+    request.set_type(RequestType::INCREMENT);
+    tuple->set_lattice_type(lattice_type);
+    tuple->set_payload(serialize_increment(amount));
+
+    KeyResponse response = try_request(request, trial_limit);
+
+    return !is_error_response(response) && response.tuples(0).error() == 0;
+  }
+
   /**
    * Issue a durable PUT request to the KVS with a last-writer-wins value.
    *
@@ -227,6 +257,59 @@ class KvsClient {
     return responses.size() != 0;
   }
 
+  /**
+   * Load a batch of last-writer-wins values into the KVS.
+   *
+   * The keys are grouped by the worker thread that stores them, and each
+   * worker is sent a few large requests rather than one request per key. We
+   * return the number of keys that could not be stored. Since no trial_limit
+   * is specified, we use a default value of 10.
+   */
+  unsigned put_bulk(
+      const vector<std::pair<Key, LWWPairLattice<string>>>& values) {
+    return put_bulk(values, 10);
+  }
+
+  /**
+   * Load a batch of last-writer-wins values into the KVS.
+   *
+   * The keys are grouped by the worker thread that stores them, and each
+   * worker is sent a few large requests rather than one request per key. We
+   * return the number of keys that could not be stored. Keys that fail are
+   * retried up to trial_limit times.
+   */
+  unsigned put_bulk(
+      const vector<std::pair<Key, LWWPairLattice<string>>>& values,
+      unsigned trial_limit) {
+    vector<KeyTuple> tuples(values.size());
+    for (unsigned i = 0; i < values.size(); i++) {
+      tuples[i].set_key(values[i].first);
+      tuples[i].set_lattice_type(LatticeType::LWW);
+      tuples[i].set_payload(serialize(values[i].second));
+    }
+
+    return try_bulk_request(tuples, trial_limit);
+  }
+
+  /**
+   * Load a batch of set values into the KVS; see the last-writer-wins version
+   * of put_bulk.
+   */
+  unsigned put_bulk(const vector<std::pair<Key, SetLattice<string>>>& values) {
+    return put_bulk(values, 10);
+  }
+  unsigned put_bulk(const vector<std::pair<Key, SetLattice<string>>>& values,
+                    unsigned trial_limit) {
+    vector<KeyTuple> tuples(values.size());
+    for (unsigned i = 0; i < values.size(); i++) {
+      tuples[i].set_key(values[i].first);
+      tuples[i].set_lattice_type(LatticeType::SET);
+      tuples[i].set_payload(serialize(values[i].second));
+    }
+
+    return try_bulk_request(tuples, trial_limit);
+  }
+
   /**
    * Issue a GET request to the KVS for a last-writer-wins value.
    *
@@ -419,6 +502,37 @@ class KvsClient {
     return deserialize_ordered_set(rtuple.payload());
   }
 
+  /**
+   * Issue a GET request to the KVS for a counter value.
+   *
+   * We return the value of the counter, or 0 if the key does not exist or no
+   * worker threads are contactable from our client. Since no trial_limit is
+   * specified, we use a default value of 10.
+   */
+  long long get_counter(Key key) { return get_counter(key, 10); }
+
+  long long get_counter(Key key, unsigned trial_limit) {
+    KeyRequest request;
+    prepare_data_request(request, key);
+    request.set_type(RequestType::GET);
+
+    KeyResponse response = try_request(request, trial_limit);
+
+    if (is_error_response(response)) {
+      return 0;
+    }
+
+    KeyTuple rtuple = response.tuples(0);
+    if (rtuple.error() == 1) {
+      log_->info("Key {} does not exist and could not be retrieved.", key);
+      return 0;
+    }
+
+    // both kinds of counters are sent as a CounterValue; a G-counter just
+    // has no decrements
+    return deserialize_pncounter(rtuple.payload()).value();
+  }
+
   /**
    * Retrieve all replicas of a key from the KVS for a set value.
    */
@@ -452,6 +566,82 @@ class KvsClient {
     return result;
   }
 
+  /**
+   * Issue a SCAN request to the KVS for the keys from start up to (but not
+   * including) end, in order; an empty end scans to the last key. At most
+   * limit keys are returned (0 returns every key in the range), so a large
+   * range can be read page by page by starting each scan just past the last
+   * key of the previous one. If values is true, each tuple also carries the
+   * serialized value of its key.
+   *
+   * Since keys are partitioned by hash, every server thread is asked for the
+   * keys it stores in the range, and the results are merged. Replicated keys
+   * are returned once, with the value of whichever replica answered first. If
+   * any thread does not respond, we return an empty result.
+   */
+  vector<KeyTuple> scan(const Key& start, const Key& end, unsigned limit,
+                        bool values) {
+    vector<KeyTuple> result;
+
+    set<Address> workers = query_routing_all_threads();
+    if (workers.size() == 0) {
+      return result;
+    }
+
+    KeyRequest request;
+    request.set_type(RequestType::SCAN);
+    request.set_response_address(ut_.response_connect_address());
+    request.add_tuples()->set_key(start);
+    request.set_scan_end(end);
+    request.set_scan_limit(limit);
+    request.set_scan_values(values);
+
+    set<string> request_ids;
+    for (const Address& worker : workers) {
+      string rid_str = get_request_id();
+      request.set_request_id(rid_str);
+      request_ids.insert(rid_str);
+
+      send_request<KeyRequest>(request, socket_cache_[worker]);
+    }
+
+    vector<KeyResponse> responses;
+    if (!receive<KeyResponse>(response_puller_, request_ids, responses)) {
+      log_->info("SCAN request timed out while querying workers.");
+      return result;
+    }
+
+    std::map<Key, KeyTuple> merged;
+    for (const KeyResponse& response : responses) {
+      if (response.error() != 0) {
+        log_->info("SCAN request was rejected by a worker.");
+        return result;
+      }
+
+      for (const KeyTuple& tuple : response.tuples()) {
+        merged.insert(std::make_pair(tuple.key(), tuple));
+      }
+    }
+
+    for (auto& pair : merged) {
+      if (limit > 0 && result.size() == limit) {
+        break;
+      }
+
+      result.push_back(std::move(pair.second));
+    }
+
+    return result;
+  }
+
+  /**
+   * Issue a SCAN request to the KVS for the keys that start with prefix.
+   */
+  vector<KeyTuple> scan_prefix(const Key& prefix, unsigned limit,
+                               bool values) {
+    return scan(prefix, prefix_end(prefix), limit, values);
+  }
+
   /**
    * Set the logger used by the client.
    */
@@ -574,6 +764,113 @@ class KvsClient {
     return response;
   }
 
+  /**
+   * A recursive helper method for the put_bulk implementations. It groups the
+   * tuples by the worker thread we have cached for their keys (looking up the
+   * uncached ones in batches), sends every worker its tuples in requests of up
+   * to kBulkRequestSize tuples, and then waits for all of the responses. The
+   * tuples the workers report back as failed, along with those we could not
+   * find a worker for, are retried at most trial_limit times. It returns the
+   * number of tuples that were never stored.
+   */
+  unsigned try_bulk_request(const vector<KeyTuple>& tuples,
+                            unsigned trial_limit) {
+    if (tuples.size() == 0 || trial_limit == 0) {
+      return tuples.size();
+    }
+
+    vector<Key> uncached;
+    for (const KeyTuple& tuple : tuples) {
+      auto it = key_address_cache_.find(tuple.key());
+      if (it == key_address_cache_.end() || it->second.size() == 0) {
+        uncached.push_back(tuple.key());
+      }
+    }
+    query_routing_bulk(uncached);
+
+    vector<KeyTuple> failed;
+    map<Address, vector<KeyRequest>> requests;
+    map<Key, unsigned> tuple_index;
+
+    for (unsigned i = 0; i < tuples.size(); i++) {
+      const KeyTuple& tuple = tuples[i];
+      const set<Address>& workers = key_address_cache_[tuple.key()];
+      if (workers.size() == 0) {
+        failed.push_back(tuple);
+        continue;
+      }
+
+      Address worker =
+          *(next(begin(workers), rand_r(&seed_) % workers.size()));
+      vector<KeyRequest>& worker_requests = requests[worker];
+      if (worker_requests.size() == 0 ||
+          worker_requests.back().tuples_size() >=
+              static_cast<int>(kBulkRequestSize)) {
+        worker_requests.push_back(KeyRequest());
+        worker_requests.back().set_type(RequestType::PUT);
+        worker_requests.back().set_response_address(
+            ut_.response_connect_address());
+        worker_requests.back().set_bulk(true);
+      }
+
+      KeyTuple* tp = worker_requests.back().add_tuples();
+      *tp = tuple;
+      tp->set_address_cache_size(workers.size());
+      tuple_index[tuple.key()] = i;
+    }
+
+    set<string> request_ids;
+    for (auto& pair : requests) {
+      for (KeyRequest& request : pair.second) {
+        string rid_str = get_request_id();
+        request.set_request_id(rid_str);
+        request_ids.insert(rid_str);
+
+        send_request<KeyRequest>(request, socket_cache_[pair.first]);
+      }
+    }
+
+    vector<KeyResponse> responses;
+    if (request_ids.size() > 0 &&
+        !receive<KeyResponse>(response_puller_, request_ids, responses)) {
+      log_->info(
+          "Bulk request timed out while querying workers. Clearing address "
+          "cache for the workers that did not respond and retrying.");
+
+      // PUTs are idempotent, so we simply resend everything
+      for (auto& pair : requests) {
+        for (const KeyRequest& request : pair.second) {
+          if (request_ids.find(request.request_id()) != request_ids.end()) {
+            invalidate_cache_for_worker(pair.first);
+            break;
+          }
+        }
+      }
+
+      return try_bulk_request(tuples, trial_limit - 1);
+    }
+
+    for (const KeyResponse& response : responses) {
+      for (const KeyTuple& tuple : response.tuples()) {
+        auto it = tuple_index.find(tuple.key());
+        if (it == tuple_index.end()) {
+          continue;
+        }
+
+        if (check_tuple(tuple)) {
+          failed.push_back(tuples[it->second]);
+        }
+      }
+    }
+
+    if (failed.size() > 0) {
+      log_->info("Retrying {} of {} tuples in bulk request.", failed.size(),
+                 tuples.size());
+    }
+
+    return try_bulk_request(failed, trial_limit - 1);
+  }
+
   /**
    * A helper method to check for the default failure modes for a request that
    * retrieves a response. It returns true if the caller method should reissue
@@ -771,6 +1068,80 @@ class KvsClient {
     return result;
   }
 
+  /**
+   * Looks up the worker threads of many keys at once, sending the routing tier
+   * one request per kBulkRequestSize keys. The routing tier leaves out keys
+   * whose replication factors it does not know yet; those, like the keys of
+   * requests that time out, are simply not cached.
+   */
+  void query_routing_bulk(const vector<Key>& keys) {
+    set<string> request_ids;
+
+    for (unsigned i = 0; i < keys.size(); i += kBulkRequestSize) {
+      KeyAddressRequest request;
+      request.set_request_id(get_request_id());
+      request.set_response_address(ut_.key_address_connect_address());
+
+      for (unsigned j = i; j < keys.size() && j < i + kBulkRequestSize; j++) {
+        request.add_keys(keys[j]);
+      }
+
+      request_ids.insert(request.request_id());
+      send_request<KeyAddressRequest>(request,
+                                      socket_cache_[get_routing_thread()]);
+    }
+
+    vector<KeyAddressResponse> responses;
+    if (request_ids.size() == 0 ||
+        !receive<KeyAddressResponse>(key_address_puller_, request_ids,
+                                     responses)) {
+      return;
+    }
+
+    for (const KeyAddressResponse& response : responses) {
+      if (response.error() != 0) {
+        continue;
+      }
+
+      for (const auto& address : response.addresses()) {
+        set<Address>& cached = key_address_cache_[address.key()];
+        for (const string& ip : address.ips()) {
+          cached.insert(ip);
+        }
+      }
+    }
+  }
+
+  /**
+   * Asks the routing tier for the request addresses of every server thread
+   * in the cluster, which SCANs are sent to. Returns an empty set if the
+   * query timed out or no servers have joined yet.
+   */
+  set<Address> query_routing_all_threads() {
+    KeyAddressRequest request;
+    request.set_request_id(get_request_id());
+    request.set_response_address(ut_.key_address_connect_address());
+    request.set_all_threads(true);
+
+    set<Address> result;
+
+    bool succeed;
+    KeyAddressResponse response =
+        make_request<KeyAddressRequest, KeyAddressResponse>(
+            request, socket_cache_[get_routing_thread()], key_address_puller_,
+            succeed);
+
+    if (!succeed || response.error() != 0 || response.addresses_size() == 0) {
+      return result;
+    }
+
+    for (const string& ip : response.addresses(0).ips()) {
+      result.insert(ip);
+    }
+
+    return result;
+  }
+
   /**
    * Generates a unique request ID.
    */
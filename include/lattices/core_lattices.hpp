@@ -15,10 +15,16 @@
 #ifndef SRC_INCLUDE_LATTICES_CORE_LATTICES_HPP_
 #define SRC_INCLUDE_LATTICES_CORE_LATTICES_HPP_
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
 #include "lattice.hpp"
 #include "types.hpp"
 
-class BoolLattice : public Lattice<bool> {
+class BoolLattice : public Lattice<BoolLattice, bool> {
+  friend class Lattice<BoolLattice, bool>;
+
  protected:
   void do_merge(const bool &e) { element |= e; }
 
@@ -28,7 +34,10 @@ class BoolLattice : public Lattice<bool> {
 };
 
 template <typename T>
-class MaxLattice : public Lattice<T> {
+class MaxLattice : public Lattice<MaxLattice<T>, T> {
+  typedef Lattice<MaxLattice<T>, T> Base;
+  friend Base;
+
  protected:
   void do_merge(const T &e) {
     int current = this->element;
@@ -39,8 +48,8 @@ class MaxLattice : public Lattice<T> {
   }
 
  public:
-  MaxLattice() : Lattice<T>(T()) {}
-  MaxLattice(const T &e) : Lattice<T>(e) {}
+  MaxLattice() : Base(T()) {}
+  MaxLattice(const T &e) : Base(e) {}
 
   // for now, all non-merge methods are non-destructive
   MaxLattice<T> add(T n) const { return MaxLattice<T>(this->element + n); }
@@ -49,7 +58,10 @@ class MaxLattice : public Lattice<T> {
 };
 
 template <typename T>
-class SetLattice : public Lattice<set<T>> {
+class SetLattice : public Lattice<SetLattice<T>, set<T>> {
+  typedef Lattice<SetLattice<T>, set<T>> Base;
+  friend Base;
+
  protected:
   void do_merge(const set<T> &e) {
     for (const T &elem : e) {
@@ -57,10 +69,24 @@ class SetLattice : public Lattice<set<T>> {
     }
   }
 
+  // the elements of a set cannot be moved out of it, so we keep whichever of
+  // the two sets is larger and only copy the elements of the smaller one
+  void do_merge(set<T> &&e) {
+    if (e.size() > this->element.size()) {
+      std::swap(this->element, e);
+    }
+
+    for (const T &elem : e) {
+      this->element.insert(elem);
+    }
+  }
+
  public:
-  SetLattice() : Lattice<set<T>>(set<T>()) {}
+  SetLattice() : Base(set<T>()) {}
 
-  SetLattice(const set<T> &e) : Lattice<set<T>>(e) {}
+  SetLattice(const set<T> &e) : Base(e) {}
+
+  SetLattice(set<T> &&e) : Base(std::move(e)) {}
 
   MaxLattice<unsigned> size() const { return this->element.size(); }
 
@@ -90,7 +116,11 @@ class SetLattice : public Lattice<set<T>> {
 };
 
 template <typename T>
-class OrderedSetLattice : public Lattice<ordered_set<T>> {
+class OrderedSetLattice
+    : public Lattice<OrderedSetLattice<T>, ordered_set<T>> {
+  typedef Lattice<OrderedSetLattice<T>, ordered_set<T>> Base;
+  friend Base;
+
  protected:
   void do_merge(const ordered_set<T> &e) {
     for (const T &elem : e) {
@@ -98,10 +128,24 @@ class OrderedSetLattice : public Lattice<ordered_set<T>> {
     }
   }
 
+  // the elements of a set cannot be moved out of it, so we keep whichever of
+  // the two sets is larger and only copy the elements of the smaller one
+  void do_merge(ordered_set<T> &&e) {
+    if (e.size() > this->element.size()) {
+      std::swap(this->element, e);
+    }
+
+    for (const T &elem : e) {
+      this->element.insert(elem);
+    }
+  }
+
  public:
-  OrderedSetLattice() : Lattice<ordered_set<T>>(ordered_set<T>()) {}
+  OrderedSetLattice() : Base(ordered_set<T>()) {}
 
-  OrderedSetLattice(const ordered_set<T> &e) : Lattice<ordered_set<T>>(e) {}
+  OrderedSetLattice(const ordered_set<T> &e) : Base(e) {}
+
+  OrderedSetLattice(ordered_set<T> &&e) : Base(std::move(e)) {}
 
   MaxLattice<unsigned> size() const { return this->element.size(); }
 
@@ -130,17 +174,140 @@ class OrderedSetLattice : public Lattice<ordered_set<T>> {
   }
 };
 
+// SortedSetLattice is a set lattice whose elements are kept sorted and free of
+// duplicates in a single vector. It holds large sets in a fraction of the
+// memory of a SetLattice, which allocates a node per element, and merges,
+// intersects and projects them in linear time. Inserting one element at a
+// time is linear as well, so elements should be added in bulk by merging.
+template <typename T>
+class SortedSetLattice : public Lattice<SortedSetLattice<T>, vector<T>> {
+  typedef Lattice<SortedSetLattice<T>, vector<T>> Base;
+  friend Base;
+
+  static bool is_normalized(const vector<T> &e) {
+    return std::adjacent_find(e.begin(), e.end(), std::greater_equal<T>()) ==
+           e.end();
+  }
+
+  // sorts the elements and drops duplicates, unless they already are sorted
+  static void normalize(vector<T> &e) {
+    if (is_normalized(e)) {
+      return;
+    }
+
+    std::sort(e.begin(), e.end());
+    e.erase(std::unique(e.begin(), e.end()), e.end());
+  }
+
+  // merges two sorted vectors; the elements of e are copied or moved into
+  // the result depending on It
+  template <typename It>
+  void merge_sorted(It begin, It end) {
+    if (begin == end) {
+      return;
+    }
+
+    vector<T> merged;
+    merged.reserve(this->element.size() + (end - begin));
+
+    auto it = this->element.begin();
+    while (it != this->element.end() && begin != end) {
+      if (*it < *begin) {
+        merged.push_back(std::move(*it++));
+      } else if (*begin < *it) {
+        merged.push_back(*begin++);
+      } else {
+        merged.push_back(std::move(*it++));
+        ++begin;
+      }
+    }
+
+    std::move(it, this->element.end(), std::back_inserter(merged));
+    std::copy(begin, end, std::back_inserter(merged));
+    this->element.swap(merged);
+  }
+
+ protected:
+  void do_merge(const vector<T> &e) {
+    if (is_normalized(e)) {
+      merge_sorted(e.begin(), e.end());
+    } else {
+      do_merge(vector<T>(e));
+    }
+  }
+
+  void do_merge(vector<T> &&e) {
+    normalize(e);
+    if (this->element.empty()) {
+      this->element.swap(e);
+    } else {
+      merge_sorted(std::make_move_iterator(e.begin()),
+                   std::make_move_iterator(e.end()));
+    }
+  }
+
+ public:
+  SortedSetLattice() : Base(vector<T>()) {}
+
+  SortedSetLattice(const vector<T> &e) : Base(e) { normalize(this->element); }
+
+  SortedSetLattice(vector<T> &&e) : Base(std::move(e)) {
+    normalize(this->element);
+  }
+
+  MaxLattice<unsigned> size() const { return this->element.size(); }
+
+  bool contains(const T &e) const {
+    return std::binary_search(this->element.begin(), this->element.end(), e);
+  }
+
+  void insert(T e) {
+    auto it = std::lower_bound(this->element.begin(), this->element.end(), e);
+    if (it == this->element.end() || e < *it) {
+      this->element.insert(it, std::move(e));
+    }
+  }
+
+  SortedSetLattice<T> intersect(const SortedSetLattice<T> &s) const {
+    vector<T> res;
+    std::set_intersection(this->element.begin(), this->element.end(),
+                          s.reveal().begin(), s.reveal().end(),
+                          std::back_inserter(res));
+    return SortedSetLattice<T>(std::move(res));
+  }
+
+  SortedSetLattice<T> project(bool (*f)(T)) const {
+    vector<T> res;
+
+    for (const T &elem : this->element) {
+      if (f(elem)) res.push_back(elem);
+    }
+
+    return SortedSetLattice<T>(std::move(res));
+  }
+};
+
 template <typename K, typename V>
-class MapLattice : public Lattice<map<K, V>> {
+class MapLattice : public Lattice<MapLattice<K, V>, map<K, V>> {
+  typedef Lattice<MapLattice<K, V>, map<K, V>> Base;
+  friend Base;
+
  protected:
   void insert_pair(const K &k, const V &v) {
     auto search = this->element.find(k);
     if (search != this->element.end()) {
-      static_cast<V *>(&(search->second))->merge(v);
+      search->second.merge(v);
     } else {
-      // need to copy v since we will be "growing" it within the lattice
-      V new_v = v;
-      this->element.emplace(k, new_v);
+      this->element.emplace(k, v);
+    }
+  }
+
+  void insert_pair(const K &k, V &&v) {
+    auto search = this->element.find(k);
+    if (search != this->element.end()) {
+      search->second.merge(std::move(v));
+    } else {
+      this->element.emplace(k, std::move(v));
     }
   }
 
@@ -150,9 +317,22 @@ class MapLattice : public Lattice<map<K, V>> {
     }
   }
 
+  // keys cannot be moved out of a map, but the values they map to can
+  void do_merge(map<K, V> &&m) {
+    if (this->element.empty()) {
+      std::swap(this->element, m);
+      return;
+    }
+
+    for (auto &pair : m) {
+      this->insert_pair(pair.first, std::move(pair.second));
+    }
+  }
+
  public:
-  MapLattice() : Lattice<map<K, V>>(map<K, V>()) {}
-  MapLattice(const map<K, V> &m) : Lattice<map<K, V>>(m) {}
+  MapLattice() : Base(map<K, V>()) {}
+  MapLattice(const map<K, V> &m) : Base(m) {}
+  MapLattice(map<K, V> &&m) : Base(std::move(m)) {}
   MaxLattice<unsigned> size() const { return this->element.size(); }
 
   MapLattice<K, V> intersect(MapLattice<K, V> other) const {
@@ -201,6 +381,17 @@ class MapLattice : public Lattice<map<K, V>> {
   }
 
   void insert(const K &k, const V &v) { this->insert_pair(k, v); }
+
+  void insert(const K &k, V &&v) { this->insert_pair(k, std::move(v)); }
+
+  void insert(K &&k, V &&v) {
+    auto search = this->element.find(k);
+    if (search != this->element.end()) {
+      search->second.merge(std::move(v));
+    } else {
+      this->element.emplace(std::move(k), std::move(v));
+    }
+  }
 };
 
 #endif  // SRC_INCLUDE_LATTICES_CORE_LATTICES_HPP_
@@ -0,0 +1,172 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_LATTICES_COUNTER_LATTICE_HPP_
+#define INCLUDE_LATTICES_COUNTER_LATTICE_HPP_
+
+#include "vector_clock.hpp"
+
+// a node id and the total of the increments made at that node
+typedef std::pair<unsigned, unsigned long long> CounterEntry;
+
+// GCounterLattice is a grow-only counter. Each node only ever adds to its own
+// count, counts are merged by taking the larger one, and the value of the
+// counter is the sum of the counts; concurrent increments at different nodes
+// are therefore never lost. Like a VectorClock, the counts are kept in a
+// vector sorted by interned node id.
+class GCounterLattice : public Lattice<GCounterLattice, vector<CounterEntry>> {
+  typedef Lattice<GCounterLattice, vector<CounterEntry>> Base;
+  friend Base;
+
+ protected:
+  // e must be sorted by node id, as the entries of every counter are
+  void do_merge(const vector<CounterEntry> &e) {
+    vector<CounterEntry> merged;
+    merged.reserve(this->element.size() + e.size());
+
+    auto it = this->element.begin();
+    auto other = e.begin();
+    while (it != this->element.end() && other != e.end()) {
+      if (it->first < other->first) {
+        merged.push_back(*it++);
+      } else if (other->first < it->first) {
+        merged.push_back(*other++);
+      } else {
+        merged.push_back(
+            CounterEntry(it->first, std::max(it->second, other->second)));
+        ++it;
+        ++other;
+      }
+    }
+
+    merged.insert(merged.end(), it, this->element.end());
+    merged.insert(merged.end(), other, e.end());
+    this->element.swap(merged);
+  }
+
+ public:
+  GCounterLattice() : Base(vector<CounterEntry>()) {}
+
+  MaxLattice<unsigned> size() const { return this->element.size(); }
+
+  // the count of a single node, or 0 if it has never incremented the counter
+  unsigned long long count(const string &node) const {
+    unsigned id = NodeIds::intern(node);
+    auto it = std::lower_bound(this->element.begin(), this->element.end(),
+                               CounterEntry(id, 0));
+
+    if (it != this->element.end() && it->first == id) {
+      return it->second;
+    }
+    return 0;
+  }
+
+  // merges a single node's count into the counter
+  void insert(const string &node, unsigned long long count) {
+    unsigned id = NodeIds::intern(node);
+    auto it = std::lower_bound(this->element.begin(), this->element.end(),
+                               CounterEntry(id, 0));
+
+    if (it != this->element.end() && it->first == id) {
+      it->second = std::max(it->second, count);
+    } else {
+      this->element.insert(it, CounterEntry(id, count));
+    }
+  }
+
+  // adds to the count of the given node, which must be the node doing so
+  void increment(const string &node, unsigned long long amount) {
+    insert(node, count(node) + amount);
+  }
+
+  // the part of the counter the given node owns, i.e., only its own count;
+  // merging it elsewhere carries over the node's increments
+  GCounterLattice local(const string &node) const {
+    GCounterLattice result;
+    unsigned long long c = count(node);
+    if (c > 0) {
+      result.insert(node, c);
+    }
+    return result;
+  }
+
+  unsigned long long value() const {
+    unsigned long long total = 0;
+    for (const CounterEntry &entry : this->element) {
+      total += entry.second;
+    }
+    return total;
+  }
+};
+
+struct PNCounterPair {
+  GCounterLattice increments;
+  GCounterLattice decrements;
+
+  bool operator==(const PNCounterPair &other) const {
+    return increments == other.increments && decrements == other.decrements;
+  }
+};
+
+// PNCounterLattice is a counter that can also be decremented: it keeps the
+// increments and the decrements in two grow-only counters, and its value is
+// the difference between them.
+class PNCounterLattice : public Lattice<PNCounterLattice, PNCounterPair> {
+  typedef Lattice<PNCounterLattice, PNCounterPair> Base;
+  friend Base;
+
+ protected:
+  void do_merge(const PNCounterPair &p) {
+    this->element.increments.merge(p.increments);
+    this->element.decrements.merge(p.decrements);
+  }
+
+ public:
+  PNCounterLattice() : Base(PNCounterPair()) {}
+
+  PNCounterLattice(const PNCounterPair &p) : Base(p) {}
+
+  PNCounterLattice(PNCounterPair &&p) : Base(std::move(p)) {}
+
+  MaxLattice<unsigned> size() const {
+    return this->element.increments.size().reveal() +
+           this->element.decrements.size().reveal();
+  }
+
+  // adds amount (which may be negative) to the counter at the given node
+  void increment(const string &node, long long amount) {
+    if (amount >= 0) {
+      this->element.increments.increment(node, amount);
+    } else {
+      // negated as unsigned, so that the smallest amount does not overflow
+      this->element.decrements.increment(
+          node, 0ull - static_cast<unsigned long long>(amount));
+    }
+  }
+
+  // the part of the counter the given node owns
+  PNCounterLattice local(const string &node) const {
+    PNCounterPair p;
+    p.increments = this->element.increments.local(node);
+    p.decrements = this->element.decrements.local(node);
+    return PNCounterLattice(std::move(p));
+  }
+
+  long long value() const {
+    return static_cast<long long>(this->element.increments.value() -
+                                  this->element.decrements.value());
+  }
+};
+
+#endif  // INCLUDE_LATTICES_COUNTER_LATTICE_HPP_
@@ -15,9 +15,7 @@
 #ifndef SRC_INCLUDE_KVS_CROSS_CAUSAL_LATTICE_HPP_
 #define SRC_INCLUDE_KVS_CROSS_CAUSAL_LATTICE_HPP_
 
-#include "core_lattices.hpp"
-
-using VectorClock = MapLattice<string, MaxLattice<unsigned>>;
+#include "vector_clock.hpp"
 
 template <typename T>
 struct CrossCausalPayload {
@@ -39,12 +37,12 @@ struct CrossCausalPayload {
   }
 
   CrossCausalPayload<T>(VectorClock vc, MapLattice<Key, VectorClock> dep, T v) {
-    vector_clock = vc;
-    dependency = dep;
-    value = v;
+    vector_clock = std::move(vc);
+    dependency = std::move(dep);
+    value = std::move(v);
   }
 
-  unsigned size() {
+  unsigned size() const {
     unsigned dep_size = 0;
     for (const auto &pair : dependency.reveal()) {
       dep_size += pair.first.size();
@@ -56,29 +54,72 @@ struct CrossCausalPayload {
 };
 
 template <typename T>
-class CrossCausalLattice : public Lattice<CrossCausalPayload<T>> {
+class CrossCausalLattice
+    : public Lattice<CrossCausalLattice<T>, CrossCausalPayload<T>> {
+  typedef Lattice<CrossCausalLattice<T>, CrossCausalPayload<T>> Base;
+  friend Base;
+
  protected:
   void do_merge(const CrossCausalPayload<T> &p) {
-    VectorClock prev = this->element.vector_clock;
-    this->element.vector_clock.merge(p.vector_clock);
-
-    if (this->element.vector_clock == p.vector_clock) {
+    if (p.vector_clock.dominates(this->element.vector_clock)) {
       // incoming version is dominating
+      this->element.vector_clock.assign(p.vector_clock);
       this->element.dependency.assign(p.dependency);
       this->element.value.assign(p.value);
-    } else if (!(this->element.vector_clock == prev)) {
+    } else if (!this->element.vector_clock.dominates(p.vector_clock)) {
       // versions are concurrent
+      this->element.vector_clock.merge(p.vector_clock);
       this->element.dependency.merge(p.dependency);
       this->element.value.merge(p.value);
     }
   }
 
+  void do_merge(CrossCausalPayload<T> &&p) {
+    if (p.vector_clock.dominates(this->element.vector_clock)) {
+      // incoming version is dominating
+      this->element.vector_clock.assign(std::move(p.vector_clock));
+      this->element.dependency.assign(std::move(p.dependency));
+      this->element.value.assign(std::move(p.value));
+    } else if (!this->element.vector_clock.dominates(p.vector_clock)) {
+      // versions are concurrent
+      this->element.vector_clock.merge(p.vector_clock);
+      this->element.dependency.merge(std::move(p.dependency));
+      this->element.value.merge(std::move(p.value));
+    }
+  }
+
  public:
-  CrossCausalLattice() :
-      Lattice<CrossCausalPayload<T>>(CrossCausalPayload<T>()) {}
-  CrossCausalLattice(const CrossCausalPayload<T> &p) :
-      Lattice<CrossCausalPayload<T>>(p) {}
-  MaxLattice<unsigned> size() { return {this->element.size()}; }
+  CrossCausalLattice() : Base(CrossCausalPayload<T>()) {}
+  CrossCausalLattice(const CrossCausalPayload<T> &p) : Base(p) {}
+  CrossCausalLattice(CrossCausalPayload<T> &&p) : Base(std::move(p)) {}
+  MaxLattice<unsigned> size() const { return {this->element.size()}; }
+
+  using Base::merge;
+
+  // merges a version without building a payload to merge; the elements of its
+  // value (e.g., move iterators over a parsed message) are only read if the
+  // version is not dominated by ours
+  template <typename It>
+  void merge(const VectorClock &vector_clock,
+             const MapLattice<Key, VectorClock> &dependency, It begin,
+             It end) {
+    if (vector_clock.dominates(this->element.vector_clock)) {
+      // incoming version is dominating
+      this->element.vector_clock.assign(vector_clock);
+      this->element.dependency.assign(dependency);
+      this->element.value = T();
+    } else if (!this->element.vector_clock.dominates(vector_clock)) {
+      // versions are concurrent
+      this->element.vector_clock.merge(vector_clock);
+      this->element.dependency.merge(dependency);
+    } else {
+      return;
+    }
+
+    for (; begin != end; ++begin) {
+      this->element.value.insert(*begin);
+    }
+  }
 };
 
 #endif  // SRC_INCLUDE_KVS_CROSS_CAUSAL_LATTICE_HPP_
@@ -15,38 +15,60 @@
 #ifndef INCLUDE_LATTICES_LATTICE_HPP_
 #define INCLUDE_LATTICES_LATTICE_HPP_
 
-template <typename T>
+#include <utility>
+
+// Lattice is the base of every lattice; Derived is the lattice itself, which
+// implements do_merge for const and (optionally) rvalue references to T.
+// Merges are dispatched statically rather than through a vtable, so that
+// lattices carry no vtable pointer and the merges of lattices nested inside
+// others (e.g., the values of a MapLattice) can be inlined. Derived classes
+// make the base a friend so that do_merge can stay protected.
+template <typename Derived, typename T>
 class Lattice {
  protected:
   T element;
-  virtual void do_merge(const T &e) = 0;
+
+  Derived &derived() { return static_cast<Derived &>(*this); }
+
+  // lattices are never deleted through their base class
+  ~Lattice() = default;
 
  public:
-  // Lattice<T>() { assign(bot()); }
+  // Lattice() { assign(bot()); }
 
-  Lattice<T>(const T &e) { assign(e); }
+  Lattice(const T &e) : element(e) {}
 
-  Lattice<T>(const Lattice<T> &other) { assign(other.reveal()); }
+  Lattice(T &&e) : element(std::move(e)) {}
 
-  virtual ~Lattice<T>() = default;
-  Lattice<T> &operator=(const Lattice<T> &rhs) {
-    assign(rhs.reveal());
-    return *this;
-  }
+  Lattice(const Lattice &other) = default;
+
+  Lattice(Lattice &&other) = default;
+
+  Lattice &operator=(const Lattice &rhs) = default;
 
-  bool operator==(const Lattice<T> &rhs) const {
+  Lattice &operator=(Lattice &&rhs) = default;
+
+  bool operator==(const Lattice &rhs) const {
     return this->reveal() == rhs.reveal();
   }
 
   const T &reveal() const { return element; }
 
-  void merge(const T &e) { return do_merge(e); }
+  void merge(const T &e) { return derived().do_merge(e); }
+
+  void merge(T &&e) { return derived().do_merge(std::move(e)); }
+
+  void merge(const Lattice &e) { return derived().do_merge(e.reveal()); }
+
+  void merge(Lattice &&e) { return derived().do_merge(std::move(e.element)); }
+
+  void assign(const T &e) { element = e; }
 
-  void merge(const Lattice<T> &e) { return do_merge(e.reveal()); }
+  void assign(T &&e) { element = std::move(e); }
 
-  void assign(const T e) { element = e; }
+  void assign(const Lattice &e) { element = e.reveal(); }
 
-  void assign(const Lattice<T> &e) { element = e.reveal(); }
+  void assign(Lattice &&e) { element = std::move(e.element); }
 };
 
 #endif  // INCLUDE_LATTICES_LATTICE_HPP_
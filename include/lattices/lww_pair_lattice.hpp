@@ -38,11 +38,20 @@ struct TimestampValuePair {
     timestamp = ts;
     value = v;
   }
-  unsigned size() { return value.size() + sizeof(unsigned long long); }
+
+  TimestampValuePair<T>(const unsigned long long& ts, T&& v) {
+    timestamp = ts;
+    value = std::move(v);
+  }
+  unsigned size() const { return value.size() + sizeof(unsigned long long); }
 };
 
 template <typename T>
-class LWWPairLattice : public Lattice<TimestampValuePair<T>> {
+class LWWPairLattice
+    : public Lattice<LWWPairLattice<T>, TimestampValuePair<T>> {
+  typedef Lattice<LWWPairLattice<T>, TimestampValuePair<T>> Base;
+  friend Base;
+
  protected:
   void do_merge(const TimestampValuePair<T>& p) {
     if (p.timestamp >= this->element.timestamp) {
@@ -51,11 +60,29 @@ class LWWPairLattice : public Lattice<TimestampValuePair<T>> {
     }
   }
 
+  void do_merge(TimestampValuePair<T>&& p) {
+    if (p.timestamp >= this->element.timestamp) {
+      this->element.timestamp = p.timestamp;
+      this->element.value = std::move(p.value);
+    }
+  }
+
  public:
-  LWWPairLattice() : Lattice<TimestampValuePair<T>>(TimestampValuePair<T>()) {}
-  LWWPairLattice(const TimestampValuePair<T>& p) :
-      Lattice<TimestampValuePair<T>>(p) {}
-  MaxLattice<unsigned> size() { return {this->element.size()}; }
+  LWWPairLattice() : Base(TimestampValuePair<T>()) {}
+  LWWPairLattice(const TimestampValuePair<T>& p) : Base(p) {}
+  LWWPairLattice(TimestampValuePair<T>&& p) : Base(std::move(p)) {}
+  MaxLattice<unsigned> size() const { return {this->element.size()}; }
+
+  using Base::merge;
+
+  // merges a timestamp and value without building a pair to merge, taking
+  // the value over if it wins
+  void merge(const unsigned long long& timestamp, T&& value) {
+    if (timestamp >= this->element.timestamp) {
+      this->element.timestamp = timestamp;
+      this->element.value = std::move(value);
+    }
+  }
 };
 
 #endif  // INCLUDE_LATTICES_LWW_PAIR_LATTICE_HPP_
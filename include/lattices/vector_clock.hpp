@@ -0,0 +1,149 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_LATTICES_VECTOR_CLOCK_HPP_
+#define INCLUDE_LATTICES_VECTOR_CLOCK_HPP_
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
+#include "core_lattices.hpp"
+
+// NodeIds interns the identifiers of the nodes (e.g., clients) that appear in
+// vector clocks, so that clocks hold small integers instead of strings. Ids
+// only mean something within a process; clocks are always sent with the
+// identifiers themselves.
+class NodeIds {
+  std::mutex mutex_;
+  map<string, unsigned> ids_;
+
+  // a deque never moves its elements, so names can be handed out by reference
+  std::deque<string> names_;
+
+  static NodeIds &instance() {
+    static NodeIds node_ids;
+    return node_ids;
+  }
+
+ public:
+  static unsigned intern(const string &name) {
+    NodeIds &node_ids = instance();
+    std::lock_guard<std::mutex> lock(node_ids.mutex_);
+
+    auto it = node_ids.ids_.find(name);
+    if (it != node_ids.ids_.end()) {
+      return it->second;
+    }
+
+    unsigned id = node_ids.names_.size();
+    node_ids.names_.push_back(name);
+    node_ids.ids_.emplace(name, id);
+    return id;
+  }
+
+  static const string &name(unsigned id) {
+    NodeIds &node_ids = instance();
+    std::lock_guard<std::mutex> lock(node_ids.mutex_);
+    return node_ids.names_[id];
+  }
+};
+
+// a node id and the version of that node
+typedef std::pair<unsigned, unsigned> VectorClockEntry;
+
+// VectorClock maps interned node ids to versions in a vector sorted by id.
+// Merging two clocks and checking whether one dominates the other are single
+// passes over both vectors, and checking never allocates.
+class VectorClock : public Lattice<VectorClock, vector<VectorClockEntry>> {
+  typedef Lattice<VectorClock, vector<VectorClockEntry>> Base;
+  friend Base;
+
+  // whether every node in e appears in this clock with at least its version
+  bool dominates_entries(const vector<VectorClockEntry> &e) const {
+    if (e.size() > this->element.size()) {
+      return false;
+    }
+
+    auto it = this->element.begin();
+    for (const VectorClockEntry &entry : e) {
+      while (it != this->element.end() && it->first < entry.first) {
+        ++it;
+      }
+
+      if (it == this->element.end() || it->first != entry.first ||
+          it->second < entry.second) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+ protected:
+  // e must be sorted by node id, as the entries of every clock are
+  void do_merge(const vector<VectorClockEntry> &e) {
+    if (dominates_entries(e)) {
+      return;
+    }
+
+    vector<VectorClockEntry> merged;
+    merged.reserve(this->element.size() + e.size());
+
+    auto it = this->element.begin();
+    auto other = e.begin();
+    while (it != this->element.end() && other != e.end()) {
+      if (it->first < other->first) {
+        merged.push_back(*it++);
+      } else if (other->first < it->first) {
+        merged.push_back(*other++);
+      } else {
+        merged.push_back(
+            VectorClockEntry(it->first, std::max(it->second, other->second)));
+        ++it;
+        ++other;
+      }
+    }
+
+    merged.insert(merged.end(), it, this->element.end());
+    merged.insert(merged.end(), other, e.end());
+    this->element.swap(merged);
+  }
+
+ public:
+  VectorClock() : Base(vector<VectorClockEntry>()) {}
+
+  MaxLattice<unsigned> size() const { return this->element.size(); }
+
+  // merges a single node's version into the clock
+  void insert(const string &node, unsigned version) {
+    unsigned id = NodeIds::intern(node);
+    auto it = std::lower_bound(this->element.begin(), this->element.end(),
+                               VectorClockEntry(id, 0));
+
+    if (it != this->element.end() && it->first == id) {
+      it->second = std::max(it->second, version);
+    } else {
+      this->element.insert(it, VectorClockEntry(id, version));
+    }
+  }
+
+  // whether this clock is greater than or equal to other; a node that only
+  // appears in other makes the clocks incomparable, even at version 0
+  bool dominates(const VectorClock &other) const {
+    return dominates_entries(other.reveal());
+  }
+};
+
+#endif  // INCLUDE_LATTICES_VECTOR_CLOCK_HPP_
@@ -15,9 +15,7 @@
 #ifndef SRC_INCLUDE_KVS_VECTOR_CLOCK_PAIR_LATTICE_HPP_
 #define SRC_INCLUDE_KVS_VECTOR_CLOCK_PAIR_LATTICE_HPP_
 
-#include "core_lattices.hpp"
-
-using VectorClock = MapLattice<string, MaxLattice<unsigned>>;
+#include "vector_clock.hpp"
 
 template <typename T>
 struct VectorClockValuePair {
@@ -36,36 +34,69 @@ struct VectorClockValuePair {
   }
 
   VectorClockValuePair<T>(VectorClock vc, T v) {
-    vector_clock = vc;
-    value = v;
+    vector_clock = std::move(vc);
+    value = std::move(v);
   }
 
-  unsigned size() {
+  unsigned size() const {
     return vector_clock.size().reveal() * 2 * sizeof(unsigned) +
            value.size().reveal();
   }
 };
 
 template <typename T>
-class CausalPairLattice : public Lattice<VectorClockValuePair<T>> {
+class CausalPairLattice
+    : public Lattice<CausalPairLattice<T>, VectorClockValuePair<T>> {
+  typedef Lattice<CausalPairLattice<T>, VectorClockValuePair<T>> Base;
+  friend Base;
+
  protected:
   void do_merge(const VectorClockValuePair<T> &p) {
-    VectorClock prev = this->element.vector_clock;
-    this->element.vector_clock.merge(p.vector_clock);
-
-    if (this->element.vector_clock == p.vector_clock) {
+    if (p.vector_clock.dominates(this->element.vector_clock)) {
+      this->element.vector_clock.assign(p.vector_clock);
       this->element.value.assign(p.value);
-    } else if (!(this->element.vector_clock == prev)) {
+    } else if (!this->element.vector_clock.dominates(p.vector_clock)) {
+      this->element.vector_clock.merge(p.vector_clock);
       this->element.value.merge(p.value);
     }
   }
 
+  void do_merge(VectorClockValuePair<T> &&p) {
+    if (p.vector_clock.dominates(this->element.vector_clock)) {
+      this->element.vector_clock.assign(std::move(p.vector_clock));
+      this->element.value.assign(std::move(p.value));
+    } else if (!this->element.vector_clock.dominates(p.vector_clock)) {
+      this->element.vector_clock.merge(p.vector_clock);
+      this->element.value.merge(std::move(p.value));
+    }
+  }
+
  public:
-  CausalPairLattice() :
-      Lattice<VectorClockValuePair<T>>(VectorClockValuePair<T>()) {}
-  CausalPairLattice(const VectorClockValuePair<T> &p) :
-      Lattice<VectorClockValuePair<T>>(p) {}
-  MaxLattice<unsigned> size() { return {this->element.size()}; }
+  CausalPairLattice() : Base(VectorClockValuePair<T>()) {}
+  CausalPairLattice(const VectorClockValuePair<T> &p) : Base(p) {}
+  CausalPairLattice(VectorClockValuePair<T> &&p) : Base(std::move(p)) {}
+  MaxLattice<unsigned> size() const { return {this->element.size()}; }
+
+  using Base::merge;
+
+  // merges a version without building a pair to merge; the elements of its
+  // value (e.g., move iterators over a parsed message) are only read if the
+  // version is not dominated by ours
+  template <typename It>
+  void merge(const VectorClock &vector_clock, It begin, It end) {
+    if (vector_clock.dominates(this->element.vector_clock)) {
+      this->element.vector_clock.assign(vector_clock);
+      this->element.value = T();
+    } else if (!this->element.vector_clock.dominates(vector_clock)) {
+      this->element.vector_clock.merge(vector_clock);
+    } else {
+      return;
+    }
+
+    for (; begin != end; ++begin) {
+      this->element.value.insert(*begin);
+    }
+  }
 };
 
 #endif  // SRC_INCLUDE_KVS_VECTOR_CLOCK_PAIR_LATTICE_HPP_
@@ -57,11 +57,14 @@ bool receive(zmq::socket_t& recv_socket, set<string>& request_ids,
   }
 }
 
+// serializes the request straight into the message that is sent, rather than
+// into a string that is then copied into a message
 template <typename REQ>
 void send_request(const REQ& request, zmq::socket_t& send_socket) {
-  string serialized_req;
-  request.SerializeToString(&serialized_req);
-  kZmqUtil->send_string(serialized_req, &send_socket);
+  zmq::message_t message(request.ByteSizeLong());
+  request.SerializeWithCachedSizesToArray(
+      static_cast<google::protobuf::uint8*>(message.data()));
+  kZmqUtil->send_message(message, &send_socket);
 }
 
 // Synchronous combination of send and receive.
@@ -31,6 +31,10 @@ void ZmqUtil::send_string(const string& s, zmq::socket_t* socket) {
   socket->send(string_to_message(s));
 }
 
+void ZmqUtil::send_message(zmq::message_t& message, zmq::socket_t* socket) {
+  socket->send(message);
+}
+
 string ZmqUtil::recv_string(zmq::socket_t* socket) {
   zmq::message_t message;
   socket->recv(&message);
@@ -32,6 +32,9 @@ class ZmqUtilInterface {
   zmq::message_t string_to_message(const string& s);
   // `send` a string over the socket.
   virtual void send_string(const string& s, zmq::socket_t* socket) = 0;
+  // `send` a message over the socket without copying it.
+  virtual void send_message(zmq::message_t& message,
+                            zmq::socket_t* socket) = 0;
   // `recv` a string over the socket.
   virtual string recv_string(zmq::socket_t* socket) = 0;
   // `poll` is a wrapper around `zmq::poll` that takes a vector instead of a
@@ -42,6 +45,7 @@ class ZmqUtilInterface {
 class ZmqUtil : public ZmqUtilInterface {
  public:
   virtual void send_string(const string& s, zmq::socket_t* socket);
+  virtual void send_message(zmq::message_t& message, zmq::socket_t* socket);
   virtual string recv_string(zmq::socket_t* socket);
   virtual int poll(long timeout, vector<zmq::pollitem_t>* items);
 };
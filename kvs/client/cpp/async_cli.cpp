@@ -65,16 +65,15 @@ void handle_request(KvsAsyncClientInterface* client, string input) {
             deserialize_cross_causal(responses[0].tuples(0).payload())));
 
     for (const auto& pair : ccl.reveal().vector_clock.reveal()) {
-      std::cout << "{" << pair.first << " : "
-                << std::to_string(pair.second.reveal()) << "}" << std::endl;
+      std::cout << "{" << NodeIds::name(pair.first) << " : "
+                << std::to_string(pair.second) << "}" << std::endl;
     }
 
     for (const auto& dep_key_vc_pair : ccl.reveal().dependency.reveal()) {
       std::cout << dep_key_vc_pair.first << " : ";
       for (const auto& vc_pair : dep_key_vc_pair.second.reveal()) {
-        std::cout << "{" << vc_pair.first << " : "
-                  << std::to_string(vc_pair.second.reveal()) << "}"
-                  << std::endl;
+        std::cout << "{" << NodeIds::name(vc_pair.first) << " : "
+                  << std::to_string(vc_pair.second) << "}" << std::endl;
       }
     }
 
@@ -109,8 +108,9 @@ void handle_request(KvsAsyncClientInterface* client, string input) {
     ccp.vector_clock.insert("test", 1);
 
     // construct one test dependency
-    ccp.dependency.insert(
-        "dep1", VectorClock(map<string, MaxLattice<unsigned>>({{"test1", 1}})));
+    VectorClock dependency;
+    dependency.insert("test1", 1);
+    ccp.dependency.insert("dep1", dependency);
 
     // populate the value
     ccp.value.insert(v[2]);
@@ -94,10 +94,19 @@ void handle_request(KvsClient& client, string input) {
     } else {
       std::cout << "Failure!" << std::endl;
     }
+  } else if (v[0] == "INCREMENT") {
+    if (client.increment(v[1], std::stoll(v[2]), LatticeType::PNCOUNTER)) {
+      std::cout << "Success!" << std::endl;
+    } else {
+      std::cout << "Failure!" << std::endl;
+    }
+  } else if (v[0] == "GET_COUNTER") {
+    std::cout << client.get_counter(v[1]) << std::endl;
   } else {
     std::cout << "Unrecognized command " << v[0]
               << ". Valid commands are GET, GET_SET, GET_ALL, GET_SET_ALL, "
-                 "PUT, PUT_SET, PUT_ALL, and PUT_SET_ALL.";
+                 "PUT, PUT_SET, PUT_ALL, PUT_SET_ALL, INCREMENT, and "
+                 "GET_COUNTER.";
   }
 }
 
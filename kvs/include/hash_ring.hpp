@@ -24,13 +24,17 @@
 template <typename H>
 class HashRing : public ConsistentHashMap<ServerThread, H> {
  public:
-  HashRing() {}
+  HashRing() : changed(0) {}
 
   ~HashRing() {}
 
  public:
   ServerThreadSet get_unique_servers() const { return unique_servers; }
 
+  // when (in milliseconds since the epoch) a server last joined or left the
+  // ring, which moves keys between servers; a server rejoining does not
+  unsigned long long get_changed() const { return changed; }
+
   bool insert(Address public_ip, Address private_ip, int join_count,
               unsigned tid) {
     ServerThread new_thread = ServerThread(public_ip, private_ip, tid, 0);
@@ -46,6 +50,7 @@ class HashRing : public ConsistentHashMap<ServerThread, H> {
     } else {  // otherwise, insert it into the hash ring for the first time
       unique_servers.insert(new_thread);
       server_join_count[private_ip] = join_count;
+      changed = get_time();
 
       for (unsigned virtual_num = 0; virtual_num < kVirtualThreadNum;
            virtual_num++) {
@@ -66,11 +71,13 @@ class HashRing : public ConsistentHashMap<ServerThread, H> {
 
     unique_servers.erase(ServerThread(public_ip, private_ip, tid, 0));
     server_join_count.erase(private_ip);
+    changed = get_time();
   }
 
  private:
   ServerThreadSet unique_servers;
   map<string, int> server_join_count;
+  unsigned long long changed;
 };
 
 typedef HashRing<GlobalHasher> GlobalHashRing;
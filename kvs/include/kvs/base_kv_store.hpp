@@ -36,6 +36,8 @@ class KVStore {
 
   void put(const K& k, const V& v) { return db.at(k).merge(v); }
 
+  void put(const K& k, V&& v) { return db.at(k).merge(std::move(v)); }
+
   unsigned size(const K& k) { return db.at(k).size().reveal(); }
 
   void remove(const K& k) { db.remove(k); }
@@ -0,0 +1,126 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef KVS_INCLUDE_KVS_CODEC_HPP_
+#define KVS_INCLUDE_KVS_CODEC_HPP_
+
+#include <zlib.h>
+
+#include <iostream>
+
+#include "common.hpp"
+
+// values smaller than this (in bytes) are stored uncompressed by default
+const unsigned kDefaultCodecThreshold = 256;
+
+// A Codec compresses the payloads a tier stores. Every codec has a distinct,
+// non-zero id that is stored alongside the compressed bytes (an id of 0 means
+// the bytes are not compressed). Codecs must be safe to use from several
+// threads at once, since stored values are also decoded on I/O threads.
+class Codec {
+ public:
+  virtual ~Codec() {}
+
+  virtual unsigned char id() const = 0;
+
+  // returns false if the payload is not worth compressing
+  virtual bool compress(const string& payload, string& compressed) const = 0;
+
+  virtual bool decompress(const char* data, size_t length,
+                          string& payload) const = 0;
+};
+
+// ZlibCodec uses zlib's fastest compression level; compressed values are
+// prefixed with their uncompressed length (4 bytes, little-endian)
+class ZlibCodec : public Codec {
+  unsigned threshold_;
+
+ public:
+  ZlibCodec(unsigned threshold = kDefaultCodecThreshold) :
+      threshold_(threshold) {}
+
+  unsigned char id() const { return 1; }
+
+  bool compress(const string& payload, string& compressed) const {
+    if (payload.size() < threshold_) {
+      return false;
+    }
+
+    uLongf length = compressBound(payload.size());
+    compressed.resize(4 + length);
+
+    for (unsigned i = 0; i < 4; i++) {
+      compressed[i] = static_cast<char>((payload.size() >> (8 * i)) & 0xff);
+    }
+
+    if (compress2(reinterpret_cast<Bytef*>(&compressed[4]), &length,
+                  reinterpret_cast<const Bytef*>(payload.data()),
+                  payload.size(), Z_BEST_SPEED) != Z_OK) {
+      return false;
+    }
+
+    compressed.resize(4 + length);
+
+    // only keep the compressed form if it actually saves space
+    return compressed.size() < payload.size();
+  }
+
+  bool decompress(const char* data, size_t length, string& payload) const {
+    if (length < 4) {
+      return false;
+    }
+
+    uLongf size = 0;
+    for (unsigned i = 0; i < 4; i++) {
+      size |= static_cast<uLongf>(static_cast<unsigned char>(data[i]))
+              << (8 * i);
+    }
+
+    payload.resize(size);
+    if (size == 0) {
+      return true;
+    }
+
+    return uncompress(reinterpret_cast<Bytef*>(&payload[0]), &size,
+                      reinterpret_cast<const Bytef*>(data + 4),
+                      length - 4) == Z_OK &&
+           size == payload.size();
+  }
+};
+
+// returns the codec with the given id, or nullptr if there is none
+inline const Codec* get_codec(unsigned char id) {
+  static const ZlibCodec kZlibCodec;
+
+  if (id == kZlibCodec.id()) {
+    return &kZlibCodec;
+  }
+  return nullptr;
+}
+
+// returns the codec with the given name, or nullptr for "none"
+inline Codec* make_codec(const string& name, unsigned threshold) {
+  if (name == "zlib") {
+    return new ZlibCodec(threshold);
+  }
+
+  if (name != "none") {
+    std::cerr << "Unknown codec " << name
+              << "; values will be stored uncompressed." << std::endl;
+  }
+
+  return nullptr;
+}
+
+#endif  // KVS_INCLUDE_KVS_CODEC_HPP_
@@ -0,0 +1,1132 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef KVS_INCLUDE_KVS_EBS_LOG_HPP_
+#define KVS_INCLUDE_KVS_EBS_LOG_HPP_
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+
+#include "codec.hpp"
+#include "common.hpp"
+#include "io_queue.hpp"
+
+// segments are rolled over once they grow past this size (in bytes)
+const unsigned long long kLogSegmentSize = 64 * 1000 * 1000;
+
+// a sealed segment is compacted once less than this fraction of it is live
+const double kLogCompactionRatio = 0.5;
+
+// the number of records examined per call to EBSLog::compact
+const unsigned kLogCompactionBudget = 100;
+
+// chains longer than this are folded by the EBS serializers when the merged
+// value is at hand
+const unsigned kLogMaxChainLength = 16;
+
+// every record starts with: checksum (4 bytes), record kind (low 4 bits) and
+// id of the codec its value is compressed with (high 4 bits) (1 byte), lattice
+// type (1 byte), key length (4 bytes), and value length (4 bytes)
+const unsigned kLogHeaderSize = 14;
+
+// a DELTA is merged with whatever was logged for the key before it; a FULL
+// record holds the complete value and supersedes all earlier records; a
+// TOMBSTONE marks the key as removed
+enum LogRecordKind { DELTA = 0, FULL = 1, TOMBSTONE = 2 };
+
+// folds a non-empty sequence of serialized payloads (oldest first) into a
+// single serialized payload
+using PayloadMerger = std::function<string(const vector<string>&)>;
+
+// the position of a logged value within the segment files
+struct LogRecordLocation {
+  unsigned segment_;
+  unsigned long long offset_;  // offset of the value bytes in the segment
+  unsigned length_;            // length of the value bytes
+  unsigned char codec_;        // id of the codec the value is compressed with
+};
+
+// all records that have to be merged to reconstruct the current value of a
+// key, oldest first
+struct LogIndexEntry {
+  LatticeType type_;
+  vector<LogRecordLocation> chain_;
+};
+
+struct LogSegment {
+  // -1 if the segment file could not be opened
+  int fd_;
+  unsigned long long size_;
+  unsigned long long live_bytes_;
+
+  // the read-only mapping of the segment file, created on the first read
+  char* map_;
+  unsigned long long mapped_;
+
+  LogSegment() :
+      fd_(-1),
+      size_(0),
+      live_bytes_(0),
+      map_(nullptr),
+      mapped_(0) {}
+};
+
+// payloads that have been accepted for a key but not yet committed to disk
+struct LogPendingWrite {
+  LatticeType type_;
+  vector<string> payloads_;
+};
+
+// a batch of records that is appended to a segment and synced, along with
+// every other segment that was written to since the previous batch
+struct LogCommitBatch {
+  int fd_;
+  unsigned segment_;
+  unsigned long long offset_;
+  string records_;
+  vector<int> sync_fds_;
+
+  // the directory to sync after the segments, if any
+  string directory_;
+
+  // set by the job that writes the batch once it is durable
+  bool durable_;
+
+  LogCommitBatch() : fd_(-1), segment_(0), offset_(0), durable_(false) {}
+};
+
+// the chains of records of a set of keys that are read in the background
+struct LogPrefetch {
+  vector<Key> keys_;
+  vector<vector<LogRecordLocation>> chains_;
+  vector<vector<string>> payloads_;
+  vector<bool> succeeded_;
+  std::map<unsigned, int> fds_;
+};
+
+// the payloads read by a prefetch, which are only valid as long as the chain
+// they were read from is still the key's current chain
+struct LogPrefetchedValue {
+  vector<LogRecordLocation> chain_;
+  vector<string> payloads_;
+};
+
+// EBSLog is a per-thread, append-only store for the EBS tier. Every PUT is a
+// single sequential append of the incoming payload to the active segment file,
+// and an in-memory index maps each key to the records that make up its value,
+// so a GET is a copy per record out of the memory-mapped segment files.
+// Records are stored in wire format, so a GET of a single record returns the
+// stored bytes without parsing them. Chains of records are merged with
+// the lattice merge of the key's type when they are read and, for sealed
+// segments that are mostly garbage, incrementally by compact(), which is
+// driven from the server's event loop.
+//
+// Appended payloads are not written right away: they are buffered (and
+// coalesced per key) until commit() writes all of them to the active segment
+// with a single write followed by a single fdatasync. The records written by
+// folds, removals, and compaction are staged in memory the same way and go out
+// with the next batch.
+//
+// To keep the event loop from blocking on the disk, commits and the reads for
+// GETs can be handed to an IOQueue: commit_async() writes and syncs a batch in
+// the background, and prefetch() reads the chains of a request's keys in the
+// background so that the request can later be served from memory.
+class EBSLog {
+  string directory_;
+  const Codec* codec_;
+  std::map<unsigned, LogSegment> segments_;
+  unsigned active_;
+
+  // segments written to since the last commit
+  set<unsigned> dirty_;
+
+  // records appended since the last commit, which are served from memory
+  // until a batch writes them
+  LogCommitBatch staged_;
+
+  map<Key, LogIndexEntry> index_;
+  map<Key, LogPendingWrite> pending_;
+  LatticeTypeMap<PayloadMerger> mergers_;
+
+  // the segment currently being compacted and how far we have scanned it
+  bool compacting_;
+  unsigned compact_segment_;
+  unsigned long long compact_cursor_;
+
+  IOQueue io_;
+  map<unsigned, std::shared_ptr<LogCommitBatch>> commits_;
+
+  // compacted segments by the ticket of the batch that makes their folded
+  // records durable; each is deleted once its batch is
+  map<unsigned, unsigned> compactions_;
+  map<unsigned, std::shared_ptr<LogPrefetch>> prefetches_;
+  map<Key, LogPrefetchedValue> prefetched_;
+
+  // descriptors of compacted segments that background reads may still use
+  vector<int> retired_fds_;
+
+  string segment_path(unsigned id) const {
+    return directory_ + "segment_" + std::to_string(id) + ".log";
+  }
+
+  static unsigned checksum(const char* data, size_t length,
+                           unsigned hash = 2166136261u) {
+    // 32-bit FNV-1a
+    for (size_t i = 0; i < length; i++) {
+      hash ^= static_cast<unsigned char>(data[i]);
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+  static void encode_u32(char* buf, unsigned v) {
+    for (unsigned i = 0; i < 4; i++) {
+      buf[i] = static_cast<char>((v >> (8 * i)) & 0xff);
+    }
+  }
+
+  static unsigned decode_u32(const char* buf) {
+    unsigned v = 0;
+    for (unsigned i = 0; i < 4; i++) {
+      v |= static_cast<unsigned>(static_cast<unsigned char>(buf[i])) << (8 * i);
+    }
+    return v;
+  }
+
+  static bool read_exact(int fd, char* buf, size_t length,
+                         unsigned long long offset) {
+    size_t done = 0;
+    while (done < length) {
+      ssize_t n = pread(fd, buf + done, length - done, offset + done);
+      if (n <= 0) {
+        return false;
+      }
+      done += n;
+    }
+    return true;
+  }
+
+  static bool write_exact(int fd, const char* buf, size_t length,
+                          unsigned long long offset) {
+    size_t done = 0;
+    while (done < length) {
+      ssize_t n = pwrite(fd, buf + done, length - done, offset + done);
+      if (n <= 0) {
+        return false;
+      }
+      done += n;
+    }
+    return true;
+  }
+
+  bool open_segment(unsigned id) {
+    string path = segment_path(id);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      std::cerr << "Failed to open log segment " << path << std::endl;
+      return false;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+
+    LogSegment& segment = segments_[id];
+    segment.fd_ = fd;
+    segment.size_ = static_cast<unsigned long long>(st.st_size);
+    return true;
+  }
+
+  // makes the creation and removal of segment files durable
+  static bool sync_directory(const string& directory) {
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+      return false;
+    }
+
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+  }
+
+  static unsigned long long record_size(const Key& key,
+                                        const LogRecordLocation& loc) {
+    return kLogHeaderSize + key.size() + loc.length_;
+  }
+
+  void release(const Key& key, const LogRecordLocation& loc) {
+    auto it = segments_.find(loc.segment_);
+    if (it != segments_.end()) {
+      it->second.live_bytes_ -= record_size(key, loc);
+    }
+  }
+
+  void release_chain(const Key& key, const LogIndexEntry& entry) {
+    for (const LogRecordLocation& loc : entry.chain_) {
+      release(key, loc);
+    }
+  }
+
+  // rolls over to a new segment if the active one is full; if the new one
+  // cannot be created, the active one keeps growing instead
+  void roll_segment() {
+    if (segments_[active_].size_ >= kLogSegmentSize &&
+        open_segment(active_ + 1)) {
+      active_ += 1;
+    }
+  }
+
+  // appends the encoded record to buf, compressing the value if the codec
+  // deems it worthwhile; returns the location of the value bytes relative to
+  // the start of buf
+  LogRecordLocation encode_record(LogRecordKind kind, LatticeType type,
+                                  const Key& key, const string& value,
+                                  string& buf) const {
+    string compressed;
+    unsigned char codec = 0;
+    if (codec_ != nullptr && codec_->compress(value, compressed)) {
+      codec = codec_->id();
+    }
+
+    const string& stored = codec == 0 ? value : compressed;
+
+    size_t start = buf.size();
+    buf.resize(start + kLogHeaderSize);
+    buf[start + 4] = static_cast<char>(kind | (codec << 4));
+    buf[start + 5] = static_cast<char>(type);
+    encode_u32(&buf[start + 6], key.size());
+    encode_u32(&buf[start + 10], stored.size());
+    buf += key;
+    buf += stored;
+    encode_u32(&buf[start],
+               checksum(buf.data() + start + 4, buf.size() - start - 4));
+
+    return {0, start + kLogHeaderSize + key.size(),
+            static_cast<unsigned>(stored.size()), codec};
+  }
+
+  // turns the stored bytes of a value back into its payload, with the codec
+  // the record was written with rather than the one the log is configured
+  // with now
+  static bool decode_value(const LogRecordLocation& loc, const char* data,
+                           string& value) {
+    if (loc.codec_ == 0) {
+      value.assign(data, loc.length_);
+      return true;
+    }
+
+    const Codec* codec = get_codec(loc.codec_);
+    if (codec == nullptr) {
+      std::cerr << "No codec to decode values compressed with codec "
+                << static_cast<unsigned>(loc.codec_) << std::endl;
+      return false;
+    }
+
+    return codec->decompress(data, loc.length_, value);
+  }
+
+  // points an empty batch at the end of the active segment, rolling over to a
+  // new segment if the active one is full
+  void open_batch(LogCommitBatch& batch) {
+    roll_segment();
+    batch.fd_ = segments_[active_].fd_;
+    batch.segment_ = active_;
+    batch.offset_ = segments_[active_].size_;
+  }
+
+  // starts a batch with the records staged since the last commit, if any
+  void start_batch(LogCommitBatch& batch) {
+    if (staged_.records_.empty()) {
+      open_batch(batch);
+    } else {
+      batch = std::move(staged_);
+      staged_ = LogCommitBatch();
+    }
+  }
+
+  // hands every segment written to since the last batch to this one to sync
+  void seal_batch(LogCommitBatch& batch) {
+    if (batch.records_.size() > 0) {
+      dirty_.insert(batch.segment_);
+    }
+
+    for (const unsigned& id : dirty_) {
+      batch.sync_fds_.push_back(segments_[id].fd_);
+    }
+    dirty_.clear();
+  }
+
+  // stages a record to be written by the next batch; the record is served
+  // from memory until then. Returns the location of the value bytes
+  LogRecordLocation append_record(LogRecordKind kind, LatticeType type,
+                                  const Key& key, const string& value) {
+    if (staged_.records_.empty()) {
+      open_batch(staged_);
+    }
+
+    size_t start = staged_.records_.size();
+    LogRecordLocation loc =
+        encode_record(kind, type, key, value, staged_.records_);
+    loc.segment_ = staged_.segment_;
+    loc.offset_ += staged_.offset_;
+
+    LogSegment& segment = segments_[staged_.segment_];
+    unsigned long long size = staged_.records_.size() - start;
+    segment.size_ += size;
+
+    if (kind != LogRecordKind::TOMBSTONE) {
+      segment.live_bytes_ += size;
+    }
+
+    return loc;
+  }
+
+  // folds the payloads buffered for a key into the one that gets logged
+  bool coalesce(LogPendingWrite& write, string& payload) {
+    if (write.payloads_.size() == 1) {
+      payload = std::move(write.payloads_[0]);
+    } else if (mergers_.contains(write.type_)) {
+      payload = mergers_.at(write.type_)(write.payloads_);
+    } else {
+      std::cerr << "No merge function for lattice type "
+                << LatticeType_Name(write.type_) << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  // maps the segment into memory, or remaps it if it has outgrown its
+  // mapping; returns nullptr if the segment cannot be mapped
+  static const char* map_segment(LogSegment& segment) {
+    if (segment.size_ > segment.mapped_) {
+      if (segment.map_ != nullptr) {
+        munmap(segment.map_, segment.mapped_);
+      }
+
+      // the mapping may extend past the end of the file, since only the
+      // bytes that have been written are ever accessed
+      unsigned long long length = std::max(segment.size_, kLogSegmentSize);
+      void* addr =
+          mmap(nullptr, length, PROT_READ, MAP_SHARED, segment.fd_, 0);
+
+      if (addr == MAP_FAILED) {
+        segment.map_ = nullptr;
+        segment.mapped_ = 0;
+        return nullptr;
+      }
+
+      segment.map_ = static_cast<char*>(addr);
+      segment.mapped_ = length;
+    }
+
+    return segment.map_;
+  }
+
+  static void unmap_segment(LogSegment& segment) {
+    if (segment.map_ != nullptr) {
+      munmap(segment.map_, segment.mapped_);
+      segment.map_ = nullptr;
+      segment.mapped_ = 0;
+    }
+  }
+
+  static bool in_batch(const LogCommitBatch& batch,
+                       const LogRecordLocation& loc) {
+    return loc.segment_ == batch.segment_ && loc.offset_ >= batch.offset_ &&
+           loc.offset_ + loc.length_ <= batch.offset_ + batch.records_.size();
+  }
+
+  bool read_value(const LogRecordLocation& loc, string& value) {
+    // records that are staged or still being committed are served from memory
+    if (in_batch(staged_, loc)) {
+      return decode_value(
+          loc, staged_.records_.data() + (loc.offset_ - staged_.offset_),
+          value);
+    }
+
+    for (const auto& pair : commits_) {
+      const LogCommitBatch& batch = *pair.second;
+      if (in_batch(batch, loc)) {
+        return decode_value(
+            loc, batch.records_.data() + (loc.offset_ - batch.offset_), value);
+      }
+    }
+
+    auto it = segments_.find(loc.segment_);
+    if (it == segments_.end()) {
+      return false;
+    }
+
+    // the value bytes are copied straight out of the page cache
+    const char* data = map_segment(it->second);
+    if (data != nullptr) {
+      return decode_value(loc, data + loc.offset_, value);
+    }
+
+    string stored(loc.length_, '\0');
+    return (loc.length_ == 0 || read_exact(it->second.fd_, &stored[0],
+                                           loc.length_, loc.offset_)) &&
+           decode_value(loc, stored.data(), value);
+  }
+
+  // rebuilds the index from a segment; a torn or corrupt record at the tail
+  // of a segment is truncated away
+  void replay_segment(unsigned id) {
+    LogSegment& segment = segments_[id];
+    unsigned long long offset = 0;
+    char header[kLogHeaderSize];
+
+    while (offset + kLogHeaderSize <= segment.size_) {
+      if (!read_exact(segment.fd_, header, kLogHeaderSize, offset)) {
+        break;
+      }
+
+      LogRecordKind kind = static_cast<LogRecordKind>(header[4] & 0x0f);
+      unsigned char codec = (header[4] >> 4) & 0x0f;
+      LatticeType type = static_cast<LatticeType>(header[5]);
+      unsigned key_length = decode_u32(header + 6);
+      unsigned value_length = decode_u32(header + 10);
+      unsigned long long total = kLogHeaderSize + key_length + value_length;
+
+      if (offset + total > segment.size_) {
+        break;
+      }
+
+      string body(key_length + value_length, '\0');
+      if (!body.empty() &&
+          !read_exact(segment.fd_, &body[0], body.size(),
+                      offset + kLogHeaderSize)) {
+        break;
+      }
+
+      unsigned sum = checksum(header + 4, kLogHeaderSize - 4);
+      if (checksum(body.data(), body.size(), sum) != decode_u32(header)) {
+        break;
+      }
+
+      Key key = body.substr(0, key_length);
+      LogRecordLocation loc = {id, offset + kLogHeaderSize + key_length,
+                               value_length, codec};
+
+      if (kind == LogRecordKind::TOMBSTONE) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+          release_chain(key, it->second);
+          index_.erase(it);
+        }
+      } else {
+        LogIndexEntry& entry = index_[key];
+        if (kind == LogRecordKind::FULL) {
+          release_chain(key, entry);
+          entry.chain_.clear();
+        }
+
+        entry.type_ = type;
+        entry.chain_.push_back(loc);
+        segment.live_bytes_ += total;
+      }
+
+      offset += total;
+    }
+
+    if (offset < segment.size_) {
+      std::cerr << "Truncating log segment " << id << " at offset " << offset
+                << "." << std::endl;
+      if (ftruncate(segment.fd_, offset) != 0) {
+        std::cerr << "Failed to truncate log segment " << id << std::endl;
+      }
+      segment.size_ = offset;
+    }
+  }
+
+  // rewrites the current value of a key as a single FULL record
+  void fold(const Key& key, LogIndexEntry& entry) {
+    vector<string> payloads;
+    if (!read_chain(entry, payloads)) {
+      return;
+    }
+
+    string merged;
+    if (payloads.size() == 1) {
+      merged = std::move(payloads[0]);
+    } else if (mergers_.contains(entry.type_)) {
+      merged = mergers_.at(entry.type_)(payloads);
+    } else {
+      std::cerr << "No merge function for lattice type "
+                << LatticeType_Name(entry.type_) << std::endl;
+      return;
+    }
+
+    replace(key, entry, merged);
+  }
+
+  void replace(const Key& key, LogIndexEntry& entry, const string& merged) {
+    LogRecordLocation loc =
+        append_record(LogRecordKind::FULL, entry.type_, key, merged);
+    release_chain(key, entry);
+    entry.chain_.clear();
+    entry.chain_.push_back(loc);
+  }
+
+  bool read_chain(const LogIndexEntry& entry, vector<string>& payloads) {
+    payloads.resize(entry.chain_.size());
+    for (unsigned i = 0; i < entry.chain_.size(); i++) {
+      if (!read_value(entry.chain_[i], payloads[i])) {
+        std::cerr << "Failed to read from log segment "
+                  << entry.chain_[i].segment_ << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static bool in_chain(const LogIndexEntry& entry, unsigned segment,
+                       unsigned long long offset) {
+    for (const LogRecordLocation& loc : entry.chain_) {
+      if (loc.segment_ == segment && loc.offset_ == offset) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static bool same_chain(const vector<LogRecordLocation>& left,
+                         const vector<LogRecordLocation>& right) {
+    if (left.size() != right.size()) {
+      return false;
+    }
+
+    for (unsigned i = 0; i < left.size(); i++) {
+      if (left[i].segment_ != right[i].segment_ ||
+          left[i].offset_ != right[i].offset_) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // whether the segment has records that are staged or still being committed
+  // to it
+  bool committing_to(unsigned segment) const {
+    if (staged_.records_.size() > 0 && staged_.segment_ == segment) {
+      return true;
+    }
+
+    for (const auto& pair : commits_) {
+      if (pair.second->segment_ == segment) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // encodes every buffered delta into a batch after the staged records and
+  // points the index at it; the batch still has to be written
+  unsigned stage_commit(LogCommitBatch& batch) {
+    unsigned count = 0;
+
+    start_batch(batch);
+    LogSegment& segment = segments_[batch.segment_];
+    size_t staged = batch.records_.size();
+
+    for (auto& pair : pending_) {
+      string payload;
+      if (!coalesce(pair.second, payload)) {
+        continue;
+      }
+
+      LogRecordLocation loc =
+          encode_record(LogRecordKind::DELTA, pair.second.type_, pair.first,
+                        payload, batch.records_);
+      loc.segment_ = batch.segment_;
+      loc.offset_ += batch.offset_;
+
+      LogIndexEntry& entry = index_[pair.first];
+      entry.type_ = pair.second.type_;
+      entry.chain_.push_back(loc);
+      count += 1;
+    }
+
+    pending_.clear();
+
+    segment.size_ += batch.records_.size() - staged;
+    segment.live_bytes_ += batch.records_.size() - staged;
+    seal_batch(batch);
+
+    return count;
+  }
+
+  // returns whether the batch is durable
+  static bool write_batch(const LogCommitBatch& batch) {
+    bool durable = true;
+    if (!write_exact(batch.fd_, batch.records_.data(), batch.records_.size(),
+                     batch.offset_)) {
+      std::cerr << "Failed to commit to log segment " << batch.segment_
+                << std::endl;
+      durable = false;
+    }
+
+    for (const int& fd : batch.sync_fds_) {
+      if (fdatasync(fd) != 0) {
+        std::cerr << "Failed to sync log segment " << batch.segment_
+                  << std::endl;
+        durable = false;
+      }
+    }
+
+    if (!batch.directory_.empty() && !sync_directory(batch.directory_)) {
+      std::cerr << "Failed to sync log directory " << batch.directory_
+                << std::endl;
+      durable = false;
+    }
+
+    return durable;
+  }
+
+  // deletes a compacted segment; its descriptor stays open until the
+  // background reads that may still use it have finished
+  void delete_segment(unsigned id) {
+    LogSegment& segment = segments_[id];
+    unmap_segment(segment);
+
+    if (io_.outstanding() > 0) {
+      retired_fds_.push_back(segment.fd_);
+    } else {
+      close(segment.fd_);
+    }
+
+    unlink(segment_path(id).c_str());
+    segments_.erase(id);
+  }
+
+  bool deleting(unsigned segment) const {
+    for (const auto& pair : compactions_) {
+      if (pair.second == segment) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static void read_prefetch(LogPrefetch& prefetch) {
+    for (unsigned i = 0; i < prefetch.keys_.size(); i++) {
+      const vector<LogRecordLocation>& chain = prefetch.chains_[i];
+      prefetch.payloads_[i].resize(chain.size());
+
+      bool succeeded = true;
+      string stored;
+      for (unsigned j = 0; j < chain.size() && succeeded; j++) {
+        stored.resize(chain[j].length_);
+        succeeded = (chain[j].length_ == 0 ||
+                     read_exact(prefetch.fds_[chain[j].segment_], &stored[0],
+                                chain[j].length_, chain[j].offset_)) &&
+                    decode_value(chain[j], stored.data(),
+                                 prefetch.payloads_[i][j]);
+      }
+
+      prefetch.succeeded_[i] = succeeded;
+    }
+  }
+
+  // picks the sealed segment with the smallest live fraction, if any of them
+  // is below the compaction ratio
+  bool pick_compaction_segment(unsigned& id) const {
+    bool found = false;
+    double lowest = kLogCompactionRatio;
+
+    for (const auto& pair : segments_) {
+      if (pair.first == active_ || pair.second.size_ == 0 ||
+          committing_to(pair.first) || deleting(pair.first)) {
+        continue;
+      }
+
+      double live = static_cast<double>(pair.second.live_bytes_) /
+                    static_cast<double>(pair.second.size_);
+      if (live < lowest) {
+        lowest = live;
+        id = pair.first;
+        found = true;
+      }
+    }
+
+    return found;
+  }
+
+ public:
+  // new values are compressed with the given codec, if any; the codec is not
+  // owned by the log and has to outlive it. Values already in the log are
+  // read back with whichever codec they were written with.
+  EBSLog(string directory, const Codec* codec = nullptr) :
+      directory_(std::move(directory)),
+      codec_(codec),
+      active_(0),
+      compacting_(false) {
+    if (directory_.back() != '/') {
+      directory_ += "/";
+    }
+
+    mkdir(directory_.c_str(), 0755);
+
+    DIR* dir = opendir(directory_.c_str());
+    if (dir != nullptr) {
+      struct dirent* ent;
+      while ((ent = readdir(dir)) != nullptr) {
+        unsigned id;
+        char suffix[8];
+        if (sscanf(ent->d_name, "segment_%u.%4s", &id, suffix) == 2 &&
+            string(suffix) == "log") {
+          open_segment(id);
+        }
+      }
+      closedir(dir);
+    }
+
+    for (const auto& pair : segments_) {
+      replay_segment(pair.first);
+      active_ = pair.first;
+    }
+
+    if (segments_.empty() && !open_segment(active_)) {
+      std::cerr << "Log in " << directory_ << " is not writable" << std::endl;
+    }
+  }
+
+  ~EBSLog() {
+    io_.drain();
+    vector<unsigned> completed;
+    poll(completed);
+    commit();
+
+    for (auto& pair : segments_) {
+      unmap_segment(pair.second);
+      close(pair.second.fd_);
+    }
+  }
+
+  // registers the function used to merge chains of the given lattice type
+  void register_merger(LatticeType type, PayloadMerger merger) {
+    mergers_.set(type, std::move(merger));
+  }
+
+  // buffers a delta that is to be merged into the key's current value; it is
+  // written to disk by the next commit
+  void append(const Key& key, LatticeType type, const string& payload) {
+    LogPendingWrite& write = pending_[key];
+    write.type_ = type;
+    write.payloads_.push_back(payload);
+  }
+
+  // writes every buffered delta to the log and waits for it to be durable;
+  // returns the number of keys that were written
+  unsigned commit() {
+    LogCommitBatch batch;
+    unsigned count = stage_commit(batch);
+    write_batch(batch);
+    return count;
+  }
+
+  // like commit(), but the batch is written and synced in the background;
+  // returns the ticket that poll() reports once the batch is durable
+  unsigned commit_async() {
+    auto batch = std::make_shared<LogCommitBatch>();
+    stage_commit(*batch);
+
+    unsigned ticket =
+        io_.submit([batch]() { batch->durable_ = write_batch(*batch); });
+    commits_[ticket] = batch;
+    return ticket;
+  }
+
+  // whether an asynchronous commit is still in flight
+  bool committing() const { return !commits_.empty(); }
+
+  // reads the chains of the given keys in the background; returns the ticket
+  // that poll() reports once the reads have finished, after which reads of
+  // those keys are served from memory until release_prefetch() is called
+  unsigned prefetch(const vector<Key>& keys) {
+    auto prefetch = std::make_shared<LogPrefetch>();
+
+    for (const Key& key : keys) {
+      auto it = index_.find(key);
+      if (it == index_.end()) {
+        continue;
+      }
+
+      // records that are still being committed are read from memory anyway
+      bool on_disk = true;
+      for (const LogRecordLocation& loc : it->second.chain_) {
+        on_disk = on_disk && !committing_to(loc.segment_);
+        prefetch->fds_[loc.segment_] = segments_[loc.segment_].fd_;
+      }
+
+      if (on_disk) {
+        prefetch->keys_.push_back(key);
+        prefetch->chains_.push_back(it->second.chain_);
+      }
+    }
+
+    prefetch->payloads_.resize(prefetch->keys_.size());
+    prefetch->succeeded_.resize(prefetch->keys_.size());
+
+    unsigned ticket = io_.submit([prefetch]() { read_prefetch(*prefetch); });
+    prefetches_[ticket] = prefetch;
+    return ticket;
+  }
+
+  // appends the tickets of the commits and prefetches that have finished
+  // since the last call
+  void poll(vector<unsigned>& completed) {
+    unsigned start = completed.size();
+    io_.poll(completed);
+
+    for (unsigned i = start; i < completed.size(); i++) {
+      auto compaction = compactions_.find(completed[i]);
+      if (compaction != compactions_.end()) {
+        // a segment whose folded records failed to sync is compacted again
+        if (commits_[completed[i]]->durable_) {
+          delete_segment(compaction->second);
+        }
+        compactions_.erase(compaction);
+      }
+
+      commits_.erase(completed[i]);
+
+      auto it = prefetches_.find(completed[i]);
+      if (it != prefetches_.end()) {
+        LogPrefetch& prefetch = *it->second;
+        for (unsigned j = 0; j < prefetch.keys_.size(); j++) {
+          if (prefetch.succeeded_[j]) {
+            LogPrefetchedValue& value = prefetched_[prefetch.keys_[j]];
+            value.chain_ = std::move(prefetch.chains_[j]);
+            value.payloads_ = std::move(prefetch.payloads_[j]);
+          }
+        }
+      }
+    }
+
+    if (io_.outstanding() == 0) {
+      for (const int& fd : retired_fds_) {
+        close(fd);
+      }
+      retired_fds_.clear();
+    }
+  }
+
+  // drops the payloads read by a finished prefetch
+  void release_prefetch(unsigned ticket) {
+    auto it = prefetches_.find(ticket);
+    if (it == prefetches_.end()) {
+      return;
+    }
+
+    for (const Key& key : it->second->keys_) {
+      prefetched_.erase(key);
+    }
+    prefetches_.erase(it);
+  }
+
+  // whether there are buffered deltas or unsynced records
+  bool has_uncommitted() const {
+    return !pending_.empty() || !staged_.records_.empty() || !dirty_.empty();
+  }
+
+  // appends the keys that have buffered deltas
+  void uncommitted_keys(vector<Key>& keys) const {
+    for (const auto& pair : pending_) {
+      keys.push_back(pair.first);
+    }
+  }
+
+  // replaces whatever was logged (or buffered) for the key with a merged value
+  void replace(const Key& key, LatticeType type, const string& merged) {
+    pending_.erase(key);
+
+    LogIndexEntry& entry = index_[key];
+    entry.type_ = type;
+    replace(key, entry, merged);
+  }
+
+  // reads every record logged for the key followed by the deltas buffered for
+  // it, oldest first; returns false if the key is neither logged nor buffered
+  bool read(const Key& key, vector<string>& payloads) {
+    auto it = index_.find(key);
+    auto pending_it = pending_.find(key);
+
+    auto prefetched_it = prefetched_.find(key);
+
+    if (it == index_.end()) {
+      payloads.clear();
+    } else if (prefetched_it != prefetched_.end() &&
+               same_chain(prefetched_it->second.chain_, it->second.chain_)) {
+      payloads = prefetched_it->second.payloads_;
+    } else if (!read_chain(it->second, payloads)) {
+      return false;
+    }
+
+    if (pending_it != pending_.end()) {
+      payloads.insert(payloads.end(), pending_it->second.payloads_.begin(),
+                      pending_it->second.payloads_.end());
+    }
+
+    return it != index_.end() || pending_it != pending_.end();
+  }
+
+  void remove(const Key& key) {
+    pending_.erase(key);
+
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      return;
+    }
+
+    append_record(LogRecordKind::TOMBSTONE, it->second.type_, key, "");
+    release_chain(key, it->second);
+    index_.erase(it);
+  }
+
+  // whether reading the key has to go to disk
+  bool logged(const Key& key) const { return index_.find(key) != index_.end(); }
+
+  bool contains(const Key& key) const {
+    return index_.find(key) != index_.end() ||
+           pending_.find(key) != pending_.end();
+  }
+
+  // the number of records logged or buffered for the key
+  unsigned chain_length(const Key& key) const {
+    unsigned length = 0;
+
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      length += it->second.chain_.size();
+    }
+
+    auto pending_it = pending_.find(key);
+    if (pending_it != pending_.end()) {
+      length += pending_it->second.payloads_.size();
+    }
+
+    return length;
+  }
+
+  // the number of bytes currently logged (after compression) or buffered for
+  // the key
+  unsigned size(const Key& key) const {
+    unsigned size = 0;
+
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      for (const LogRecordLocation& loc : it->second.chain_) {
+        size += loc.length_;
+      }
+    }
+
+    auto pending_it = pending_.find(key);
+    if (pending_it != pending_.end()) {
+      for (const string& payload : pending_it->second.payloads_) {
+        size += payload.size();
+      }
+    }
+
+    return size;
+  }
+
+  const map<Key, LogIndexEntry>& index() const { return index_; }
+
+  unsigned segment_count() const { return segments_.size(); }
+
+  // makes incremental progress on compacting the sealed segment with the most
+  // garbage: every live record in it is folded into a FULL record at the head
+  // of the log. Once the segment has been scanned, the folded records are
+  // committed in the background and poll() deletes the segment when they are
+  // durable
+  void compact(unsigned budget = kLogCompactionBudget) {
+    if (!compacting_) {
+      if (!pick_compaction_segment(compact_segment_)) {
+        return;
+      }
+
+      compacting_ = true;
+      compact_cursor_ = 0;
+    }
+
+    LogSegment segment = segments_[compact_segment_];
+    char header[kLogHeaderSize];
+
+    for (unsigned i = 0; i < budget && compact_cursor_ < segment.size_; i++) {
+      if (!read_exact(segment.fd_, header, kLogHeaderSize, compact_cursor_)) {
+        break;
+      }
+
+      LogRecordKind kind = static_cast<LogRecordKind>(header[4] & 0x0f);
+      LatticeType type = static_cast<LatticeType>(header[5]);
+      unsigned key_length = decode_u32(header + 6);
+      unsigned value_length = decode_u32(header + 10);
+
+      Key key(key_length, '\0');
+      if (key_length > 0 &&
+          !read_exact(segment.fd_, &key[0], key_length,
+                      compact_cursor_ + kLogHeaderSize)) {
+        break;
+      }
+
+      unsigned long long value_offset =
+          compact_cursor_ + kLogHeaderSize + key_length;
+      compact_cursor_ = value_offset + value_length;
+
+      auto it = index_.find(key);
+      if (it != index_.end()) {
+        // if the key is live and this record is part of (or, for a tombstone,
+        // precedes) its value, fold the value into a new FULL record
+        if (kind == LogRecordKind::TOMBSTONE ||
+            in_chain(it->second, compact_segment_, value_offset)) {
+          fold(key, it->second);
+        }
+      } else if (kind == LogRecordKind::TOMBSTONE &&
+                 segments_.begin()->first != compact_segment_) {
+        // older segments may still hold records for this key, so the
+        // tombstone has to outlive this segment
+        append_record(LogRecordKind::TOMBSTONE, type, key, "");
+      }
+    }
+
+    if (compact_cursor_ >= segment.size_) {
+      // the folded records have to be durable, and so does the file of the
+      // segment they were written to, before the original is deleted; both
+      // are synced in the background and poll() deletes the segment after
+      auto batch = std::make_shared<LogCommitBatch>();
+      start_batch(*batch);
+      dirty_.erase(compact_segment_);
+      seal_batch(*batch);
+      batch->directory_ = directory_;
+
+      unsigned ticket =
+          io_.submit([batch]() { batch->durable_ = write_batch(*batch); });
+      commits_[ticket] = batch;
+      compactions_[ticket] = compact_segment_;
+      compacting_ = false;
+    }
+  }
+};
+
+#endif  // KVS_INCLUDE_KVS_EBS_LOG_HPP_
@@ -0,0 +1,356 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef KVS_INCLUDE_KVS_FLAT_KV_STORE_HPP_
+#define KVS_INCLUDE_KVS_FLAT_KV_STORE_HPP_
+
+#include <cstring>
+#include <functional>
+#include <memory>
+
+#include "common.hpp"
+
+// keys up to this many bytes are stored in the table itself; longer keys are
+// allocated separately
+const unsigned kFlatKeyInlineLength = 20;
+
+// the length of the key in a slot that is not in use
+const unsigned kFlatEmptySlot = ~0u;
+
+// values are allocated this many at a time
+const unsigned kFlatValueChunkSize = 4096;
+
+// the table doubles in size once it is this full (in percent)
+const unsigned kFlatMaxLoad = 70;
+
+const unsigned kFlatInitialCapacity = 16;
+
+// FlatKVSlot is a 32-byte entry of a FlatKVStore table. The hash of the key is
+// kept so that most mismatching slots are skipped without comparing keys, and
+// so that the table can grow without hashing any key again.
+struct FlatKVSlot {
+  unsigned hash_;
+  unsigned value_;
+  unsigned length_;
+
+  // the key itself if it fits, or a pointer to it otherwise
+  char key_[kFlatKeyInlineLength];
+};
+
+// FlatKVEntry is a value stored in a FlatKVStore. Once a value has been read
+// twice since it last changed, its serialized form is kept as well, so that
+// hot values are not serialized again for every GET and round of gossip;
+// values that are only read once in a while do not pay for a second copy.
+template <typename V>
+class FlatKVEntry {
+  V value_;
+
+  // the serialized form of the value is a cache, so it is filled in by reads
+  mutable std::unique_ptr<string> serialized_;
+  mutable bool read_;
+
+  void invalidate() {
+    serialized_.reset();
+    read_ = false;
+  }
+
+ public:
+  FlatKVEntry() : read_(false) {}
+
+  const V& value() const { return value_; }
+
+  string serialized() const {
+    if (serialized_ != nullptr) {
+      return *serialized_;
+    }
+
+    if (!read_) {
+      read_ = true;
+      return serialize(value_);
+    }
+
+    serialized_.reset(new string(serialize(value_)));
+    return *serialized_;
+  }
+
+  void merge(const V& v) {
+    value_.merge(v);
+    invalidate();
+  }
+
+  void merge(V&& v) {
+    value_.merge(std::move(v));
+    invalidate();
+  }
+
+  void merge_serialized(const string& serialized) {
+    ::merge_serialized(value_, serialized);
+    invalidate();
+  }
+
+  void clear() {
+    value_ = V();
+    invalidate();
+  }
+};
+
+// FlatKVStore is the backing store of the memory-tier serializers. Its table is
+// a single array of slots probed linearly, so a lookup usually reads one or two
+// cache lines and never follows a pointer for short keys. Values are allocated
+// in large chunks and referred to by index; the slots of removed values are
+// reused by later insertions. Removals shift the following slots back instead
+// of leaving tombstones, so lookups never slow down as keys churn.
+template <typename V>
+class FlatKVStore {
+  vector<FlatKVSlot> slots_;
+  unsigned count_;
+
+  vector<std::unique_ptr<FlatKVEntry<V>[]>> chunks_;
+  unsigned allocated_values_;
+  vector<unsigned> free_values_;
+
+  // the number of bytes allocated for keys that do not fit in their slots
+  size_t external_bytes_;
+
+  // what lookups of keys that are not stored return
+  FlatKVEntry<V> empty_;
+
+  static unsigned hash(const Key& key) {
+    return static_cast<unsigned>(std::hash<Key>()(key));
+  }
+
+  static const char* key_data(const FlatKVSlot& slot) {
+    if (slot.length_ <= kFlatKeyInlineLength) {
+      return slot.key_;
+    }
+
+    const char* data;
+    memcpy(&data, slot.key_, sizeof(data));
+    return data;
+  }
+
+  void set_key(FlatKVSlot& slot, const Key& key) {
+    slot.length_ = key.size();
+
+    if (key.size() <= kFlatKeyInlineLength) {
+      memcpy(slot.key_, key.data(), key.size());
+    } else {
+      char* data = new char[key.size()];
+      memcpy(data, key.data(), key.size());
+      memcpy(slot.key_, &data, sizeof(data));
+      external_bytes_ += key.size();
+    }
+  }
+
+  void release_key(FlatKVSlot& slot) {
+    if (slot.length_ != kFlatEmptySlot &&
+        slot.length_ > kFlatKeyInlineLength) {
+      external_bytes_ -= slot.length_;
+      delete[] key_data(slot);
+    }
+  }
+
+  FlatKVEntry<V>& entry(unsigned index) {
+    return chunks_[index / kFlatValueChunkSize][index % kFlatValueChunkSize];
+  }
+
+  const FlatKVEntry<V>& entry(unsigned index) const {
+    return chunks_[index / kFlatValueChunkSize][index % kFlatValueChunkSize];
+  }
+
+  unsigned allocate_value() {
+    if (!free_values_.empty()) {
+      unsigned index = free_values_.back();
+      free_values_.pop_back();
+      return index;
+    }
+
+    if (allocated_values_ == chunks_.size() * kFlatValueChunkSize) {
+      chunks_.push_back(std::unique_ptr<FlatKVEntry<V>[]>(
+          new FlatKVEntry<V>[kFlatValueChunkSize]));
+    }
+
+    return allocated_values_++;
+  }
+
+  // returns the index of the slot that holds key, or of the empty slot where
+  // it would be inserted
+  size_t find(const Key& key, unsigned h) const {
+    size_t mask = slots_.size() - 1;
+    size_t index = h & mask;
+
+    while (true) {
+      const FlatKVSlot& slot = slots_[index];
+      if (slot.length_ == kFlatEmptySlot) {
+        return index;
+      }
+
+      if (slot.hash_ == h && slot.length_ == key.size() &&
+          memcmp(key_data(slot), key.data(), key.size()) == 0) {
+        return index;
+      }
+
+      index = (index + 1) & mask;
+    }
+  }
+
+  void grow() {
+    vector<FlatKVSlot> old(slots_.size() * 2);
+    old.swap(slots_);
+
+    size_t mask = slots_.size() - 1;
+    for (auto& slot : slots_) {
+      slot.length_ = kFlatEmptySlot;
+    }
+
+    for (const auto& slot : old) {
+      if (slot.length_ == kFlatEmptySlot) {
+        continue;
+      }
+
+      size_t index = slot.hash_ & mask;
+      while (slots_[index].length_ != kFlatEmptySlot) {
+        index = (index + 1) & mask;
+      }
+      slots_[index] = slot;
+    }
+  }
+
+  // returns the entry of a key, adding an empty one if it is not stored
+  FlatKVEntry<V>& emplace(const Key& k) {
+    unsigned h = hash(k);
+    size_t index = find(k, h);
+
+    if (slots_[index].length_ == kFlatEmptySlot) {
+      if ((static_cast<size_t>(count_) + 1) * 100 >
+          slots_.size() * kFlatMaxLoad) {
+        grow();
+        index = find(k, h);
+      }
+
+      // values in the arena are empty until they are first merged into
+      FlatKVSlot& slot = slots_[index];
+      slot.hash_ = h;
+      slot.value_ = allocate_value();
+      set_key(slot, k);
+      count_++;
+    }
+
+    return entry(slots_[index].value_);
+  }
+
+ public:
+  FlatKVStore() :
+      slots_(kFlatInitialCapacity),
+      count_(0),
+      allocated_values_(0),
+      external_bytes_(0) {
+    for (auto& slot : slots_) {
+      slot.length_ = kFlatEmptySlot;
+    }
+  }
+
+  FlatKVStore(const FlatKVStore&) = delete;
+  FlatKVStore& operator=(const FlatKVStore&) = delete;
+
+  ~FlatKVStore() {
+    for (auto& slot : slots_) {
+      release_key(slot);
+    }
+  }
+
+  V get(const Key& k, unsigned& err_number) const {
+    return borrow(k, err_number).value();
+  }
+
+  // returns the stored entry of a key without copying it, or an empty entry
+  // (setting err_number to 1) if the key is not stored; the reference is only
+  // valid until the next put or remove
+  const FlatKVEntry<V>& borrow(const Key& k, unsigned& err_number) const {
+    const FlatKVSlot& slot = slots_[find(k, hash(k))];
+    if (slot.length_ == kFlatEmptySlot) {
+      err_number = 1;
+      return empty_;
+    }
+
+    return entry(slot.value_);
+  }
+
+  void put(const Key& k, const V& v) { emplace(k).merge(v); }
+
+  void put(const Key& k, V&& v) { emplace(k).merge(std::move(v)); }
+
+  // merges a serialized value into the value of a key without building a
+  // lattice from it first; returns the merged value
+  const V& merge_serialized(const Key& k, const string& serialized) {
+    FlatKVEntry<V>& entry = emplace(k);
+    entry.merge_serialized(serialized);
+    return entry.value();
+  }
+
+  unsigned size(const Key& k) {
+    const FlatKVSlot& slot = slots_[find(k, hash(k))];
+    if (slot.length_ == kFlatEmptySlot) {
+      return 0;
+    }
+
+    return entry(slot.value_).value().size().reveal();
+  }
+
+  void remove(const Key& k) {
+    size_t hole = find(k, hash(k));
+    if (slots_[hole].length_ == kFlatEmptySlot) {
+      return;
+    }
+
+    // release the value's own memory now, and its slot in the arena once it
+    // is reused
+    entry(slots_[hole].value_).clear();
+    free_values_.push_back(slots_[hole].value_);
+    release_key(slots_[hole]);
+    count_--;
+
+    // move back every following slot that would no longer be reachable from
+    // its home position across the hole
+    size_t mask = slots_.size() - 1;
+    size_t next = (hole + 1) & mask;
+    while (slots_[next].length_ != kFlatEmptySlot) {
+      size_t home = slots_[next].hash_ & mask;
+      if (((next - home) & mask) >= ((next - hole) & mask)) {
+        slots_[hole] = slots_[next];
+        hole = next;
+      }
+      next = (next + 1) & mask;
+    }
+
+    slots_[hole].length_ = kFlatEmptySlot;
+  }
+
+  bool contains(const Key& k) const {
+    return slots_[find(k, hash(k))].length_ != kFlatEmptySlot;
+  }
+
+  unsigned count() const { return count_; }
+
+  // the number of bytes held by the table, the value arena, and the keys that
+  // do not fit in their slots; memory owned by the values themselves (e.g.,
+  // the elements of a set) and their serialized forms is not included
+  size_t memory() const {
+    return slots_.size() * sizeof(FlatKVSlot) +
+           chunks_.size() * kFlatValueChunkSize * sizeof(FlatKVEntry<V>) +
+           free_values_.capacity() * sizeof(unsigned) + external_bytes_;
+  }
+};
+
+#endif  // KVS_INCLUDE_KVS_FLAT_KV_STORE_HPP_
@@ -0,0 +1,126 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef KVS_INCLUDE_KVS_IO_QUEUE_HPP_
+#define KVS_INCLUDE_KVS_IO_QUEUE_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "common.hpp"
+
+// the number of I/O jobs each server thread can have in flight at once
+const unsigned kIOThreadCount = 8;
+
+// IOQueue runs blocking I/O jobs on a small pool of worker threads, so that a
+// server thread can keep many I/Os outstanding while its event loop keeps
+// polling its sockets. Jobs are identified by the ticket returned from
+// submit(), and finished jobs are picked up with poll(). Only the owning
+// server thread may call submit(), poll(), and outstanding().
+class IOQueue {
+  std::mutex mutex_;
+  std::condition_variable submitted_cv_;
+  std::condition_variable completed_cv_;
+
+  std::deque<std::pair<unsigned, std::function<void()>>> submitted_;
+  vector<unsigned> completed_;
+
+  vector<std::thread> workers_;
+  bool stopping_;
+
+  unsigned next_ticket_;
+  unsigned outstanding_;
+
+  void work() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+      submitted_cv_.wait(lock,
+                         [this] { return stopping_ || !submitted_.empty(); });
+
+      if (submitted_.empty()) {
+        return;
+      }
+
+      auto job = std::move(submitted_.front());
+      submitted_.pop_front();
+
+      lock.unlock();
+      job.second();
+      lock.lock();
+
+      completed_.push_back(job.first);
+      completed_cv_.notify_all();
+    }
+  }
+
+ public:
+  IOQueue(unsigned thread_count = kIOThreadCount) :
+      stopping_(false),
+      next_ticket_(0),
+      outstanding_(0) {
+    for (unsigned i = 0; i < thread_count; i++) {
+      workers_.push_back(std::thread(&IOQueue::work, this));
+    }
+  }
+
+  // submitted jobs are run to completion before the workers exit
+  ~IOQueue() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+
+    submitted_cv_.notify_all();
+    for (std::thread& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  unsigned submit(std::function<void()> job) {
+    unsigned ticket = next_ticket_++;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      submitted_.push_back(std::make_pair(ticket, std::move(job)));
+    }
+
+    submitted_cv_.notify_one();
+    outstanding_ += 1;
+    return ticket;
+  }
+
+  // appends the tickets of the jobs that have finished since the last call
+  void poll(vector<unsigned>& completed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    completed.insert(completed.end(), completed_.begin(), completed_.end());
+    outstanding_ -= completed_.size();
+    completed_.clear();
+  }
+
+  // blocks until every submitted job has finished; the jobs still have to be
+  // picked up with poll()
+  void drain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    completed_cv_.wait(
+        lock, [this] { return completed_.size() == outstanding_; });
+  }
+
+  unsigned outstanding() const { return outstanding_; }
+};
+
+#endif  // KVS_INCLUDE_KVS_IO_QUEUE_HPP_
@@ -0,0 +1,416 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef KVS_INCLUDE_KVS_KEY_INDEX_HPP_
+#define KVS_INCLUDE_KVS_KEY_INDEX_HPP_
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include "common.hpp"
+
+// nodes keep their children in one of three layouts, depending on how many
+// they have: sorted arrays of child bytes and children (up to 16 children), a
+// 256-entry table mapping bytes to one of 48 child slots, or 256 children
+// indexed by byte
+enum KeyIndexLayout { SMALL_NODE = 0, MEDIUM_NODE = 1, LARGE_NODE = 2 };
+
+const unsigned kKeyIndexSmallCapacity = 16;
+const unsigned kKeyIndexMediumCapacity = 48;
+
+// nodes only move to a smaller layout once they are well below its capacity,
+// so that a node on the boundary does not keep switching back and forth
+const unsigned kKeyIndexSmallShrink = 12;
+const unsigned kKeyIndexMediumShrink = 36;
+
+// decides which keys a scan returns; keys it rejects do not count toward the
+// scan's limit
+using KeyFilter = std::function<bool(const Key&)>;
+
+struct KeyIndexNode {
+  // the bytes shared by every key below this node, following the byte that
+  // leads to it from its parent
+  string prefix_;
+
+  // whether a key ends at this node
+  bool terminal_;
+
+  KeyIndexLayout layout_;
+  unsigned count_;
+
+  // SMALL_NODE: the (sorted) bytes of the children
+  vector<unsigned char> bytes_;
+
+  // MEDIUM_NODE: for each byte, its slot in children_ plus one (0 if absent)
+  std::unique_ptr<unsigned char[]> slots_;
+
+  vector<std::unique_ptr<KeyIndexNode>> children_;
+
+  KeyIndexNode() :
+      terminal_(false),
+      layout_(KeyIndexLayout::SMALL_NODE),
+      count_(0) {}
+};
+
+// KeyIndex is an ordered index of the keys a server thread stores, built as
+// an adaptive radix tree: shared key prefixes are stored once, and each node
+// picks a child layout that fits the number of children it has. It supports
+// in-order scans over key ranges and prefixes.
+class KeyIndex {
+  std::unique_ptr<KeyIndexNode> root_;
+  unsigned size_;
+
+  static std::unique_ptr<KeyIndexNode>* find_child(KeyIndexNode& node,
+                                                   unsigned char byte) {
+    switch (node.layout_) {
+      case KeyIndexLayout::SMALL_NODE: {
+        auto it =
+            std::lower_bound(node.bytes_.begin(), node.bytes_.end(), byte);
+        if (it == node.bytes_.end() || *it != byte) {
+          return nullptr;
+        }
+        return &node.children_[it - node.bytes_.begin()];
+      }
+      case KeyIndexLayout::MEDIUM_NODE:
+        if (node.slots_[byte] == 0) {
+          return nullptr;
+        }
+        return &node.children_[node.slots_[byte] - 1];
+      default:
+        if (node.children_[byte] == nullptr) {
+          return nullptr;
+        }
+        return &node.children_[byte];
+    }
+  }
+
+  static const KeyIndexNode* child(const KeyIndexNode& node,
+                                   unsigned char byte) {
+    std::unique_ptr<KeyIndexNode>* slot =
+        find_child(const_cast<KeyIndexNode&>(node), byte);
+    return slot == nullptr ? nullptr : slot->get();
+  }
+
+  // moves the children of a node into the given layout
+  static void relayout(KeyIndexNode& node, KeyIndexLayout layout) {
+    // gather the children in byte order
+    vector<std::pair<unsigned char, std::unique_ptr<KeyIndexNode>>> children;
+    if (node.layout_ == KeyIndexLayout::SMALL_NODE) {
+      for (unsigned i = 0; i < node.bytes_.size(); i++) {
+        children.push_back(
+            std::make_pair(node.bytes_[i], std::move(node.children_[i])));
+      }
+    } else {
+      for (unsigned b = 0; b < 256; b++) {
+        std::unique_ptr<KeyIndexNode>* slot = find_child(node, b);
+        if (slot != nullptr) {
+          children.push_back(std::make_pair(b, std::move(*slot)));
+        }
+      }
+    }
+
+    node.layout_ = layout;
+    node.bytes_.clear();
+    node.slots_.reset();
+    node.children_.clear();
+
+    if (layout == KeyIndexLayout::MEDIUM_NODE) {
+      node.slots_.reset(new unsigned char[256]());
+      node.children_.resize(kKeyIndexMediumCapacity);
+    } else if (layout == KeyIndexLayout::LARGE_NODE) {
+      node.children_.resize(256);
+    }
+
+    for (unsigned i = 0; i < children.size(); i++) {
+      unsigned char byte = children[i].first;
+      if (layout == KeyIndexLayout::SMALL_NODE) {
+        node.bytes_.push_back(byte);
+        node.children_.push_back(std::move(children[i].second));
+      } else if (layout == KeyIndexLayout::MEDIUM_NODE) {
+        node.slots_[byte] = i + 1;
+        node.children_[i] = std::move(children[i].second);
+      } else {
+        node.children_[byte] = std::move(children[i].second);
+      }
+    }
+  }
+
+  static void add_child(KeyIndexNode& node, unsigned char byte,
+                        std::unique_ptr<KeyIndexNode> child) {
+    if (node.layout_ == KeyIndexLayout::SMALL_NODE &&
+        node.count_ == kKeyIndexSmallCapacity) {
+      relayout(node, KeyIndexLayout::MEDIUM_NODE);
+    } else if (node.layout_ == KeyIndexLayout::MEDIUM_NODE &&
+               node.count_ == kKeyIndexMediumCapacity) {
+      relayout(node, KeyIndexLayout::LARGE_NODE);
+    }
+
+    if (node.layout_ == KeyIndexLayout::SMALL_NODE) {
+      auto it = std::lower_bound(node.bytes_.begin(), node.bytes_.end(), byte);
+      size_t position = it - node.bytes_.begin();
+      node.children_.insert(node.children_.begin() + position,
+                            std::move(child));
+      node.bytes_.insert(it, byte);
+    } else if (node.layout_ == KeyIndexLayout::MEDIUM_NODE) {
+      unsigned slot = 0;
+      while (node.children_[slot] != nullptr) {
+        slot++;
+      }
+      node.children_[slot] = std::move(child);
+      node.slots_[byte] = slot + 1;
+    } else {
+      node.children_[byte] = std::move(child);
+    }
+
+    node.count_ += 1;
+  }
+
+  static void remove_child(KeyIndexNode& node, unsigned char byte) {
+    if (node.layout_ == KeyIndexLayout::SMALL_NODE) {
+      auto it = std::lower_bound(node.bytes_.begin(), node.bytes_.end(), byte);
+      node.children_.erase(node.children_.begin() +
+                           (it - node.bytes_.begin()));
+      node.bytes_.erase(it);
+    } else if (node.layout_ == KeyIndexLayout::MEDIUM_NODE) {
+      node.children_[node.slots_[byte] - 1].reset();
+      node.slots_[byte] = 0;
+    } else {
+      node.children_[byte].reset();
+    }
+
+    node.count_ -= 1;
+
+    if (node.layout_ == KeyIndexLayout::LARGE_NODE &&
+        node.count_ <= kKeyIndexMediumShrink) {
+      relayout(node, KeyIndexLayout::MEDIUM_NODE);
+    } else if (node.layout_ == KeyIndexLayout::MEDIUM_NODE &&
+               node.count_ <= kKeyIndexSmallShrink) {
+      relayout(node, KeyIndexLayout::SMALL_NODE);
+    }
+  }
+
+  // merges a node that no key ends at into its only child
+  static void compress(std::unique_ptr<KeyIndexNode>& slot) {
+    KeyIndexNode& node = *slot;
+    if (node.terminal_ || node.count_ != 1) {
+      return;
+    }
+
+    for (unsigned b = 0; b < 256; b++) {
+      std::unique_ptr<KeyIndexNode>* only = find_child(node, b);
+      if (only != nullptr) {
+        std::unique_ptr<KeyIndexNode> merged = std::move(*only);
+        merged->prefix_ = node.prefix_ + static_cast<char>(b) + merged->prefix_;
+        slot = std::move(merged);
+        return;
+      }
+    }
+  }
+
+  bool erase(std::unique_ptr<KeyIndexNode>& slot, const Key& key, size_t depth,
+             bool root) {
+    KeyIndexNode& node = *slot;
+    if (key.size() - depth < node.prefix_.size() ||
+        key.compare(depth, node.prefix_.size(), node.prefix_) != 0) {
+      return false;
+    }
+    depth += node.prefix_.size();
+
+    if (depth == key.size()) {
+      if (!node.terminal_) {
+        return false;
+      }
+      node.terminal_ = false;
+    } else {
+      unsigned char byte = key[depth];
+      std::unique_ptr<KeyIndexNode>* next = find_child(node, byte);
+      if (next == nullptr || !erase(*next, key, depth + 1, false)) {
+        return false;
+      }
+
+      if (!(*next)->terminal_ && (*next)->count_ == 0) {
+        remove_child(node, byte);
+      }
+    }
+
+    if (!root) {
+      compress(slot);
+    }
+    return true;
+  }
+
+  // appends the keys below the node that fall in [start, end) and that the
+  // filter accepts to keys, in order; returns false once the scan is over
+  bool scan(const KeyIndexNode& node, string& path, const Key& start,
+            const Key& end, unsigned limit, const KeyFilter& accept,
+            vector<Key>& keys) const {
+    size_t length = path.size();
+    path += node.prefix_;
+
+    // every key below this node starts with path, so if path is past the end
+    // of the range, so is everything after it
+    if (!end.empty() && path >= end) {
+      path.resize(length);
+      return false;
+    }
+
+    // if path is before the start of the range and not a prefix of it, so is
+    // every key below this node
+    if (path < start && start.compare(0, path.size(), path) != 0) {
+      path.resize(length);
+      return true;
+    }
+
+    if (node.terminal_ && path >= start && (!accept || accept(path))) {
+      keys.push_back(path);
+      if (limit > 0 && keys.size() >= limit) {
+        path.resize(length);
+        return false;
+      }
+    }
+
+    bool more = true;
+    for (unsigned b = 0; b < 256 && more; b++) {
+      const KeyIndexNode* next;
+      if (node.layout_ == KeyIndexLayout::SMALL_NODE) {
+        // only visit the bytes that are present
+        if (b >= node.bytes_.size()) {
+          break;
+        }
+        path.push_back(static_cast<char>(node.bytes_[b]));
+        next = node.children_[b].get();
+      } else {
+        next = child(node, b);
+        if (next == nullptr) {
+          continue;
+        }
+        path.push_back(static_cast<char>(b));
+      }
+
+      more = scan(*next, path, start, end, limit, accept, keys);
+      path.pop_back();
+    }
+
+    path.resize(length);
+    return more;
+  }
+
+ public:
+  KeyIndex() : root_(new KeyIndexNode()), size_(0) {}
+
+  // returns false if the key was already indexed
+  bool insert(const Key& key) {
+    std::unique_ptr<KeyIndexNode>* slot = &root_;
+    size_t depth = 0;
+
+    while (true) {
+      KeyIndexNode* node = slot->get();
+
+      size_t matched = 0;
+      while (matched < node->prefix_.size() && depth + matched < key.size() &&
+             node->prefix_[matched] == key[depth + matched]) {
+        matched++;
+      }
+
+      if (matched < node->prefix_.size()) {
+        // split the node where the key diverges from its prefix
+        std::unique_ptr<KeyIndexNode> parent(new KeyIndexNode());
+        parent->prefix_ = node->prefix_.substr(0, matched);
+        unsigned char byte = node->prefix_[matched];
+        node->prefix_ = node->prefix_.substr(matched + 1);
+
+        add_child(*parent, byte, std::move(*slot));
+        *slot = std::move(parent);
+        node = slot->get();
+      }
+
+      depth += matched;
+      if (depth == key.size()) {
+        if (node->terminal_) {
+          return false;
+        }
+
+        node->terminal_ = true;
+        size_ += 1;
+        return true;
+      }
+
+      unsigned char byte = key[depth];
+      std::unique_ptr<KeyIndexNode>* next = find_child(*node, byte);
+      if (next == nullptr) {
+        std::unique_ptr<KeyIndexNode> leaf(new KeyIndexNode());
+        leaf->prefix_ = key.substr(depth + 1);
+        leaf->terminal_ = true;
+        add_child(*node, byte, std::move(leaf));
+
+        size_ += 1;
+        return true;
+      }
+
+      slot = next;
+      depth += 1;
+    }
+  }
+
+  // returns false if the key was not indexed
+  bool remove(const Key& key) {
+    if (!erase(root_, key, 0, true)) {
+      return false;
+    }
+
+    size_ -= 1;
+    return true;
+  }
+
+  bool contains(const Key& key) const {
+    const KeyIndexNode* node = root_.get();
+    size_t depth = 0;
+
+    while (node != nullptr) {
+      if (key.size() - depth < node->prefix_.size() ||
+          key.compare(depth, node->prefix_.size(), node->prefix_) != 0) {
+        return false;
+      }
+
+      depth += node->prefix_.size();
+      if (depth == key.size()) {
+        return node->terminal_;
+      }
+
+      node = child(*node, key[depth]);
+      depth += 1;
+    }
+
+    return false;
+  }
+
+  // appends the keys in [start, end) to keys in order, stopping after limit
+  // keys (if limit is not 0); an empty end means the range is unbounded. If
+  // a filter is given, only the keys it accepts are returned and counted.
+  void scan(const Key& start, const Key& end, unsigned limit,
+            vector<Key>& keys, const KeyFilter& accept = KeyFilter()) const {
+    string path;
+    scan(*root_, path, start, end, limit, accept, keys);
+  }
+
+  // appends the keys that start with the given prefix to keys in order
+  void scan_prefix(const Key& prefix, unsigned limit, vector<Key>& keys) const {
+    scan(prefix, prefix_end(prefix), limit, keys);
+  }
+
+  unsigned size() const { return size_; }
+};
+
+#endif  // KVS_INCLUDE_KVS_KEY_INDEX_HPP_
@@ -20,6 +20,7 @@
 #include "replication.pb.h"
 #include "requests.hpp"
 #include "server_utils.hpp"
+#include "snapshot.hpp"
 
 void node_join_handler(unsigned thread_id, unsigned& seed, Address public_ip,
                        Address private_ip, logger log, string& serialized,
@@ -53,8 +54,22 @@ void user_request_handler(
     map<Key, vector<PendingRequest>>& pending_requests,
     map<Key, std::multiset<TimePoint>>& key_access_tracker,
     map<Key, KeyProperty>& stored_key_map,
-    map<Key, KeyReplication>& key_replication_map, set<Key>& local_changeset,
-    ServerThread& wt, SerializerMap& serializers, SocketCache& pushers);
+    map<Key, KeyReplication>& key_replication_map,
+    map<Key, KeyDelta>& local_changeset, ServerThread& wt,
+    SerializerMap& serializers, SocketCache& pushers,
+    map<Address, vector<string>>& uncommitted_responses);
+
+// the keys in the range of a SCAN request that this thread has values for, in
+// order and up to the request's limit; metadata keys are left out
+void scan_keys(const KeyRequest& request, const KeyIndex& key_index,
+               map<Key, KeyProperty>& stored_key_map, vector<Key>& keys);
+
+// responds to a SCAN request with the given keys, found by scan_keys; a
+// thread without a key index rejects it
+void scan_request_handler(const KeyRequest& request, KeyIndex* key_index,
+                          const vector<Key>& keys,
+                          map<Key, KeyProperty>& stored_key_map,
+                          SerializerMap& serializers, SocketCache& pushers);
 
 void gossip_handler(unsigned& seed, string& serialized,
                     map<TierId, GlobalHashRing>& global_hash_rings,
@@ -62,6 +77,9 @@ void gossip_handler(unsigned& seed, string& serialized,
                     map<Key, vector<PendingGossip>>& pending_gossip,
                     map<Key, KeyProperty>& stored_key_map,
                     map<Key, KeyReplication>& key_replication_map,
+                    set<Key>& merkle_changeset,
+                    map<Address, ReplicationOffset>& gossip_offsets,
+                    map<Address, ReplicationStream>& replication_streams,
                     ServerThread& wt, SerializerMap& serializers,
                     SocketCache& pushers, logger log);
 
@@ -73,8 +91,10 @@ void replication_response_handler(
     map<Key, vector<PendingGossip>>& pending_gossip,
     map<Key, std::multiset<TimePoint>>& key_access_tracker,
     map<Key, KeyProperty>& stored_key_map,
-    map<Key, KeyReplication>& key_replication_map, set<Key>& local_changeset,
-    ServerThread& wt, SerializerMap& serializers, SocketCache& pushers);
+    map<Key, KeyReplication>& key_replication_map,
+    map<Key, KeyDelta>& local_changeset, set<Key>& merkle_changeset,
+    ServerThread& wt, SerializerMap& serializers, SocketCache& pushers,
+    map<Address, vector<string>>& uncommitted_responses);
 
 void replication_change_handler(Address public_ip, Address private_ip,
                                 unsigned thread_id, unsigned& seed, logger log,
@@ -83,7 +103,8 @@ void replication_change_handler(Address public_ip, Address private_ip,
                                 map<TierId, LocalHashRing>& local_hash_rings,
                                 map<Key, KeyProperty>& stored_key_map,
                                 map<Key, KeyReplication>& key_replication_map,
-                                set<Key>& local_changeset, ServerThread& wt,
+                                map<Key, KeyDelta>& local_changeset,
+                                set<Key>& merkle_changeset, ServerThread& wt,
                                 SerializerMap& serializers,
                                 SocketCache& pushers);
 
@@ -95,16 +116,115 @@ void cache_ip_response_handler(string& serialized,
                                map<Address, set<Key>>& cache_ip_to_keys,
                                map<Key, set<Address>>& key_to_cache_ips);
 
+// compares the digests of a peer's Merkle tree with this thread's tree for the
+// peer, and either descends into the nodes that differ or, at the leaves,
+// exchanges the keys in them
+void anti_entropy_handler(string& serialized,
+                          map<Address, MerkleTree>& merkle_trees,
+                          map<Key, KeyProperty>& stored_key_map,
+                          ServerThread& wt, SerializerMap& serializers,
+                          SocketCache& pushers);
+
+// adds the whole values of the keys to the gossip for each address
+void prepare_gossip(AddressKeysetMap& addr_keyset_map,
+                    SerializerMap& serializers,
+                    map<Key, KeyProperty>& stored_key_map,
+                    map<Address, KeyRequest>& gossip_map);
+
 void send_gossip(AddressKeysetMap& addr_keyset_map, SocketCache& pushers,
                  SerializerMap& serializers,
                  map<Key, KeyProperty>& stored_key_map);
 
+// adds the changes to each key recorded in the changeset since the last round
+// to the gossip for each address, or the whole value of keys whose changes
+// were not all recorded
+void prepare_delta_gossip(AddressKeysetMap& addr_keyset_map,
+                          SerializerMap& serializers,
+                          map<Key, KeyProperty>& stored_key_map,
+                          const map<Key, KeyDelta>& local_changeset,
+                          map<Address, KeyRequest>& gossip_map);
+
+// queues the gossip for each replica on the replica's replication stream,
+// which keeps it until the replica acknowledges it
+void queue_replicated_gossip(map<Address, KeyRequest>& gossip_map,
+                             map<Address, ReplicationStream>& streams,
+                             ServerThread& wt);
+
+// sends each replica its next batch of gossip, which is either one that it
+// has not acknowledged in time or a queued one; returns whether any batches
+// are left to send
+bool send_paced_gossip(map<Address, ReplicationStream>& streams,
+                       SocketCache& pushers, const Codec* codec,
+                       GossipStatistics& stats);
+
+// drops the streams of replicas that have stopped acknowledging gossip;
+// returns whether any of the others have batches to send (again)
+bool expire_replication_streams(map<Address, ReplicationStream>& streams);
+
+// records a payload that a request merged into a stored key
+void track_delta(KeyDelta& delta, string payload);
+
+// merges serialized payloads of the given lattice type into one
+string merge_payloads(LatticeType lattice_type, const vector<string>& payloads);
+
+// the digest of a stored key's value
+unsigned long long get_key_digest(const Key& key,
+                                  const KeyProperty& property,
+                                  SerializerMap& serializers);
+
+// brings the keys in the changeset up to date in this thread's Merkle tree
+// for each other replica of them, which covers the keys the two threads
+// share; trees are indexed by the anti-entropy address of the replica, and
+// the changeset is cleared
+void update_merkle_trees(unsigned& seed,
+                         map<TierId, GlobalHashRing>& global_hash_rings,
+                         map<TierId, LocalHashRing>& local_hash_rings,
+                         map<Key, KeyProperty>& stored_key_map,
+                         map<Key, KeyReplication>& key_replication_map,
+                         ServerThread& wt, SerializerMap& serializers,
+                         SocketCache& pushers, set<Key>& merkle_changeset,
+                         map<Address, MerkleTree>& merkle_trees);
+
+// rechecks which trees the next few queued keys belong in, e.g., after the
+// membership of the cluster changed, reusing the digests the trees already
+// have for them; keys that no tree has yet are digested
+void relocate_merkle_keys(unsigned& seed,
+                          map<TierId, GlobalHashRing>& global_hash_rings,
+                          map<TierId, LocalHashRing>& local_hash_rings,
+                          map<Key, KeyProperty>& stored_key_map,
+                          map<Key, KeyReplication>& key_replication_map,
+                          ServerThread& wt, SerializerMap& serializers,
+                          SocketCache& pushers,
+                          std::deque<Key>& merkle_relocations,
+                          map<Address, MerkleTree>& merkle_trees);
+
+// starts an anti-entropy exchange with every replica by sending it the root
+// of this thread's tree for it
+void send_merkle_roots(const map<Address, MerkleTree>& merkle_trees,
+                       ServerThread& wt, SocketCache& pushers);
+
 std::pair<string, unsigned> process_get(const Key& key, Serializer* serializer);
 
 void process_put(const Key& key, LatticeType lattice_type,
                  const string& payload, Serializer* serializer,
                  map<Key, KeyProperty>& stored_key_map);
 
+// applies an INCREMENT of a counter by adding to the count owned by replica
+// (this thread), and records the change in the changeset; returns false if
+// the key is not a counter or the increment is malformed
+bool process_increment(const Key& key, LatticeType lattice_type,
+                       const string& payload, const string& replica,
+                       Serializer* serializer,
+                       map<Key, KeyProperty>& stored_key_map,
+                       map<Key, KeyDelta>& local_changeset);
+
+// the replicas of a key that this thread passes gossip from the given root on
+// to; empty if this thread is a leaf of the tree, or if it or the root is not
+// one of the replicas
+ServerThreadList tree_gossip_children(ServerThreadList threads,
+                                      const Address& root,
+                                      const ServerThread& wt);
+
 bool is_primary_replica(const Key& key,
                         map<Key, KeyReplication>& key_replication_map,
                         map<TierId, GlobalHashRing>& global_hash_rings,
@@ -0,0 +1,197 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef KVS_INCLUDE_KVS_MERKLE_TREE_HPP_
+#define KVS_INCLUDE_KVS_MERKLE_TREE_HPP_
+
+#include <limits>
+
+#include "common.hpp"
+#include "google/protobuf/unknown_field_set.h"
+
+// the number of children of each inner node of a Merkle tree
+const unsigned kMerkleFanout = 16;
+
+// the level of the leaves of a Merkle tree, the root being at level 0; the
+// tree therefore has 16^3 = 4096 leaves
+const unsigned kMerkleDepth = 3;
+
+// scrambles the bits of a hash, so that sums of digests do not cancel out
+inline unsigned long long mix_digest(unsigned long long h) {
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ull;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebull;
+  h ^= h >> 31;
+  return h;
+}
+
+// the digest of a key and its serialized value. Replicas that hold the same
+// set or map may have serialized its elements in different orders, so the
+// top-level fields of the payload are hashed independently and summed.
+inline unsigned long long key_digest(const Key& key, const string& payload) {
+  std::hash<string> hasher;
+  unsigned long long value_digest = 0;
+
+  google::protobuf::UnknownFieldSet fields;
+  if (!fields.ParseFromString(payload)) {
+    value_digest = hasher(payload);
+  } else {
+    for (int i = 0; i < fields.field_count(); i++) {
+      const google::protobuf::UnknownField& field = fields.field(i);
+      string element = std::to_string(field.number()) + ":";
+
+      switch (field.type()) {
+        case google::protobuf::UnknownField::TYPE_VARINT:
+          element += std::to_string(field.varint());
+          break;
+        case google::protobuf::UnknownField::TYPE_FIXED32:
+          element += std::to_string(field.fixed32());
+          break;
+        case google::protobuf::UnknownField::TYPE_FIXED64:
+          element += std::to_string(field.fixed64());
+          break;
+        case google::protobuf::UnknownField::TYPE_LENGTH_DELIMITED:
+          element += field.length_delimited();
+          break;
+        default: break;
+      }
+
+      value_digest += mix_digest(hasher(element));
+    }
+  }
+
+  return mix_digest(hasher(key) ^ value_digest);
+}
+
+// MerkleTree summarizes keys and their values by key-hash range, so that two
+// replicas can find the ranges they disagree on by comparing a few hashes at a
+// time from the root down. Each leaf covers an equal range of key hashes, and
+// the hash of a node is the sum of the digests of the keys under it, so that
+// adding, updating or removing a key only updates the nodes on its path.
+class MerkleTree {
+  // levels_[l] holds the hashes of the 16^l nodes at level l
+  vector<vector<unsigned long long>> levels_;
+
+  // the keys in each leaf that has any, and their digests
+  map<unsigned, map<Key, unsigned long long>> leaf_keys_;
+
+  // adds to the hashes of a leaf and its ancestors; sums wrap around, so
+  // adding the negation of a digest takes it away again
+  void add_to_path(unsigned node, unsigned long long delta) {
+    for (unsigned level = kMerkleDepth + 1; level-- > 0;) {
+      levels_[level][node] += delta;
+      node /= kMerkleFanout;
+    }
+  }
+
+ public:
+  MerkleTree() : levels_(kMerkleDepth + 1) {
+    for (unsigned level = 0; level <= kMerkleDepth; level++) {
+      levels_[level].assign(width(level), 0);
+    }
+  }
+
+  // the number of nodes at a level
+  static unsigned width(unsigned level) {
+    unsigned result = 1;
+    for (unsigned i = 0; i < level; i++) {
+      result *= kMerkleFanout;
+    }
+    return result;
+  }
+
+  // the leaf whose range of hashes holds the key's
+  static unsigned leaf(const Key& key) {
+    unsigned long long range =
+        std::numeric_limits<size_t>::max() / width(kMerkleDepth) + 1;
+    return std::hash<Key>()(key) / range;
+  }
+
+  // adds a key, or replaces its digest if the tree already has it
+  void add(const Key& key, unsigned long long digest) {
+    unsigned node = leaf(key);
+    map<Key, unsigned long long>& keys = leaf_keys_[node];
+
+    auto it = keys.find(key);
+    if (it == keys.end()) {
+      keys[key] = digest;
+      add_to_path(node, digest);
+    } else {
+      add_to_path(node, digest - it->second);
+      it->second = digest;
+    }
+  }
+
+  void remove(const Key& key) {
+    unsigned node = leaf(key);
+    auto leaf_it = leaf_keys_.find(node);
+    if (leaf_it == leaf_keys_.end()) {
+      return;
+    }
+
+    auto it = leaf_it->second.find(key);
+    if (it == leaf_it->second.end()) {
+      return;
+    }
+
+    add_to_path(node, -it->second);
+    leaf_it->second.erase(it);
+
+    if (leaf_it->second.empty()) {
+      leaf_keys_.erase(leaf_it);
+    }
+  }
+
+  // looks up the digest the tree has for a key; returns false if it has none
+  bool find(const Key& key, unsigned long long& digest) const {
+    auto leaf_it = leaf_keys_.find(leaf(key));
+    if (leaf_it == leaf_keys_.end()) {
+      return false;
+    }
+
+    auto it = leaf_it->second.find(key);
+    if (it == leaf_it->second.end()) {
+      return false;
+    }
+
+    digest = it->second;
+    return true;
+  }
+
+  bool empty() const { return leaf_keys_.empty(); }
+
+  // the hash of a node, or 0 if there is no such node
+  unsigned long long hash(unsigned level, unsigned node) const {
+    if (level > kMerkleDepth || node >= levels_[level].size()) {
+      return 0;
+    }
+    return levels_[level][node];
+  }
+
+  vector<Key> keys(unsigned leaf) const {
+    vector<Key> result;
+
+    auto it = leaf_keys_.find(leaf);
+    if (it != leaf_keys_.end()) {
+      for (const auto& key_pair : it->second) {
+        result.push_back(key_pair.first);
+      }
+    }
+
+    return result;
+  }
+};
+
+#endif  // KVS_INCLUDE_KVS_MERKLE_TREE_HPP_
@@ -0,0 +1,278 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef KVS_INCLUDE_KVS_REPLICATION_STREAM_HPP_
+#define KVS_INCLUDE_KVS_REPLICATION_STREAM_HPP_
+
+#include <deque>
+
+#include "codec.hpp"
+#include "common.hpp"
+
+// the most bytes of unacknowledged gossip a thread keeps for each replica
+const unsigned long long kReplicationLogCapacity = 16 * 1000 * 1000;
+
+// gossip to a replica is split into messages of at most this many bytes
+// (before compression), unless a single key is larger
+const unsigned long long kMaxGossipBatchBytes = 1000 * 1000;
+
+// how long (in milliseconds) gossip waits to be acknowledged before it is sent
+// again
+const unsigned long long kReplicationResendTimeout = 1000;
+
+// how long (in milliseconds) a replica can leave gossip unacknowledged before
+// its stream is dropped, e.g., because it has left the cluster
+const unsigned long long kReplicationStreamTimeout = 5 * 60 * 1000;
+
+// the gossip a thread has sent since its last report
+struct GossipStatistics {
+  unsigned long long bytes_;
+  unsigned batch_count_;
+  unsigned long long max_batch_bytes_;
+
+  GossipStatistics() : bytes_(0), batch_count_(0), max_batch_bytes_(0) {}
+
+  void record(unsigned long long bytes) {
+    bytes_ += bytes;
+    batch_count_ += 1;
+    max_batch_bytes_ = std::max(max_batch_bytes_, bytes);
+  }
+};
+
+// splits the tuples of a gossip request into requests of at most
+// kMaxGossipBatchBytes each
+inline vector<KeyRequest> split_gossip(KeyRequest& request) {
+  vector<KeyRequest> batches;
+  unsigned long long batch_bytes = 0;
+
+  for (KeyTuple& tuple : *request.mutable_tuples()) {
+    unsigned long long tuple_bytes = tuple.ByteSizeLong();
+    if (batches.empty() ||
+        (batches.back().tuples_size() > 0 &&
+         batch_bytes + tuple_bytes > kMaxGossipBatchBytes)) {
+      batches.push_back(KeyRequest());
+      batches.back().set_type(request.type());
+      batch_bytes = 0;
+    }
+
+    batch_bytes += tuple_bytes;
+    *batches.back().add_tuples() = std::move(tuple);
+  }
+
+  return batches;
+}
+
+// how far a thread has applied the gossip it receives from one replica
+struct ReplicationOffset {
+  // the stream being received; the replica starts a new one when it restarts
+  unsigned long long epoch_;
+
+  // the number of the next batch to apply
+  unsigned long long next_;
+
+  ReplicationOffset() : epoch_(0), next_(0) {}
+};
+
+struct ReplicationEntry {
+  KeyRequest request_;
+  vector<Key> keys_;
+  unsigned long long size_;
+
+  // when (in milliseconds since the epoch) the entry was last sent, or 0 if
+  // it has not been sent yet
+  unsigned long long sent_;
+};
+
+// ReplicationStream is the gossip one thread sends to one replica. Gossip is
+// split into bounded batches, each of which is numbered and kept until the
+// replica acknowledges it, and is sent again while it is not, so a replica
+// that missed messages catches up from where it left off. Batches, including
+// the ones sent again, are sent one at a time rather than all at once, so that
+// a burst of changes does not stall either end. Once the unacknowledged
+// batches outgrow the log, the oldest are dropped, and the keys in them have
+// to be sent whole instead.
+class ReplicationStream {
+  // identifies the stream to the replica, which starts counting afresh when
+  // it changes (e.g., because this thread restarted)
+  unsigned long long epoch_;
+
+  // the sequence number of the next batch
+  unsigned long long next_;
+
+  // the unacknowledged batches, oldest first; the last unsent_ of them have
+  // not been sent yet
+  std::deque<ReplicationEntry> log_;
+  unsigned long long unsent_;
+  unsigned long long bytes_;
+  unsigned long long capacity_;
+
+  set<Key> lost_keys_;
+
+  // when the stream last made progress
+  unsigned long long active_;
+
+  // the index of the oldest sent batch that has waited too long to be
+  // acknowledged, or the number of sent batches if none has
+  unsigned long long overdue(unsigned long long now) const {
+    unsigned long long sent = log_.size() - unsent_;
+    for (unsigned long long i = 0; i < sent; i++) {
+      if (log_[i].sent_ + kReplicationResendTimeout <= now) {
+        return i;
+      }
+    }
+    return sent;
+  }
+
+  string serialize_entry(ReplicationEntry& entry, const Codec* codec) const {
+    if (codec != nullptr && entry.request_.tuples_size() > 0 &&
+        !entry.request_.has_compressed_tuples()) {
+      KeyRequest tuples;
+      tuples.set_type(entry.request_.type());
+      tuples.mutable_tuples()->Swap(entry.request_.mutable_tuples());
+
+      string serialized;
+      string compressed;
+      tuples.SerializeToString(&serialized);
+
+      if (codec->compress(serialized, compressed)) {
+        entry.request_.set_compressed_tuples(std::move(compressed));
+        entry.request_.set_codec(codec->id());
+      } else {
+        entry.request_.mutable_tuples()->Swap(tuples.mutable_tuples());
+      }
+    }
+
+    entry.request_.set_first(first());
+    entry.request_.set_epoch(epoch_);
+
+    string serialized;
+    entry.request_.SerializeToString(&serialized);
+    return serialized;
+  }
+
+ public:
+  ReplicationStream(unsigned long long capacity = kReplicationLogCapacity) :
+      epoch_(get_time()),
+      next_(0),
+      unsent_(0),
+      bytes_(0),
+      capacity_(capacity),
+      active_(get_time()) {}
+
+  // the oldest batch the stream can still send; the replica should skip
+  // ahead to it if it is still waiting for an older one
+  unsigned long long first() const {
+    if (log_.empty()) {
+      return next_;
+    }
+    return log_.front().request_.sequence();
+  }
+
+  unsigned long long epoch() const { return epoch_; }
+
+  unsigned long long next() const { return next_; }
+
+  unsigned long long size() const { return log_.size(); }
+
+  bool has_unsent() const { return unsent_ > 0; }
+
+  // whether send() has a batch to send, either a new one or one that has
+  // waited too long to be acknowledged
+  bool has_due(unsigned long long now) const {
+    return unsent_ > 0 || overdue(now) < log_.size() - unsent_;
+  }
+
+  // splits the tuples of the request into batches and logs them to be sent
+  void append(KeyRequest request, const Address& ack_address,
+              unsigned long long now) {
+    if (log_.size() == unsent_) {
+      active_ = now;
+    }
+
+    for (KeyRequest& batch : split_gossip(request)) {
+      batch.set_sequence(next_++);
+      batch.set_ack_address(ack_address);
+
+      ReplicationEntry entry;
+      for (const KeyTuple& tuple : batch.tuples()) {
+        entry.keys_.push_back(tuple.key());
+      }
+      entry.size_ = batch.ByteSizeLong();
+      entry.request_ = std::move(batch);
+      entry.sent_ = 0;
+
+      bytes_ += entry.size_;
+      log_.push_back(std::move(entry));
+      unsent_ += 1;
+    }
+
+    while (bytes_ > capacity_ && log_.size() > 1) {
+      for (const Key& key : log_.front().keys_) {
+        lost_keys_.insert(key);
+      }
+
+      bytes_ -= log_.front().size_;
+      log_.pop_front();
+      unsent_ = std::min(unsent_, static_cast<unsigned long long>(log_.size()));
+    }
+  }
+
+  // the replica has received every batch of the stream with the given epoch
+  // numbered below next; acknowledgements of an earlier stream are ignored
+  void ack(unsigned long long epoch, unsigned long long next,
+           unsigned long long now) {
+    if (epoch != epoch_) {
+      return;
+    }
+
+    while (log_.size() > unsent_ &&
+           log_.front().request_.sequence() < next) {
+      bytes_ -= log_.front().size_;
+      log_.pop_front();
+      active_ = now;
+    }
+  }
+
+  // the next batch to send, serialized (and compressed with the codec, if
+  // there is one and it saves space): the oldest one that has waited too long
+  // to be acknowledged, or else the oldest one that has not been sent yet;
+  // empty if there is none
+  string send(unsigned long long now, const Codec* codec) {
+    unsigned long long index = overdue(now);
+    if (index == log_.size() - unsent_) {
+      if (unsent_ == 0) {
+        return "";
+      }
+      unsent_ -= 1;
+    }
+
+    ReplicationEntry& entry = log_[index];
+    entry.sent_ = now;
+    return serialize_entry(entry, codec);
+  }
+
+  // whether the replica has acknowledged nothing for too long
+  bool stalled(unsigned long long now) const {
+    return log_.size() > unsent_ && active_ + kReplicationStreamTimeout <= now;
+  }
+
+  // the keys in batches dropped since the last call
+  set<Key> take_lost_keys() {
+    set<Key> keys;
+    keys.swap(lost_keys_);
+    return keys;
+  }
+};
+
+#endif  // KVS_INCLUDE_KVS_REPLICATION_STREAM_HPP_
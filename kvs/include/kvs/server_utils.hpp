@@ -15,13 +15,17 @@
 #ifndef KVS_INCLUDE_KVS_SERVER_UTILS_HPP_
 #define KVS_INCLUDE_KVS_SERVER_UTILS_HPP_
 
-#include <fstream>
 #include <string>
 
-#include "base_kv_store.hpp"
 #include "common.hpp"
+#include "ebs_log.hpp"
+#include "flat_kv_store.hpp"
+#include "key_index.hpp"
 #include "kvs_common.hpp"
 #include "lattices/lww_pair_lattice.hpp"
+#include "merkle_tree.hpp"
+#include "replication_stream.hpp"
+#include "value_cache.hpp"
 #include "yaml-cpp/yaml.h"
 
 // Define the garbage collect threshold
@@ -33,12 +37,35 @@
 // Define the gossip period (frequency)
 #define PERIOD 10000000  // 10 seconds
 
-typedef KVStore<Key, LWWPairLattice<string>> MemoryLWWKVS;
-typedef KVStore<Key, SetLattice<string>> MemorySetKVS;
-typedef KVStore<Key, OrderedSetLattice<string>> MemoryOrderedSetKVS;
-typedef KVStore<Key, CausalPairLattice<SetLattice<string>>> MemoryCausalKVS;
-typedef KVStore<Key, CrossCausalLattice<SetLattice<string>>>
+// once the changes to a key since the last round of gossip add up to this many
+// bytes, its whole value is gossiped instead
+const unsigned kMaxGossipDeltaBytes = 64 * 1024;
+
+// changes to keys with more replicas than this are passed down a tree of the
+// replicas, each forwarding them to its children, instead of being sent to
+// every replica by the thread they were made on
+const unsigned kTreeGossipThreshold = 8;
+
+// the number of children of each replica in a gossip tree
+const unsigned kTreeGossipFanout = 4;
+
+// the period (in seconds) of the anti-entropy exchange, in which replicas
+// compare Merkle trees and repair the keys that gossip failed to bring in sync
+const unsigned kAntiEntropyPeriod = 60;
+
+// the most keys whose place in the Merkle trees is rechecked per iteration of
+// the event loop, after the membership of the cluster changes
+const unsigned kMerkleRelocationBatch = 1000;
+
+typedef FlatKVStore<LWWPairLattice<string>> MemoryLWWKVS;
+// both kinds of sets are stored sorted, which is all an ordered set requires
+typedef FlatKVStore<SortedSetLattice<string>> MemorySetKVS;
+typedef FlatKVStore<SortedSetLattice<string>> MemoryOrderedSetKVS;
+typedef FlatKVStore<CausalPairLattice<SetLattice<string>>> MemoryCausalKVS;
+typedef FlatKVStore<CrossCausalLattice<SetLattice<string>>>
     MemoryCrossCausalKVS;
+typedef FlatKVStore<GCounterLattice> MemoryGCounterKVS;
+typedef FlatKVStore<PNCounterLattice> MemoryPNCounterKVS;
 
 // a map that represents which keys should be sent to which IP-port combinations
 typedef map<Address, set<Key>> AddressKeysetMap;
@@ -46,663 +73,508 @@ typedef map<Address, set<Key>> AddressKeysetMap;
 class Serializer {
  public:
   virtual string get(const Key& key, unsigned& err_number) = 0;
+
+  // like get(), but for the server's own use of a value (e.g., to gossip it)
+  // rather than a request's, so that it does not affect what is cached
+  virtual string read(const Key& key, unsigned& err_number) {
+    return get(key, err_number);
+  }
+
   virtual unsigned put(const Key& key, const string& serialized) = 0;
   virtual void remove(const Key& key) = 0;
   virtual ~Serializer(){};
 };
 
-class MemoryLWWSerializer : public Serializer {
-  MemoryLWWKVS* kvs_;
-
- public:
-  MemoryLWWSerializer(MemoryLWWKVS* kvs) : kvs_(kvs) {}
-
-  string get(const Key& key, unsigned& err_number) {
-    auto val = kvs_->get(key, err_number);
-    if (val.reveal().value == "") {
-      err_number = 1;
-    }
-    return serialize(val);
-  }
+// whether a value stored in the memory tier holds nothing worth returning
+inline bool is_empty(const LWWPairLattice<string>& value) {
+  return value.reveal().value == "";
+}
 
-  unsigned put(const Key& key, const string& serialized) {
-    LWWPairLattice<string> val = deserialize_lww(serialized);
-    kvs_->put(key, val);
-    return kvs_->size(key);
-  }
+inline bool is_empty(const SortedSetLattice<string>& value) {
+  return value.size().reveal() == 0;
+}
 
-  void remove(const Key& key) { kvs_->remove(key); }
-};
+inline bool is_empty(const CausalPairLattice<SetLattice<string>>& value) {
+  return value.reveal().value.size().reveal() == 0;
+}
 
-class MemorySetSerializer : public Serializer {
-  MemorySetKVS* kvs_;
+inline bool is_empty(const CrossCausalLattice<SetLattice<string>>& value) {
+  return value.reveal().value.size().reveal() == 0;
+}
 
- public:
-  MemorySetSerializer(MemorySetKVS* kvs) : kvs_(kvs) {}
+inline bool is_empty(const GCounterLattice& value) {
+  return value.size().reveal() == 0;
+}
 
-  string get(const Key& key, unsigned& err_number) {
-    auto val = kvs_->get(key, err_number);
-    if (val.size().reveal() == 0) {
-      err_number = 1;
-    }
-    return serialize(val);
-  }
+inline bool is_empty(const PNCounterLattice& value) {
+  return value.size().reveal() == 0;
+}
 
-  unsigned put(const Key& key, const string& serialized) {
-    SetLattice<string> sl = deserialize_set(serialized);
-    kvs_->put(key, sl);
-    return kvs_->size(key);
-  }
-
-  void remove(const Key& key) { kvs_->remove(key); }
-};
-
-class MemoryOrderedSetSerializer : public Serializer {
-  MemoryOrderedSetKVS* kvs_;
+// MemorySerializer stores the values of one lattice type in a FlatKVStore.
+// It is final, so that its calls into the store are resolved at compile time
+// and the only indirect call per request is the one through Serializer.
+template <typename L>
+class MemorySerializer final : public Serializer {
+  FlatKVStore<L>* kvs_;
 
  public:
-  MemoryOrderedSetSerializer(MemoryOrderedSetKVS* kvs) : kvs_(kvs) {}
+  MemorySerializer(FlatKVStore<L>* kvs) : kvs_(kvs) {}
 
   string get(const Key& key, unsigned& err_number) {
-    auto val = kvs_->get(key, err_number);
-    if (val.size().reveal() == 0) {
+    const auto& entry = kvs_->borrow(key, err_number);
+    if (is_empty(entry.value())) {
       err_number = 1;
     }
-    return serialize(val);
+    return entry.serialized();
   }
 
   unsigned put(const Key& key, const string& serialized) {
-    OrderedSetLattice<string> sl = deserialize_ordered_set(serialized);
-    kvs_->put(key, sl);
-    return kvs_->size(key);
+    return kvs_->merge_serialized(key, serialized).size().reveal();
   }
 
   void remove(const Key& key) { kvs_->remove(key); }
 };
 
-class MemoryCausalSerializer : public Serializer {
-  MemoryCausalKVS* kvs_;
-
- public:
-  MemoryCausalSerializer(MemoryCausalKVS* kvs) : kvs_(kvs) {}
-
-  string get(const Key& key, unsigned& err_number) {
-    auto val = kvs_->get(key, err_number);
-    if (val.reveal().value.size().reveal() == 0) {
-      err_number = 1;
+typedef MemorySerializer<LWWPairLattice<string>> MemoryLWWSerializer;
+typedef MemorySerializer<SortedSetLattice<string>> MemorySetSerializer;
+typedef MemorySerializer<SortedSetLattice<string>> MemoryOrderedSetSerializer;
+typedef MemorySerializer<CausalPairLattice<SetLattice<string>>>
+    MemoryCausalSerializer;
+typedef MemorySerializer<CrossCausalLattice<SetLattice<string>>>
+    MemoryCrossCausalSerializer;
+typedef MemorySerializer<GCounterLattice> MemoryGCounterSerializer;
+typedef MemorySerializer<PNCounterLattice> MemoryPNCounterSerializer;
+
+// scans the wire format of a serialized message for a length-delimited field
+// without parsing the message; returns the length of the field's last
+// occurrence, or -1 if the field does not occur (or the message is malformed)
+inline long long find_field(const string& serialized, unsigned field) {
+  const unsigned char* data =
+      reinterpret_cast<const unsigned char*>(serialized.data());
+  size_t size = serialized.size();
+  size_t pos = 0;
+  long long found = -1;
+
+  auto read_varint = [&](unsigned long long& v) {
+    v = 0;
+    for (unsigned shift = 0; pos < size && shift < 64; shift += 7) {
+      unsigned char byte = data[pos++];
+      v |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
     }
-    return serialize(val);
-  }
+    return false;
+  };
 
-  unsigned put(const Key& key, const string& serialized) {
-    CausalValue causal_value = deserialize_causal(serialized);
-    VectorClockValuePair<SetLattice<string>> p =
-        to_vector_clock_value_pair(causal_value);
-    kvs_->put(key, CausalPairLattice<SetLattice<string>>(p));
-    return kvs_->size(key);
-  }
-
-  void remove(const Key& key) { kvs_->remove(key); }
-};
-
-class MemoryCrossCausalSerializer : public Serializer {
-  MemoryCrossCausalKVS* kvs_;
-
- public:
-  MemoryCrossCausalSerializer(MemoryCrossCausalKVS* kvs) : kvs_(kvs) {}
+  while (pos < size) {
+    unsigned long long tag, v;
+    if (!read_varint(tag)) {
+      return -1;
+    }
 
-  string get(const Key& key, unsigned& err_number) {
-    auto val = kvs_->get(key, err_number);
-    if (val.reveal().value.size().reveal() == 0) {
-      err_number = 1;
+    switch (tag & 0x7) {
+      case 0:  // varint
+        if (!read_varint(v)) {
+          return -1;
+        }
+        break;
+      case 1:  // 64-bit
+        pos += 8;
+        break;
+      case 2:  // length-delimited
+        if (!read_varint(v) || v > size - pos) {
+          return -1;
+        }
+        if ((tag >> 3) == field) {
+          found = v;
+        }
+        pos += v;
+        break;
+      case 5:  // 32-bit
+        pos += 4;
+        break;
+      default:
+        return -1;
     }
-    return serialize(val);
   }
 
-  unsigned put(const Key& key, const string& serialized) {
-    CrossCausalValue cross_causal_value = deserialize_cross_causal(serialized);
-    CrossCausalPayload<SetLattice<string>> p =
-        to_cross_causal_payload(cross_causal_value);
-    kvs_->put(key, CrossCausalLattice<SetLattice<string>>(p));
-    return kvs_->size(key);
+  return pos == size ? found : -1;
+}
+
+// EBS serializers store values in the thread's EBSLog: a PUT appends the
+// incoming payload, and the lattice merges are applied lazily when the chain
+// of records for a key is read or compacted. Values that are read repeatedly
+// are kept decoded in the thread's ValueCache, and PUTs are written through to
+// the cached values.
+template <typename L>
+class EBSSerializer : public Serializer {
+ protected:
+  EBSLog* log_;
+  ValueCache* cache_;
+  LatticeType type_;
+
+  virtual L decode(const string& serialized) = 0;
+
+  // whether a value holds nothing
+  virtual bool empty(const L& value) = 0;
+
+  // whether a serialized value holds nothing; this is checked on the wire
+  // format, so that a GET can return the stored bytes without parsing them
+  virtual bool empty(const string& serialized) = 0;
+
+  // folds a chain of serialized payloads (oldest first) into one value
+  L merge(const vector<string>& payloads) {
+    L merged = decode(payloads[0]);
+    for (unsigned i = 1; i < payloads.size(); i++) {
+      merged.merge(decode(payloads[i]));
+    }
+    return merged;
   }
 
-  void remove(const Key& key) { kvs_->remove(key); }
-};
-
-class EBSLWWSerializer : public Serializer {
-  unsigned tid_;
-  string ebs_root_;
-
  public:
-  EBSLWWSerializer(unsigned& tid) : tid_(tid) {
-    YAML::Node conf = YAML::LoadFile("conf/kvs-config.yml");
-
-    ebs_root_ = conf["ebs"].as<string>();
-
-    if (ebs_root_.back() != '/') {
-      ebs_root_ += "/";
-    }
+  EBSSerializer(EBSLog* log, ValueCache* cache, LatticeType type) :
+      log_(log),
+      cache_(cache),
+      type_(type) {
+    log_->register_merger(type_, [this](const vector<string>& payloads) {
+      return serialize(merge(payloads));
+    });
   }
 
   string get(const Key& key, unsigned& err_number) {
-    string res;
-    LWWValue value;
-
-    // open a new filestream for reading in a binary
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
-    std::fstream input(fname, std::ios::in | std::ios::binary);
-
-    if (!input) {
-      err_number = 1;
-    } else if (!value.ParseFromIstream(&input)) {
-      std::cerr << "Failed to parse payload." << std::endl;
-      err_number = 1;
-    } else {
-      if (value.value() == "") {
+    L* cached = cache_->template get<L>(key, type_);
+    if (cached != nullptr) {
+      if (empty(*cached)) {
         err_number = 1;
-      } else {
-        value.SerializeToString(&res);
+        return "";
       }
-    }
-    return res;
-  }
-
-  unsigned put(const Key& key, const string& serialized) {
-    LWWValue input_value;
-    input_value.ParseFromString(serialized);
 
-    LWWValue original_value;
-
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
-    std::fstream input(fname, std::ios::in | std::ios::binary);
+      return serialize(*cached);
+    }
 
-    if (!input) {  // in this case, this key has never been seen before, so we
-                   // attempt to create a new file for it
+    vector<string> payloads;
+    if (!log_->read(key, payloads) || payloads.size() == 0) {
+      err_number = 1;
+      return "";
+    }
 
-      // ios::trunc means that we overwrite the existing file
-      std::fstream output(fname,
-                          std::ios::out | std::ios::trunc | std::ios::binary);
-      if (!input_value.SerializeToOstream(&output)) {
-        std::cerr << "Failed to write payload." << std::endl;
-      }
-      return output.tellp();
-    } else if (!original_value.ParseFromIstream(
-                   &input)) {  // if we have seen the key before, attempt to
-                               // parse what was there before
-      std::cerr << "Failed to parse payload." << std::endl;
-      return 0;
-    } else {
-      std::fstream output(fname,
-                          std::ios::out | std::ios::trunc | std::ios::binary);
-      if (input_value.timestamp() >= original_value.timestamp()) {
-        if (!input_value.SerializeToOstream(&output)) {
-          std::cerr << "Failed to write payload" << std::endl;
-        }
+    if (payloads.size() == 1) {
+      string res = std::move(payloads[0]);
+      if (empty(res)) {
+        err_number = 1;
+        return "";
       }
-      return output.tellp();
-    }
-  }
 
-  void remove(const Key& key) {
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
+      if (cache_->admit(key)) {
+        cache_->insert(key, type_, decode(res), res.size());
+      }
 
-    if (std::remove(fname.c_str()) != 0) {
-      std::cerr << "Error deleting file" << std::endl;
+      return res;
     }
-  }
-};
 
-class EBSSetSerializer : public Serializer {
-  unsigned tid_;
-  string ebs_root_;
+    // replace the chain with its merged value so that subsequent reads of
+    // this key only need a single read
+    L value = merge(payloads);
+    string res = serialize(value);
+    log_->replace(key, type_, res);
 
- public:
-  EBSSetSerializer(unsigned& tid) : tid_(tid) {
-    YAML::Node conf = YAML::LoadFile("conf/kvs-config.yml");
-
-    ebs_root_ = conf["ebs"].as<string>();
+    if (empty(value)) {
+      err_number = 1;
+      return "";
+    }
 
-    if (ebs_root_.back() != '/') {
-      ebs_root_ += "/";
+    if (cache_->admit(key)) {
+      cache_->insert(key, type_, std::move(value), res.size());
     }
+
+    return res;
   }
 
-  string get(const Key& key, unsigned& err_number) {
-    string res;
-    SetValue value;
+  // served from the cache if the key happens to be cached, and from the log
+  // otherwise, without admitting the value into the cache
+  string read(const Key& key, unsigned& err_number) {
+    L* cached = cache_->template peek<L>(key, type_);
+    if (cached != nullptr) {
+      if (empty(*cached)) {
+        err_number = 1;
+        return "";
+      }
 
-    // open a new filestream for reading in a binary
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
-    std::fstream input(fname, std::ios::in | std::ios::binary);
+      return serialize(*cached);
+    }
 
-    if (!input) {
+    vector<string> payloads;
+    if (!log_->read(key, payloads) || payloads.size() == 0) {
       err_number = 1;
-    } else if (!value.ParseFromIstream(&input)) {
-      std::cerr << "Failed to parse payload." << std::endl;
+      return "";
+    }
+
+    string res = payloads.size() == 1 ? std::move(payloads[0])
+                                      : serialize(merge(payloads));
+    if (empty(res)) {
       err_number = 1;
-    } else {
-      if (value.values_size() == 0) {
-        err_number = 1;
-      } else {
-        value.SerializeToString(&res);
-      }
+      return "";
     }
+
     return res;
   }
 
   unsigned put(const Key& key, const string& serialized) {
-    SetValue input_value;
-    input_value.ParseFromString(serialized);
-
-    SetValue original_value;
+    log_->append(key, type_, serialized);
 
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
-    std::fstream input(fname, std::ios::in | std::ios::binary);
+    L* cached = cache_->template peek<L>(key, type_);
+    if (cached != nullptr) {
+      merge_serialized(*cached, serialized);
+      string merged = serialize(*cached);
 
-    if (!input) {  // in this case, this key has never been seen before, so we
-                   // attempt to create a new file for it
-      // ios::trunc means that we overwrite the existing file
-      std::fstream output(fname,
-                          std::ios::out | std::ios::trunc | std::ios::binary);
-      if (!input_value.SerializeToOstream(&output)) {
-        std::cerr << "Failed to write payload." << std::endl;
-      }
-      return output.tellp();
-    } else if (!original_value.ParseFromIstream(
-                   &input)) {  // if we have seen the key before, attempt to
-                               // parse what was there before
-      std::cerr << "Failed to parse payload." << std::endl;
-      return 0;
-    } else {
-      // get the existing value that we have and merge
-      set<string> set_union;
-      for (auto& val : original_value.values()) {
-        set_union.emplace(std::move(val));
-      }
-      for (auto& val : input_value.values()) {
-        set_union.emplace(std::move(val));
+      // cached keys are rarely read back from the log, so their chains are
+      // folded here instead
+      if (log_->chain_length(key) > kLogMaxChainLength) {
+        log_->replace(key, type_, merged);
       }
 
-      SetValue new_value;
-      for (auto& val : set_union) {
-        new_value.add_values(std::move(val));
-      }
-
-      // write out the new payload.
-      std::fstream output(fname,
-                          std::ios::out | std::ios::trunc | std::ios::binary);
-
-      if (!new_value.SerializeToOstream(&output)) {
-        std::cerr << "Failed to write payload" << std::endl;
-      }
-      return output.tellp();
+      cache_->resize(key, merged.size());
     }
+
+    return log_->size(key);
   }
 
   void remove(const Key& key) {
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
-
-    if (std::remove(fname.c_str()) != 0) {
-      std::cerr << "Error deleting file" << std::endl;
-    }
+    log_->remove(key);
+    cache_->erase(key);
   }
 };
 
-class EBSOrderedSetSerializer : public Serializer {
-  unsigned tid_;
-  string ebs_root_;
-
- public:
-  EBSOrderedSetSerializer(unsigned& tid) : tid_(tid) {
-    YAML::Node conf = YAML::LoadFile("conf/kvs-config.yml");
-
-    ebs_root_ = conf["ebs"].as<string>();
-
-    if (ebs_root_.back() != '/') {
-      ebs_root_ += "/";
-    }
+class EBSLWWSerializer : public EBSSerializer<LWWPairLattice<string>> {
+ protected:
+  LWWPairLattice<string> decode(const string& serialized) {
+    return deserialize_lww(serialized);
   }
 
-  string get(const Key& key, unsigned& err_number) {
-    string res;
-    SetValue value;
-
-    // open a new filestream for reading in a binary
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
-    std::fstream input(fname, std::ios::in | std::ios::binary);
-
-    if (!input) {
-      err_number = 1;
-    } else if (!value.ParseFromIstream(&input)) {
-      std::cerr << "Failed to parse payload." << std::endl;
-      err_number = 1;
-    } else {
-      if (value.values_size() == 0) {
-        err_number = 1;
-      } else {
-        value.SerializeToString(&res);
-      }
-    }
-    return res;
+  bool empty(const LWWPairLattice<string>& value) {
+    return value.reveal().value == "";
   }
 
-  unsigned put(const Key& key, const string& serialized) {
-    SetValue input_value;
-    input_value.ParseFromString(serialized);
+  bool empty(const string& serialized) {
+    return find_field(serialized, LWWValue::kValueFieldNumber) <= 0;
+  }
 
-    SetValue original_value;
+ public:
+  EBSLWWSerializer(EBSLog* log, ValueCache* cache) :
+      EBSSerializer(log, cache, LatticeType::LWW) {}
+};
 
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
-    std::fstream input(fname, std::ios::in | std::ios::binary);
+class EBSSetSerializer : public EBSSerializer<SetLattice<string>> {
+ protected:
+  SetLattice<string> decode(const string& serialized) {
+    return deserialize_set(serialized);
+  }
 
-    if (!input) {  // in this case, this key has never been seen before, so we
-                   // attempt to create a new file for it
-      // ios::trunc means that we overwrite the existing file
-      std::fstream output(fname,
-                          std::ios::out | std::ios::trunc | std::ios::binary);
-      if (!input_value.SerializeToOstream(&output)) {
-        std::cerr << "Failed to write payload." << std::endl;
-      }
-      return output.tellp();
-    } else if (!original_value.ParseFromIstream(
-                   &input)) {  // if we have seen the key before, attempt to
-                               // parse what was there before
-      std::cerr << "Failed to parse payload." << std::endl;
-      return 0;
-    } else {
-      // get the existing value that we have and merge
-      ordered_set<string> set_union;
-      for (auto& val : original_value.values()) {
-        set_union.emplace(std::move(val));
-      }
-      for (auto& val : input_value.values()) {
-        set_union.emplace(std::move(val));
-      }
+  bool empty(const SetLattice<string>& value) {
+    return value.size().reveal() == 0;
+  }
 
-      SetValue new_value;
-      for (auto& val : set_union) {
-        new_value.add_values(std::move(val));
-      }
+  bool empty(const string& serialized) {
+    return find_field(serialized, SetValue::kValuesFieldNumber) < 0;
+  }
 
-      // write out the new payload.
-      std::fstream output(fname,
-                          std::ios::out | std::ios::trunc | std::ios::binary);
+ public:
+  EBSSetSerializer(EBSLog* log, ValueCache* cache) :
+      EBSSerializer(log, cache, LatticeType::SET) {}
+};
 
-      if (!new_value.SerializeToOstream(&output)) {
-        std::cerr << "Failed to write payload" << std::endl;
-      }
-      return output.tellp();
-    }
+class EBSOrderedSetSerializer
+    : public EBSSerializer<OrderedSetLattice<string>> {
+ protected:
+  OrderedSetLattice<string> decode(const string& serialized) {
+    return deserialize_ordered_set(serialized);
   }
 
-  void remove(const Key& key) {
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
-
-    if (std::remove(fname.c_str()) != 0) {
-      std::cerr << "Error deleting file" << std::endl;
-    }
+  bool empty(const OrderedSetLattice<string>& value) {
+    return value.size().reveal() == 0;
   }
-};
 
-class EBSCausalSerializer : public Serializer {
-  unsigned tid_;
-  string ebs_root_;
+  bool empty(const string& serialized) {
+    return find_field(serialized, SetValue::kValuesFieldNumber) < 0;
+  }
 
  public:
-  EBSCausalSerializer(unsigned& tid) : tid_(tid) {
-    YAML::Node conf = YAML::LoadFile("conf/kvs-config.yml");
+  EBSOrderedSetSerializer(EBSLog* log, ValueCache* cache) :
+      EBSSerializer(log, cache, LatticeType::ORDERED_SET) {}
+};
 
-    ebs_root_ = conf["ebs"].as<string>();
+class EBSCausalSerializer
+    : public EBSSerializer<CausalPairLattice<SetLattice<string>>> {
+ protected:
+  CausalPairLattice<SetLattice<string>> decode(const string& serialized) {
+    return CausalPairLattice<SetLattice<string>>(
+        to_vector_clock_value_pair(deserialize_causal(serialized)));
+  }
 
-    if (ebs_root_.back() != '/') {
-      ebs_root_ += "/";
-    }
+  bool empty(const CausalPairLattice<SetLattice<string>>& value) {
+    return value.reveal().value.size().reveal() == 0;
   }
 
-  string get(const Key& key, unsigned& err_number) {
-    string res;
-    CausalValue value;
+  bool empty(const string& serialized) {
+    return find_field(serialized, CausalValue::kValuesFieldNumber) < 0;
+  }
 
-    // open a new filestream for reading in a binary
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
-    std::fstream input(fname, std::ios::in | std::ios::binary);
+ public:
+  EBSCausalSerializer(EBSLog* log, ValueCache* cache) :
+      EBSSerializer(log, cache, LatticeType::CAUSAL) {}
+};
 
-    if (!input) {
-      err_number = 1;
-    } else if (!value.ParseFromIstream(&input)) {
-      std::cerr << "Failed to parse payload." << std::endl;
-      err_number = 1;
-    } else {
-      if (value.values_size() == 0) {
-        err_number = 1;
-      } else {
-        value.SerializeToString(&res);
-      }
-    }
-    return res;
+class EBSCrossCausalSerializer
+    : public EBSSerializer<CrossCausalLattice<SetLattice<string>>> {
+ protected:
+  CrossCausalLattice<SetLattice<string>> decode(const string& serialized) {
+    return CrossCausalLattice<SetLattice<string>>(
+        to_cross_causal_payload(deserialize_cross_causal(serialized)));
   }
 
-  unsigned put(const Key& key, const string& serialized) {
-    CausalValue input_value;
-    input_value.ParseFromString(serialized);
-
-    CausalValue original_value;
+  bool empty(const CrossCausalLattice<SetLattice<string>>& value) {
+    return value.reveal().value.size().reveal() == 0;
+  }
 
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
-    std::fstream input(fname, std::ios::in | std::ios::binary);
+  bool empty(const string& serialized) {
+    return find_field(serialized, CrossCausalValue::kValuesFieldNumber) < 0;
+  }
 
-    if (!input) {  // in this case, this key has never been seen before, so we
-                   // attempt to create a new file for it
-      // ios::trunc means that we overwrite the existing file
-      std::fstream output(fname,
-                          std::ios::out | std::ios::trunc | std::ios::binary);
-      if (!input_value.SerializeToOstream(&output)) {
-        std::cerr << "Failed to write payload." << std::endl;
-      }
-      return output.tellp();
-    } else if (!original_value.ParseFromIstream(
-                   &input)) {  // if we have seen the key before, attempt to
-                               // parse what was there before
-      std::cerr << "Failed to parse payload." << std::endl;
-      return 0;
-    } else {
-      // get the existing value that we have and merge
-      VectorClockValuePair<SetLattice<string>> orig_pair;
-      for (const auto& pair : original_value.vector_clock()) {
-        orig_pair.vector_clock.insert(pair.first, pair.second);
-      }
-      for (auto& val : original_value.values()) {
-        orig_pair.value.insert(std::move(val));
-      }
-      CausalPairLattice<SetLattice<string>> orig(orig_pair);
+ public:
+  EBSCrossCausalSerializer(EBSLog* log, ValueCache* cache) :
+      EBSSerializer(log, cache, LatticeType::CROSSCAUSAL) {}
+};
 
-      VectorClockValuePair<SetLattice<string>> input_pair;
-      for (const auto& pair : input_value.vector_clock()) {
-        input_pair.vector_clock.insert(pair.first, pair.second);
-      }
-      for (auto& val : input_value.values()) {
-        input_pair.value.insert(std::move(val));
-      }
-      CausalPairLattice<SetLattice<string>> input(input_pair);
+class EBSGCounterSerializer : public EBSSerializer<GCounterLattice> {
+ protected:
+  GCounterLattice decode(const string& serialized) {
+    return deserialize_gcounter(serialized);
+  }
 
-      orig.merge(input);
+  bool empty(const GCounterLattice& value) { return is_empty(value); }
 
-      CausalValue new_value;
-      auto ptr = new_value.mutable_vector_clock();
-      // serialize vector clock
-      for (const auto& pair : orig.reveal().vector_clock.reveal()) {
-        (*ptr)[pair.first] = pair.second.reveal();
-      }
-      // serialize values
-      // note that this creates unnecessary copy of val, but
-      // we have to since the reveal() method is marked as "const"
-      for (const string& val : orig.reveal().value.reveal()) {
-        new_value.add_values(val);
-      }
+  bool empty(const string& serialized) {
+    return find_field(serialized, CounterValue::kIncrementsFieldNumber) < 0;
+  }
 
-      // write out the new payload.
-      std::fstream output(fname,
-                          std::ios::out | std::ios::trunc | std::ios::binary);
+ public:
+  EBSGCounterSerializer(EBSLog* log, ValueCache* cache) :
+      EBSSerializer(log, cache, LatticeType::GCOUNTER) {}
+};
 
-      if (!new_value.SerializeToOstream(&output)) {
-        std::cerr << "Failed to write payload" << std::endl;
-      }
-      return output.tellp();
-    }
+class EBSPNCounterSerializer : public EBSSerializer<PNCounterLattice> {
+ protected:
+  PNCounterLattice decode(const string& serialized) {
+    return deserialize_pncounter(serialized);
   }
 
-  void remove(const Key& key) {
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
+  bool empty(const PNCounterLattice& value) { return is_empty(value); }
 
-    if (std::remove(fname.c_str()) != 0) {
-      std::cerr << "Error deleting file" << std::endl;
-    }
+  bool empty(const string& serialized) {
+    return find_field(serialized, CounterValue::kIncrementsFieldNumber) < 0 &&
+           find_field(serialized, CounterValue::kDecrementsFieldNumber) < 0;
   }
-};
-
-class EBSCrossCausalSerializer : public Serializer {
-  unsigned tid_;
-  string ebs_root_;
 
  public:
-  EBSCrossCausalSerializer(unsigned& tid) : tid_(tid) {
-    YAML::Node conf = YAML::LoadFile("conf/kvs-config.yml");
+  EBSPNCounterSerializer(EBSLog* log, ValueCache* cache) :
+      EBSSerializer(log, cache, LatticeType::PNCOUNTER) {}
+};
 
-    ebs_root_ = conf["ebs"].as<string>();
+// IndexedSerializer keeps the ordered index of a thread's keys up to date as
+// they are stored in and removed from the serializer it wraps
+class IndexedSerializer : public Serializer {
+  Serializer* serializer_;
+  KeyIndex* index_;
 
-    if (ebs_root_.back() != '/') {
-      ebs_root_ += "/";
-    }
-  }
+ public:
+  IndexedSerializer(Serializer* serializer, KeyIndex* index) :
+      serializer_(serializer),
+      index_(index) {}
 
   string get(const Key& key, unsigned& err_number) {
-    string res;
-    CrossCausalValue value;
-
-    // open a new filestream for reading in a binary
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
-    std::fstream input(fname, std::ios::in | std::ios::binary);
+    return serializer_->get(key, err_number);
+  }
 
-    if (!input) {
-      err_number = 1;
-    } else if (!value.ParseFromIstream(&input)) {
-      std::cerr << "Failed to parse payload." << std::endl;
-      err_number = 1;
-    } else {
-      if (value.values_size() == 0) {
-        err_number = 1;
-      } else {
-        value.SerializeToString(&res);
-      }
-    }
-    return res;
+  string read(const Key& key, unsigned& err_number) {
+    return serializer_->read(key, err_number);
   }
 
   unsigned put(const Key& key, const string& serialized) {
-    CrossCausalValue input_value;
-    input_value.ParseFromString(serialized);
-
-    CrossCausalValue original_value;
-
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
-    std::fstream input(fname, std::ios::in | std::ios::binary);
-
-    if (!input) {  // in this case, this key has never been seen before, so we
-                   // attempt to create a new file for it
-      // ios::trunc means that we overwrite the existing file
-      std::fstream output(fname,
-                          std::ios::out | std::ios::trunc | std::ios::binary);
-      if (!input_value.SerializeToOstream(&output)) {
-        std::cerr << "Failed to write payload." << std::endl;
-      }
-      return output.tellp();
-    } else if (!original_value.ParseFromIstream(
-                   &input)) {  // if we have seen the key before, attempt to
-                               // parse what was there before
-      std::cerr << "Failed to parse payload." << std::endl;
-      return 0;
-    } else {
-      // get the existing value that we have and merge
-      CrossCausalPayload<SetLattice<string>> orig_payload;
-      for (const auto& pair : original_value.vector_clock()) {
-        orig_payload.vector_clock.insert(pair.first, pair.second);
-      }
-      for (const auto& dep : original_value.deps()) {
-        VectorClock vc;
-        for (const auto& pair : dep.vector_clock()) {
-          vc.insert(pair.first, pair.second);
-        }
-        orig_payload.dependency.insert(dep.key(), vc);
-      }
-      for (auto& val : original_value.values()) {
-        orig_payload.value.insert(std::move(val));
-      }
-      CrossCausalLattice<SetLattice<string>> orig(orig_payload);
-
-      CrossCausalPayload<SetLattice<string>> input_payload;
-      for (const auto& pair : input_value.vector_clock()) {
-        input_payload.vector_clock.insert(pair.first, pair.second);
-      }
-      for (const auto& dep : input_value.deps()) {
-        VectorClock vc;
-        for (const auto& pair : dep.vector_clock()) {
-          vc.insert(pair.first, pair.second);
-        }
-        input_payload.dependency.insert(dep.key(), vc);
-      }
-      for (auto& val : input_value.values()) {
-        input_payload.value.insert(std::move(val));
-      }
-      CrossCausalLattice<SetLattice<string>> input(input_payload);
+    index_->insert(key);
+    return serializer_->put(key, serialized);
+  }
 
-      orig.merge(input);
+  void remove(const Key& key) {
+    index_->remove(key);
+    serializer_->remove(key);
+  }
+};
 
-      CrossCausalValue new_value;
-      auto ptr = new_value.mutable_vector_clock();
-      // serialize vector clock
-      for (const auto& pair : orig.reveal().vector_clock.reveal()) {
-        (*ptr)[pair.first] = pair.second.reveal();
-      }
-      // serialize dependency
-      for (const auto& pair : orig.reveal().dependency.reveal()) {
-        auto dep = new_value.add_deps();
-        dep->set_key(pair.first);
-        auto vc_ptr = dep->mutable_vector_clock();
-        for (const auto& vc_pair : pair.second.reveal()) {
-          (*vc_ptr)[vc_pair.first] = vc_pair.second.reveal();
-        }
-      }
-      // serialize values
-      // note that this creates unnecessary copy of val, but
-      // we have to since the reveal() method is marked as "const"
-      for (const string& val : orig.reveal().value.reveal()) {
-        new_value.add_values(val);
-      }
+using SerializerMap = LatticeTypeMap<Serializer*>;
+
+// Calls registrar.add<L, S>(type) for every lattice type a server stores,
+// where L is the lattice the memory tier keeps its values in and S is the
+// serializer the EBS tier uses for it. This is the only place that needs to
+// change when a lattice type is added.
+template <typename Registrar>
+void register_lattice_types(Registrar& registrar) {
+  registrar.template add<LWWPairLattice<string>, EBSLWWSerializer>(
+      LatticeType::LWW);
+  registrar.template add<SortedSetLattice<string>, EBSSetSerializer>(
+      LatticeType::SET);
+  registrar.template add<SortedSetLattice<string>, EBSOrderedSetSerializer>(
+      LatticeType::ORDERED_SET);
+  registrar.template add<CausalPairLattice<SetLattice<string>>,
+                         EBSCausalSerializer>(LatticeType::CAUSAL);
+  registrar.template add<CrossCausalLattice<SetLattice<string>>,
+                         EBSCrossCausalSerializer>(LatticeType::CROSSCAUSAL);
+  registrar.template add<GCounterLattice, EBSGCounterSerializer>(
+      LatticeType::GCOUNTER);
+  registrar.template add<PNCounterLattice, EBSPNCounterSerializer>(
+      LatticeType::PNCOUNTER);
+}
+
+// creates functions that merge serialized payloads of each lattice type into
+// a single payload, without storing them
+struct PayloadMergerRegistrar {
+  LatticeTypeMap<PayloadMerger>& mergers_;
+
+  template <typename L, typename S>
+  void add(LatticeType type) {
+    mergers_.set(type, [](const vector<string>& payloads) {
+      L merged;
+      for (const string& payload : payloads) {
+        merge_serialized(merged, payload);
+      }
+      return serialize(merged);
+    });
+  }
+};
 
-      // write out the new payload.
-      std::fstream output(fname,
-                          std::ios::out | std::ios::trunc | std::ios::binary);
+// creates the serializers of a memory-tier thread, each with its own store
+struct MemorySerializerRegistrar {
+  SerializerMap& serializers_;
 
-      if (!new_value.SerializeToOstream(&output)) {
-        std::cerr << "Failed to write payload" << std::endl;
-      }
-      return output.tellp();
-    }
+  template <typename L, typename S>
+  void add(LatticeType type) {
+    serializers_.set(type, new MemorySerializer<L>(new FlatKVStore<L>()));
   }
+};
 
-  void remove(const Key& key) {
-    string fname = ebs_root_ + "ebs_" + std::to_string(tid_) + "/" + key;
+// creates the serializers of an EBS-tier thread, which share one log and one
+// value cache
+struct EBSSerializerRegistrar {
+  SerializerMap& serializers_;
+  EBSLog* log_;
+  ValueCache* cache_;
 
-    if (std::remove(fname.c_str()) != 0) {
-      std::cerr << "Error deleting file" << std::endl;
-    }
+  template <typename L, typename S>
+  void add(LatticeType type) {
+    serializers_.set(type, new S(log_, cache_));
   }
 };
 
-using SerializerMap =
-    std::unordered_map<LatticeType, Serializer*, lattice_type_hash>;
-
 struct PendingRequest {
   PendingRequest() {}
   PendingRequest(RequestType type, LatticeType lattice_type, string payload,
@@ -0,0 +1,440 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef KVS_INCLUDE_KVS_SNAPSHOT_HPP_
+#define KVS_INCLUDE_KVS_SNAPSHOT_HPP_
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include "io_queue.hpp"
+#include "metadata.hpp"
+#include "server_utils.hpp"
+
+// the number of keys serialized per call to Snapshotter::advance
+const unsigned kSnapshotBudget = 1000;
+
+// the most chunks of a snapshot that can be waiting to be written out; keys
+// are not serialized while the snapshot thread is this far behind
+const unsigned kSnapshotMaxPendingChunks = 4;
+
+// how far apart (in milliseconds) the clocks of two servers are assumed to
+// drift; peers resend keys updated up to this long before a snapshot began
+const unsigned long long kSnapshotClockSkew = 10 * 1000;
+
+// the file a snapshot is being written to, which is only used by the snapshot
+// thread
+struct SnapshotFile {
+  string path_;
+  int fd_;
+  bool failed_;
+
+  SnapshotFile(string path) : path_(std::move(path)), fd_(-1), failed_(false) {}
+};
+
+// Snapshotter periodically writes the keys a memory thread stores, along with
+// their replication factors, to a file on local disk, so that a restarted
+// thread can serve its keys right away and only has to be sent the ones that
+// changed since. Snapshots are fuzzy: keys are serialized a few at a time
+// between requests, and each key is captured as of the moment it was reached.
+// Since every value is a lattice, any key that changes after the snapshot
+// began is simply resent by its other replicas when the thread rejoins, as
+// are all keys whose replicas may have changed since. Each
+// batch of keys is handed to the snapshot thread and appended to the file as
+// soon as it is serialized, so only a few batches are ever held in memory.
+//
+// A snapshot file holds the time the snapshot began (8 bytes), then one record
+// per key: lattice type (1 byte), key length (4 bytes), value length (4
+// bytes), the key, the value, and the global and local replication factors of
+// the key (each a 4-byte count followed by 4-byte tier id and factor pairs).
+// It ends with a checksum (4 bytes) of everything before it.
+class Snapshotter {
+  string path_;
+
+  // how often a snapshot is taken (in milliseconds)
+  unsigned long long period_;
+
+  // when the last completed snapshot began
+  unsigned long long last_snapshot_;
+
+  // the snapshot being serialized: when it began, the keys it covers, how far
+  // we have gotten through them, and the checksum of what has been serialized
+  bool snapshotting_;
+  unsigned long long started_;
+  vector<Key> keys_;
+  unsigned cursor_;
+  unsigned checksum_;
+  std::shared_ptr<SnapshotFile> file_;
+
+  IOQueue io_;
+  bool writing_;
+
+  static unsigned checksum(const char* data, size_t length,
+                           unsigned hash = 2166136261u) {
+    // 32-bit FNV-1a
+    for (size_t i = 0; i < length; i++) {
+      hash ^= static_cast<unsigned char>(data[i]);
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+  static void encode_u32(string& buf, unsigned v) {
+    for (unsigned i = 0; i < 4; i++) {
+      buf.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+    }
+  }
+
+  static void encode_u64(string& buf, unsigned long long v) {
+    encode_u32(buf, static_cast<unsigned>(v & 0xffffffff));
+    encode_u32(buf, static_cast<unsigned>(v >> 32));
+  }
+
+  static bool decode_u32(const string& buf, size_t& offset, unsigned& v) {
+    if (offset + 4 > buf.size()) {
+      return false;
+    }
+
+    v = 0;
+    for (unsigned i = 0; i < 4; i++) {
+      v |= static_cast<unsigned>(static_cast<unsigned char>(buf[offset + i]))
+           << (8 * i);
+    }
+    offset += 4;
+    return true;
+  }
+
+  static unsigned long long decode_u64(const string& buf, size_t& offset) {
+    unsigned low = 0;
+    unsigned high = 0;
+    decode_u32(buf, offset, low);
+    decode_u32(buf, offset, high);
+    return (static_cast<unsigned long long>(high) << 32) | low;
+  }
+
+  static void encode_factors(string& buf,
+                             const map<TierId, unsigned>& factors) {
+    encode_u32(buf, factors.size());
+    for (const auto& pair : factors) {
+      encode_u32(buf, pair.first);
+      encode_u32(buf, pair.second);
+    }
+  }
+
+  static bool decode_factors(const string& buf, size_t& offset,
+                             map<TierId, unsigned>& factors) {
+    unsigned count;
+    if (!decode_u32(buf, offset, count)) {
+      return false;
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+      unsigned tier;
+      unsigned factor;
+      if (!decode_u32(buf, offset, tier) || !decode_u32(buf, offset, factor)) {
+        return false;
+      }
+      factors[tier] = factor;
+    }
+
+    return true;
+  }
+
+  // reads the snapshot at the given path into buf, dropping the checksum;
+  // returns false if there is no snapshot or it is corrupt
+  static bool read_file(const string& path, string& buf) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+      return false;
+    }
+
+    std::stringstream contents;
+    contents << input.rdbuf();
+    buf = contents.str();
+
+    if (buf.size() < 12) {
+      std::cerr << "Ignoring truncated snapshot " << path << std::endl;
+      return false;
+    }
+
+    size_t offset = buf.size() - 4;
+    unsigned stored;
+    decode_u32(buf, offset, stored);
+    if (stored != checksum(buf.data(), buf.size() - 4)) {
+      std::cerr << "Ignoring corrupt snapshot " << path << std::endl;
+      return false;
+    }
+
+    buf.resize(buf.size() - 4);
+    return true;
+  }
+
+  // the snapshot is written next to its final location and moved into place
+  // once it is complete, so that a crash never leaves a partial snapshot
+  // behind
+  static string temp_path(const string& path) { return path + ".tmp"; }
+
+  static void open_file(SnapshotFile& file) {
+    string temp = temp_path(file.path_);
+    file.fd_ = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file.fd_ < 0) {
+      std::cerr << "Failed to open snapshot " << temp << std::endl;
+      file.failed_ = true;
+    }
+  }
+
+  static void append_file(SnapshotFile& file, const string& chunk) {
+    size_t done = 0;
+    while (!file.failed_ && done < chunk.size()) {
+      ssize_t n = write(file.fd_, chunk.data() + done, chunk.size() - done);
+      if (n <= 0) {
+        file.failed_ = true;
+      } else {
+        done += n;
+      }
+    }
+  }
+
+  // moves a complete snapshot into place, or discards an incomplete one
+  static void close_file(SnapshotFile& file, bool complete) {
+    bool succeeded = complete && !file.failed_ && fdatasync(file.fd_) == 0;
+    if (file.fd_ >= 0) {
+      close(file.fd_);
+    }
+
+    string temp = temp_path(file.path_);
+    if (!succeeded || std::rename(temp.c_str(), file.path_.c_str()) != 0) {
+      if (complete) {
+        std::cerr << "Failed to write snapshot " << file.path_ << std::endl;
+      }
+      std::remove(temp.c_str());
+    }
+  }
+
+  void begin(const map<Key, KeyProperty>& stored_key_map) {
+    snapshotting_ = true;
+    started_ = get_time();
+    cursor_ = 0;
+
+    keys_.clear();
+    keys_.reserve(stored_key_map.size());
+    for (const auto& pair : stored_key_map) {
+      keys_.push_back(pair.first);
+    }
+
+    string header;
+    encode_u64(header, started_);
+    checksum_ = checksum(header.data(), header.size());
+
+    auto file = std::make_shared<SnapshotFile>(path_);
+    file_ = file;
+    io_.submit([file, header] {
+      open_file(*file);
+      append_file(*file, header);
+    });
+  }
+
+ public:
+  // a period of 0 takes snapshots back to back; the snapshot thread is only
+  // used to write snapshots out
+  Snapshotter(string path, unsigned long long period) :
+      path_(std::move(path)),
+      period_(period),
+      last_snapshot_(get_time()),
+      snapshotting_(false),
+      started_(0),
+      cursor_(0),
+      checksum_(0),
+      io_(1),
+      writing_(false) {
+    size_t slash = path_.rfind('/');
+    if (slash != string::npos && slash > 0) {
+      mkdir(path_.substr(0, slash).c_str(), 0755);
+    }
+  }
+
+  // a snapshot that is still being serialized is discarded
+  ~Snapshotter() {
+    if (snapshotting_) {
+      std::shared_ptr<SnapshotFile> file = file_;
+      io_.submit([file] { close_file(*file, false); });
+    }
+  }
+
+  // makes incremental progress on the current snapshot, or starts a new one
+  // once the period has elapsed since the last one began
+  void advance(SerializerMap& serializers,
+               const map<Key, KeyProperty>& stored_key_map,
+               const map<Key, KeyReplication>& key_replication_map) {
+    vector<unsigned> completed;
+    io_.poll(completed);
+
+    if (writing_) {
+      if (io_.outstanding() > 0) {
+        return;
+      }
+
+      writing_ = false;
+      last_snapshot_ = started_;
+    }
+
+    if (!snapshotting_) {
+      if (get_time() - last_snapshot_ < period_) {
+        return;
+      }
+
+      begin(stored_key_map);
+    }
+
+    if (io_.outstanding() >= kSnapshotMaxPendingChunks) {
+      return;
+    }
+
+    auto chunk = std::make_shared<string>();
+    string& buf = *chunk;
+    for (unsigned i = 0; i < kSnapshotBudget && cursor_ < keys_.size();
+         i++, cursor_++) {
+      const Key& key = keys_[cursor_];
+
+      // skip keys that have been removed since the snapshot began
+      auto it = stored_key_map.find(key);
+      if (it == stored_key_map.end()) {
+        continue;
+      }
+
+      unsigned error = 0;
+      string value = serializers.at(it->second.type_)->read(key, error);
+      if (error != 0) {
+        continue;
+      }
+
+      buf.push_back(static_cast<char>(it->second.type_));
+      encode_u32(buf, key.size());
+      encode_u32(buf, value.size());
+      buf += key;
+      buf += value;
+
+      auto rep_it = key_replication_map.find(key);
+      if (rep_it != key_replication_map.end()) {
+        encode_factors(buf, rep_it->second.global_replication_);
+        encode_factors(buf, rep_it->second.local_replication_);
+      } else {
+        encode_u32(buf, 0);
+        encode_u32(buf, 0);
+      }
+    }
+
+    checksum_ = checksum(buf.data(), buf.size(), checksum_);
+
+    bool complete = cursor_ == keys_.size();
+    if (complete) {
+      encode_u32(buf, checksum_);
+    }
+
+    std::shared_ptr<SnapshotFile> file = file_;
+    io_.submit([file, chunk, complete] {
+      append_file(*file, *chunk);
+      if (complete) {
+        close_file(*file, true);
+      }
+    });
+
+    if (complete) {
+      snapshotting_ = false;
+      writing_ = true;
+      keys_.clear();
+      file_.reset();
+    }
+  }
+
+  // when the last snapshot written by this Snapshotter began, or when it was
+  // created if it has not written one yet
+  unsigned long long last_snapshot() const { return last_snapshot_; }
+
+  // returns when the snapshot at the given path began, or 0 if there is no
+  // usable snapshot there
+  static unsigned long long timestamp(const string& path) {
+    string buf;
+    if (!read_file(path, buf)) {
+      return 0;
+    }
+
+    size_t offset = 0;
+    return decode_u64(buf, offset);
+  }
+
+  // merges the keys in the snapshot at the given path into the serializers;
+  // returns when the snapshot began, or 0 if there is no usable snapshot
+  static unsigned long long load(
+      const string& path, SerializerMap& serializers,
+      map<Key, KeyProperty>& stored_key_map,
+      map<Key, KeyReplication>& key_replication_map) {
+    string buf;
+    if (!read_file(path, buf)) {
+      return 0;
+    }
+
+    size_t offset = 0;
+    unsigned long long time = decode_u64(buf, offset);
+
+    while (offset < buf.size()) {
+      LatticeType type =
+          static_cast<LatticeType>(static_cast<unsigned char>(buf[offset]));
+      offset += 1;
+
+      unsigned key_length;
+      unsigned value_length;
+      if (!decode_u32(buf, offset, key_length) ||
+          !decode_u32(buf, offset, value_length) ||
+          offset + key_length + value_length > buf.size()) {
+        break;
+      }
+
+      Key key = buf.substr(offset, key_length);
+      offset += key_length;
+      string value = buf.substr(offset, value_length);
+      offset += value_length;
+
+      KeyReplication replication;
+      if (!decode_factors(buf, offset, replication.global_replication_) ||
+          !decode_factors(buf, offset, replication.local_replication_)) {
+        break;
+      }
+
+      if (!serializers.contains(type)) {
+        continue;
+      }
+
+      KeyProperty& property = stored_key_map[key];
+      property.size_ = serializers.at(type)->put(key, value);
+      property.type_ = type;
+      property.modified_ = time;
+
+      if (replication.global_replication_.size() > 0) {
+        key_replication_map[key] = std::move(replication);
+      }
+    }
+
+    return time;
+  }
+};
+
+#endif  // KVS_INCLUDE_KVS_SNAPSHOT_HPP_
@@ -0,0 +1,166 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef KVS_INCLUDE_KVS_VALUE_CACHE_HPP_
+#define KVS_INCLUDE_KVS_VALUE_CACHE_HPP_
+
+#include <list>
+#include <memory>
+
+#include "common.hpp"
+
+// the number of bytes of decoded values each EBS thread keeps cached
+const unsigned long long kValueCacheCapacity = 64 * 1000 * 1000;
+
+// the number of recently missed keys that are remembered for admission
+const unsigned kValueCacheHistorySize = 10000;
+
+struct ValueCacheEntry {
+  LatticeType type_;
+  std::shared_ptr<void> value_;
+  unsigned long long size_;
+  std::list<Key>::iterator position_;
+};
+
+// ValueCache is a per-thread LRU cache of decoded lattice values that sits in
+// front of the EBS serializers, so that reads of hot keys neither go to disk
+// nor re-parse the stored payloads. To keep a one-off scan over cold keys from
+// flushing the hot ones, a key is only admitted when it misses while it is
+// still in the history of recently missed keys.
+class ValueCache {
+  unsigned long long capacity_;
+  unsigned long long size_;
+
+  // cached keys, most recently used first
+  std::list<Key> recency_;
+  map<Key, ValueCacheEntry> entries_;
+
+  // keys that recently missed, most recent first
+  std::list<Key> history_;
+  map<Key, std::list<Key>::iterator> history_index_;
+
+  unsigned hit_count_;
+  unsigned miss_count_;
+
+  void evict() {
+    while (size_ > capacity_ && !recency_.empty()) {
+      Key key = recency_.back();
+      erase(key);
+    }
+  }
+
+ public:
+  ValueCache(unsigned long long capacity = kValueCacheCapacity) :
+      capacity_(capacity),
+      size_(0),
+      hit_count_(0),
+      miss_count_(0) {}
+
+  // returns the cached value of the key, or nullptr if it is not cached; the
+  // lookup is counted as a hit or a miss
+  template <typename L>
+  L* get(const Key& key, LatticeType type) {
+    auto it = entries_.find(key);
+    if (it == entries_.end() || it->second.type_ != type) {
+      miss_count_ += 1;
+      return nullptr;
+    }
+
+    hit_count_ += 1;
+    recency_.splice(recency_.begin(), recency_, it->second.position_);
+    return static_cast<L*>(it->second.value_.get());
+  }
+
+  // like get(), but neither counted nor treated as a use of the key
+  template <typename L>
+  L* peek(const Key& key, LatticeType type) {
+    auto it = entries_.find(key);
+    if (it == entries_.end() || it->second.type_ != type) {
+      return nullptr;
+    }
+
+    return static_cast<L*>(it->second.value_.get());
+  }
+
+  // decides whether a key that just missed should be cached: it is admitted
+  // if it already missed recently, and remembered otherwise
+  bool admit(const Key& key) {
+    auto it = history_index_.find(key);
+    if (it != history_index_.end()) {
+      history_.erase(it->second);
+      history_index_.erase(it);
+      return true;
+    }
+
+    history_.push_front(key);
+    history_index_[key] = history_.begin();
+
+    if (history_.size() > kValueCacheHistorySize) {
+      history_index_.erase(history_.back());
+      history_.pop_back();
+    }
+
+    return false;
+  }
+
+  template <typename L>
+  void insert(const Key& key, LatticeType type, L value,
+              unsigned long long size) {
+    erase(key);
+
+    recency_.push_front(key);
+    entries_[key] = {type, std::make_shared<L>(std::move(value)), size,
+                     recency_.begin()};
+    size_ += size;
+
+    evict();
+  }
+
+  // accounts for a cached value having changed size, e.g., because a PUT was
+  // merged into it
+  void resize(const Key& key, unsigned long long size) {
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      size_ = size_ - it->second.size_ + size;
+      it->second.size_ = size;
+      evict();
+    }
+  }
+
+  void erase(const Key& key) {
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      size_ -= it->second.size_;
+      recency_.erase(it->second.position_);
+      entries_.erase(it);
+    }
+  }
+
+  bool contains(const Key& key) const {
+    return entries_.find(key) != entries_.end();
+  }
+
+  unsigned long long size() const { return size_; }
+
+  unsigned hit_count() const { return hit_count_; }
+
+  unsigned miss_count() const { return miss_count_; }
+
+  void reset_counts() {
+    hit_count_ = 0;
+    miss_count_ = 0;
+  }
+};
+
+#endif  // KVS_INCLUDE_KVS_VALUE_CACHE_HPP_
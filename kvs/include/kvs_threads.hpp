@@ -27,6 +27,8 @@ const unsigned kServerReplicationResponsePort = 6150;
 const unsigned kKeyRequestPort = 6200;
 const unsigned kGossipPort = 6250;
 const unsigned kServerReplicationChangePort = 6300;
+const unsigned kAntiEntropyPort = 6950;
+const unsigned kReplicationAckPort = 7100;
 const unsigned kCacheIpResponsePort = 7050;
 
 // define routing base ports
@@ -151,6 +153,22 @@ class ServerThread {
   Address replication_change_bind_address() const {
     return kBindBase + std::to_string(tid_ + kServerReplicationChangePort);
   }
+
+  Address anti_entropy_connect_address() const {
+    return private_base_ + std::to_string(tid_ + kAntiEntropyPort);
+  }
+
+  Address anti_entropy_bind_address() const {
+    return kBindBase + std::to_string(tid_ + kAntiEntropyPort);
+  }
+
+  Address replication_ack_connect_address() const {
+    return private_base_ + std::to_string(tid_ + kReplicationAckPort);
+  }
+
+  Address replication_ack_bind_address() const {
+    return kBindBase + std::to_string(tid_ + kReplicationAckPort);
+  }
 };
 
 inline bool operator==(const ServerThread& l, const ServerThread& r) {
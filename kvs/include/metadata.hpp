@@ -19,16 +19,33 @@
 
 const string kMetadataTypeReplication = "replication";
 
-// represents the replication state for each key
+// represents the replication state for each key, and when (in milliseconds
+// since the epoch) this thread last received a change to it
 struct KeyReplication {
   map<TierId, unsigned> global_replication_;
   map<TierId, unsigned> local_replication_;
+  unsigned long long changed_;
+
+  KeyReplication() : changed_(0) {}
 };
 
-// keep track of the size and lattice type of the key
+// keep track of the size and lattice type of the key, and of when (in
+// milliseconds since the epoch) this thread last updated it
 struct KeyProperty {
   unsigned size_;
   LatticeType type_;
+  unsigned long long modified_;
+};
+
+// the payloads that requests to this thread have merged into a key since its
+// last round of gossip; their join is gossiped instead of the whole value,
+// unless full_ is set because they were not all kept
+struct KeyDelta {
+  vector<string> payloads_;
+  unsigned bytes_;
+  bool full_;
+
+  KeyDelta() : bytes_(0), full_(false) {}
 };
 
 inline bool operator==(const KeyReplication& lhs, const KeyReplication& rhs) {
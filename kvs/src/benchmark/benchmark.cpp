@@ -22,6 +22,9 @@ unsigned kBenchmarkThreadNum;
 unsigned kRoutingThreadCount;
 unsigned kDefaultLocalReplication;
 
+// the number of keys WARM mode hands to the client per bulk load
+const unsigned kWarmBatchSize = 10000;
+
 ZmqUtil zmq_util;
 ZmqUtilInterface* kZmqUtil = &zmq_util;
 
@@ -286,18 +289,31 @@ void run(const unsigned& thread_id,
         unsigned start = thread_id * range + 1;
         unsigned end = thread_id * range + 1 + range;
 
-        Key key;
         auto warmup_start = std::chrono::system_clock::now();
 
+        // the keys are loaded in batches so that each server thread receives
+        // a few large requests instead of one request per key
+        vector<std::pair<Key, LWWPairLattice<string>>> batch;
+        unsigned failed = 0;
+
         for (unsigned i = start; i < end; i++) {
           if (i % 50000 == 0) {
             log->info("Creating key {}.", i);
           }
 
           unsigned ts = generate_timestamp(thread_id);
-          LWWPairLattice<string> val(
-              TimestampValuePair<string>(ts, string(length, 'a')));
-          client.put(generate_key(i), val);
+          batch.push_back(std::make_pair(
+              generate_key(i), LWWPairLattice<string>(TimestampValuePair<string>(
+                                   ts, string(length, 'a')))));
+
+          if (batch.size() == kWarmBatchSize || i == end - 1) {
+            failed += client.put_bulk(batch);
+            batch.clear();
+          }
+        }
+
+        if (failed > 0) {
+          log->error("Failed to create {} keys.", failed);
         }
 
         auto warmup_time = std::chrono::duration_cast<std::chrono::seconds>(
@@ -0,0 +1,125 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#include "kvs/base_kv_store.hpp"
+#include "kvs/flat_kv_store.hpp"
+#include "lattices/lww_pair_lattice.hpp"
+
+// Measures the memory footprint and GET throughput of the memory-tier backing
+// stores with LWW values. Each run loads a single store, so that the resident
+// memory of one store is not mixed up with memory freed by another; run it
+// once with "map" (the MapLattice-based KVStore) and once with "flat" (the
+// FlatKVStore the memory tier uses) to compare them.
+
+typedef LWWPairLattice<string> Value;
+
+string generate_key(unsigned n) {
+  return string(8 - std::to_string(n).length(), '0') + std::to_string(n);
+}
+
+// the resident memory of this process, in bytes
+unsigned long long resident_memory() {
+  std::ifstream statm("/proc/self/statm");
+  unsigned long long size = 0;
+  unsigned long long resident = 0;
+  statm >> size >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+template <typename Store>
+void run(Store& store, unsigned key_count, unsigned value_size,
+         unsigned get_count) {
+  unsigned long long memory_start = resident_memory();
+  auto load_start = std::chrono::system_clock::now();
+
+  for (unsigned i = 0; i < key_count; i++) {
+    store.put(generate_key(i),
+              Value(TimestampValuePair<string>(i, string(value_size, 'a'))));
+  }
+
+  auto load_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now() - load_start)
+                       .count();
+  unsigned long long memory = resident_memory() - memory_start;
+
+  // generate the keys up front so that only the lookups are timed
+  unsigned seed = 0;
+  vector<Key> keys;
+  keys.reserve(get_count);
+  for (unsigned i = 0; i < get_count; i++) {
+    keys.push_back(generate_key(rand_r(&seed) % key_count));
+  }
+
+  unsigned errors = 0;
+  unsigned long long total = 0;
+  auto get_start = std::chrono::system_clock::now();
+
+  for (const Key& key : keys) {
+    unsigned error = 0;
+    total += store.get(key, error).reveal().timestamp;
+    errors += error;
+  }
+
+  auto get_time = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::system_clock::now() - get_start)
+                      .count();
+
+  std::cout << "Loaded " << key_count << " keys in " << load_time << " ms."
+            << std::endl;
+  std::cout << "Bytes per key: " << memory / key_count << " (values are "
+            << value_size << " bytes)." << std::endl;
+  std::cout << "GET throughput: "
+            << static_cast<double>(get_count) / get_time * 1000000
+            << " ops/s (" << errors << " errors, checksum " << total << ")."
+            << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2 || argc > 5) {
+    std::cerr << "Usage: " << argv[0]
+              << " <map | flat> [key count] [value size] [GET count]"
+              << std::endl;
+    return 1;
+  }
+
+  string store_type = argv[1];
+  unsigned key_count = argc > 2 ? std::stoul(argv[2]) : 10000000;
+  unsigned value_size = argc > 3 ? std::stoul(argv[3]) : 8;
+  unsigned get_count = argc > 4 ? std::stoul(argv[4]) : 10000000;
+
+  if (key_count == 0) {
+    std::cerr << "The key count must be positive." << std::endl;
+    return 1;
+  }
+
+  if (store_type == "map") {
+    KVStore<Key, Value> store;
+    run(store, key_count, value_size, get_count);
+  } else if (store_type == "flat") {
+    FlatKVStore<Value> store;
+    run(store, key_count, value_size, get_count);
+  } else {
+    std::cerr << "Unknown store type " << store_type << "." << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,192 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#include "lattices/lww_pair_lattice.hpp"
+#include "lattices/vector_clock.hpp"
+
+// Measures the per-value memory overhead of the lattices and the throughput of
+// their merges, including the per-entry merges of lattices nested inside a
+// MapLattice, and compares vector clocks keyed by interned node ids with ones
+// keyed by strings.
+
+const unsigned kClockSize = 16;
+
+// vector clocks as they were kept before node ids were interned
+typedef MapLattice<string, MaxLattice<unsigned>> StringClock;
+
+// the resident memory of this process, in bytes
+unsigned long long resident_memory() {
+  std::ifstream statm("/proc/self/statm");
+  unsigned long long size = 0;
+  unsigned long long resident = 0;
+  statm >> size >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+template <typename F>
+void time_merges(const string& name, unsigned long long merges, F f) {
+  auto start = std::chrono::system_clock::now();
+  unsigned long long checksum = f();
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::system_clock::now() - start)
+                  .count();
+
+  std::cout << name << ": " << static_cast<double>(merges) / time * 1000000
+            << " merges/s (checksum " << checksum << ")." << std::endl;
+}
+
+void insert(StringClock& clock, const string& node, unsigned version) {
+  clock.insert(node, MaxLattice<unsigned>(version));
+}
+
+void insert(VectorClock& clock, const string& node, unsigned version) {
+  clock.insert(node, version);
+}
+
+unsigned long long version_sum(const StringClock& clock) {
+  unsigned long long total = 0;
+  for (const auto& pair : clock.reveal()) {
+    total += pair.second.reveal();
+  }
+  return total;
+}
+
+unsigned long long version_sum(const VectorClock& clock) {
+  unsigned long long total = 0;
+  for (const auto& entry : clock.reveal()) {
+    total += entry.second;
+  }
+  return total;
+}
+
+// how string-keyed clocks were compared: by merging copies of them
+bool dominates(const StringClock& lhs, const StringClock& rhs) {
+  StringClock merged = lhs;
+  merged.merge(rhs);
+  return merged == lhs;
+}
+
+bool dominates(const VectorClock& lhs, const VectorClock& rhs) {
+  return lhs.dominates(rhs);
+}
+
+template <typename Clock>
+Clock generate_clock(unsigned seed) {
+  Clock clock;
+  for (unsigned i = 0; i < kClockSize; i++) {
+    insert(clock, "node" + std::to_string(i), rand_r(&seed) % 1000);
+  }
+  return clock;
+}
+
+template <typename Clock>
+void run_clocks(const string& name, unsigned value_count,
+                unsigned merge_count) {
+  unsigned long long memory_start = resident_memory();
+  vector<Clock> clocks;
+  for (unsigned i = 0; i < value_count / kClockSize + 1; i++) {
+    clocks.push_back(generate_clock<Clock>(i));
+  }
+  std::cout << "Bytes per " << name << " entry: "
+            << (resident_memory() - memory_start) / (clocks.size() * kClockSize)
+            << std::endl;
+
+  // every merge of two clocks merges each of their entries
+  unsigned clock_merges = merge_count / kClockSize;
+
+  Clock merged;
+  time_merges(name + " entry", merge_count, [&] {
+    for (unsigned i = 0; i < clock_merges; i++) {
+      merged.merge(clocks[i % clocks.size()]);
+    }
+    return version_sum(merged);
+  });
+
+  // the merged clock dominates every clock, so each comparison reads every
+  // entry of both
+  auto start = std::chrono::system_clock::now();
+  unsigned dominated = 0;
+  for (unsigned i = 0; i < clock_merges; i++) {
+    dominated += dominates(merged, clocks[i % clocks.size()]);
+  }
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::system_clock::now() - start)
+                  .count();
+
+  std::cout << name << " comparisons: "
+            << static_cast<double>(clock_merges) / time * 1000000
+            << " /s (" << dominated << " dominated)." << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 3) {
+    std::cerr << "Usage: " << argv[0] << " [value count] [merge count]"
+              << std::endl;
+    return 1;
+  }
+
+  unsigned value_count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+  unsigned merge_count = argc > 2 ? std::stoul(argv[2]) : 10000000;
+
+  if (value_count == 0) {
+    std::cerr << "The value count must be positive." << std::endl;
+    return 1;
+  }
+
+  std::cout << "sizeof(MaxLattice<unsigned>): " << sizeof(MaxLattice<unsigned>)
+            << std::endl;
+  std::cout << "sizeof(SetLattice<string>): " << sizeof(SetLattice<string>)
+            << std::endl;
+  std::cout << "sizeof(LWWPairLattice<string>): "
+            << sizeof(LWWPairLattice<string>) << std::endl;
+
+  unsigned long long memory_start = resident_memory();
+  vector<MaxLattice<unsigned>> maxes(value_count);
+  std::cout << "Bytes per MaxLattice in a vector: "
+            << (resident_memory() - memory_start) / value_count << std::endl;
+
+  time_merges("MaxLattice", merge_count, [&] {
+    unsigned seed = 0;
+    for (unsigned i = 0; i < merge_count; i++) {
+      maxes[i % value_count].merge(rand_r(&seed));
+    }
+
+    unsigned long long total = 0;
+    for (const auto& max : maxes) {
+      total += max.reveal();
+    }
+    return total;
+  });
+
+  time_merges("LWWPairLattice", merge_count, [&] {
+    LWWPairLattice<string> lww;
+    string value(8, 'a');
+    for (unsigned i = 0; i < merge_count; i++) {
+      lww.merge(TimestampValuePair<string>(i, value));
+    }
+    return lww.reveal().timestamp;
+  });
+
+  run_clocks<VectorClock>("VectorClock", value_count, merge_count);
+  run_clocks<StringClock>("StringClock", value_count, merge_count);
+
+  return 0;
+}
@@ -0,0 +1,98 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "kvs/kvs_handlers.hpp"
+
+void anti_entropy_handler(string& serialized,
+                          map<Address, MerkleTree>& merkle_trees,
+                          map<Key, KeyProperty>& stored_key_map,
+                          ServerThread& wt, SerializerMap& serializers,
+                          SocketCache& pushers) {
+  MerkleDigest digest;
+  digest.ParseFromString(serialized);
+
+  if (digest.level() > kMerkleDepth ||
+      digest.nodes_size() != digest.hashes_size()) {
+    return;
+  }
+
+  // a peer this thread shares no keys with is compared against an empty tree
+  static const MerkleTree kEmptyTree;
+  auto tree_it = merkle_trees.find(digest.address());
+  const MerkleTree& tree =
+      tree_it == merkle_trees.end() ? kEmptyTree : tree_it->second;
+
+  AddressKeysetMap addr_keyset_map;
+
+  if (digest.fetch()) {
+    // the peer found that these leaves differ and asks for our keys in them
+    for (const unsigned& leaf : digest.nodes()) {
+      for (const Key& key : tree.keys(leaf)) {
+        addr_keyset_map[digest.gossip_address()].insert(key);
+      }
+    }
+
+    send_gossip(addr_keyset_map, pushers, serializers, stored_key_map);
+    return;
+  }
+
+  vector<unsigned> differing;
+  for (int i = 0; i < digest.nodes_size(); i++) {
+    if (tree.hash(digest.level(), digest.nodes(i)) != digest.hashes(i)) {
+      differing.push_back(digest.nodes(i));
+    }
+  }
+
+  if (differing.size() == 0) {
+    return;
+  }
+
+  MerkleDigest reply;
+  reply.set_address(wt.anti_entropy_connect_address());
+  reply.set_gossip_address(wt.gossip_connect_address());
+
+  if (digest.level() < kMerkleDepth) {
+    // ask the peer to compare the children of the nodes that differ
+    unsigned level = digest.level() + 1;
+    reply.set_level(level);
+
+    for (const unsigned& node : differing) {
+      for (unsigned i = 0; i < kMerkleFanout; i++) {
+        unsigned child = node * kMerkleFanout + i;
+        reply.add_nodes(child);
+        reply.add_hashes(tree.hash(level, child));
+      }
+    }
+  } else {
+    // the leaves themselves differ, so each side gossips its keys in them to
+    // the other; merging is idempotent, so keys both sides have in sync are
+    // merely sent again
+    reply.set_level(digest.level());
+    reply.set_fetch(true);
+
+    for (const unsigned& leaf : differing) {
+      reply.add_nodes(leaf);
+
+      for (const Key& key : tree.keys(leaf)) {
+        addr_keyset_map[digest.gossip_address()].insert(key);
+      }
+    }
+
+    send_gossip(addr_keyset_map, pushers, serializers, stored_key_map);
+  }
+
+  string reply_serialized;
+  reply.SerializeToString(&reply_serialized);
+  kZmqUtil->send_string(reply_serialized, &pushers[digest.address()]);
+}
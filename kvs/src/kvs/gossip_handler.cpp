@@ -20,14 +20,70 @@ void gossip_handler(unsigned& seed, string& serialized,
                     map<Key, vector<PendingGossip>>& pending_gossip,
                     map<Key, KeyProperty>& stored_key_map,
                     map<Key, KeyReplication>& key_replication_map,
+                    set<Key>& merkle_changeset,
+                    map<Address, ReplicationOffset>& gossip_offsets,
+                    map<Address, ReplicationStream>& replication_streams,
                     ServerThread& wt, SerializerMap& serializers,
                     SocketCache& pushers, logger log) {
   KeyRequest gossip;
   gossip.ParseFromString(serialized);
 
+  if (gossip.has_compressed_tuples()) {
+    const Codec* codec = get_codec(gossip.codec());
+    string tuples;
+
+    if (codec == nullptr ||
+        !codec->decompress(gossip.compressed_tuples().data(),
+                           gossip.compressed_tuples().size(), tuples)) {
+      // left unacknowledged, like any gossip that did not arrive
+      log->error("Unable to decompress gossip compressed by codec {}.",
+                 gossip.codec());
+      return;
+    }
+
+    gossip.clear_compressed_tuples();
+    gossip.MergeFromString(tuples);
+  }
+
+  if (gossip.has_sequence()) {
+    // gossip on a replication stream is applied once and in order; anything
+    // else is dropped, and the sender resends it until it is acknowledged
+    ReplicationOffset& offset = gossip_offsets[gossip.ack_address()];
+    if (offset.epoch_ != gossip.epoch()) {
+      // the sender has started a new stream, e.g., because it restarted
+      offset.epoch_ = gossip.epoch();
+      offset.next_ = gossip.first();
+    } else if (offset.next_ < gossip.first()) {
+      // the sender can no longer resend what we missed, and sends the keys in
+      // it whole instead
+      offset.next_ = gossip.first();
+    }
+
+    bool in_order = gossip.sequence() == offset.next_;
+    if (in_order) {
+      offset.next_++;
+    }
+
+    ReplicationAck ack;
+    ack.set_address(wt.gossip_connect_address());
+    ack.set_next(offset.next_);
+    ack.set_epoch(offset.epoch_);
+
+    string ack_serialized;
+    ack.SerializeToString(&ack_serialized);
+    kZmqUtil->send_string(ack_serialized, &pushers[gossip.ack_address()]);
+
+    if (!in_order) {
+      return;
+    }
+  }
+
   bool succeed;
   map<Address, KeyRequest> gossip_map;
 
+  // gossip passed on to this thread's children in gossip trees
+  map<Address, KeyRequest> forward_map;
+
   for (const KeyTuple& tuple : gossip.tuples()) {
     // first check if the thread is responsible for the key
     Key key = tuple.key();
@@ -47,7 +103,22 @@ void gossip_handler(unsigned& seed, string& serialized,
                      stored_key_map[key].type_);
         } else {
           process_put(tuple.key(), tuple.lattice_type(), tuple.payload(),
-                      serializers[tuple.lattice_type()], stored_key_map);
+                      serializers.at(tuple.lattice_type()), stored_key_map);
+          merkle_changeset.insert(key);
+
+          if (tuple.has_gossip_root()) {
+            ServerThreadList replicas = kHashRingUtil->get_responsible_threads(
+                wt.replication_response_connect_address(), key,
+                is_metadata(key), global_hash_rings, local_hash_rings,
+                key_replication_map, pushers, kAllTierIds, succeed, seed);
+
+            for (const ServerThread& child :
+                 tree_gossip_children(replicas, tuple.gossip_root(), wt)) {
+              KeyRequest& forward = forward_map[child.gossip_connect_address()];
+              forward.set_type(RequestType::PUT);
+              *forward.add_tuples() = tuple;
+            }
+          }
         }
       } else {
         if (is_metadata(key)) {  // forward the gossip
@@ -77,6 +148,8 @@ void gossip_handler(unsigned& seed, string& serialized,
     }
   }
 
+  queue_replicated_gossip(forward_map, replication_streams, wt);
+
   // redirect gossip
   for (const auto& gossip_pair : gossip_map) {
     string serialized;
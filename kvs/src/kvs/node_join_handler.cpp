@@ -30,6 +30,13 @@ void node_join_handler(unsigned thread_id, unsigned& seed, Address public_ip,
   Address new_server_private_ip = v[2];
   int join_count = stoi(v[3]);
 
+  // a rejoining node that restarted from a snapshot only needs the keys that
+  // changed since the snapshot began
+  unsigned long long snapshot_time = 0;
+  if (v.size() > 4) {
+    snapshot_time = stoull(v[4]);
+  }
+
   // update global hash ring
   bool inserted = global_hash_rings[tier].insert(
       new_server_public_ip, new_server_private_ip, join_count, 0);
@@ -81,6 +88,13 @@ void node_join_handler(unsigned thread_id, unsigned& seed, Address public_ip,
     if (tier == kSelfTierId) {
       bool succeed;
 
+      // a rejoining node's snapshot only has the keys it was responsible for
+      // when the snapshot began, so keys are only left out if the servers
+      // in the ring and the key's replication factors have not changed since
+      bool ring_unchanged =
+          global_hash_rings[tier].get_changed() + kSnapshotClockSkew <
+          snapshot_time;
+
       for (const auto& key_pair : stored_key_map) {
         Key key = key_pair.first;
         ServerThreadList threads = kHashRingUtil->get_responsible_threads(
@@ -101,6 +115,19 @@ void node_join_handler(unsigned thread_id, unsigned& seed, Address public_ip,
           // now
           bool rejoin_responsible = false;
           if (join_count > 0) {
+            auto replication_it = key_replication_map.find(key);
+            bool replicas_unchanged =
+                ring_unchanged &&
+                (replication_it == key_replication_map.end() ||
+                 replication_it->second.changed_ + kSnapshotClockSkew <
+                     snapshot_time);
+
+            if (replicas_unchanged &&
+                key_pair.second.modified_ + kSnapshotClockSkew <
+                    snapshot_time) {
+              continue;
+            }
+
             for (const ServerThread& thread : threads) {
               if (thread.private_ip().compare(new_server_private_ip) == 0) {
                 join_gossip_map[thread.gossip_connect_address()].insert(key);
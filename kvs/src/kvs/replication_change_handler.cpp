@@ -21,7 +21,8 @@ void replication_change_handler(Address public_ip, Address private_ip,
                                 map<TierId, LocalHashRing>& local_hash_rings,
                                 map<Key, KeyProperty>& stored_key_map,
                                 map<Key, KeyReplication>& key_replication_map,
-                                set<Key>& local_changeset, ServerThread& wt,
+                                map<Key, KeyDelta>& local_changeset,
+                                set<Key>& merkle_changeset, ServerThread& wt,
                                 SerializerMap& serializers,
                                 SocketCache& pushers) {
   log->info("Received a replication factor change.");
@@ -46,6 +47,12 @@ void replication_change_handler(Address public_ip, Address private_ip,
 
   for (const ReplicationFactor& key_rep : rep_change.key_reps()) {
     Key key = key_rep.key();
+
+    // the key may have new replicas to compare it with, and to resend it to
+    // when they rejoin
+    merkle_changeset.insert(key);
+    key_replication_map[key].changed_ = get_time();
+
     // if this thread has the key stored before the change
     if (stored_key_map.find(key) != stored_key_map.end()) {
       ServerThreadList orig_threads = kHashRingUtil->get_responsible_threads(
@@ -149,7 +156,7 @@ void replication_change_handler(Address public_ip, Address private_ip,
 
   // remove keys
   for (const string& key : remove_set) {
-    serializers[stored_key_map[key].type_]->remove(key);
+    serializers.at(stored_key_map[key].type_)->remove(key);
     stored_key_map.erase(key);
     local_changeset.erase(key);
   }
@@ -22,8 +22,10 @@ void replication_response_handler(
     map<Key, vector<PendingGossip>>& pending_gossip,
     map<Key, std::multiset<TimePoint>>& key_access_tracker,
     map<Key, KeyProperty>& stored_key_map,
-    map<Key, KeyReplication>& key_replication_map, set<Key>& local_changeset,
-    ServerThread& wt, SerializerMap& serializers, SocketCache& pushers) {
+    map<Key, KeyReplication>& key_replication_map,
+    map<Key, KeyDelta>& local_changeset, set<Key>& merkle_changeset,
+    ServerThread& wt, SerializerMap& serializers, SocketCache& pushers,
+    map<Address, vector<string>>& uncommitted_responses) {
   KeyResponse response;
   response.ParseFromString(serialized);
 
@@ -104,10 +106,12 @@ void replication_response_handler(
           response.SerializeToString(&serialized_response);
           kZmqUtil->send_string(serialized_response, &pushers[request.addr_]);
         } else if (responsible && request.addr_ == "") {
-          // only put requests should fall into this category
-          if (request.type_ == RequestType::PUT) {
+          // only put and increment requests should fall into this category
+          if (request.type_ == RequestType::PUT ||
+              request.type_ == RequestType::INCREMENT) {
             if (request.lattice_type_ == LatticeType::NO) {
-              log->error("PUT request missing lattice type.");
+              log->error("{} request missing lattice type.",
+                         RequestType_Name(request.type_));
             } else if (stored_key_map.find(key) != stored_key_map.end() &&
                        stored_key_map[key].type_ != LatticeType::NO &&
                        stored_key_map[key].type_ != request.lattice_type_) {
@@ -117,12 +121,27 @@ void replication_response_handler(
                   key, LatticeType_Name(request.lattice_type_),
                   LatticeType_Name(stored_key_map[key].type_));
             } else {
-              process_put(key, request.lattice_type_, request.payload_,
-                          serializers[request.lattice_type_], stored_key_map);
-              key_access_tracker[key].insert(now);
+              bool applied = true;
+              if (request.type_ == RequestType::INCREMENT) {
+                applied = process_increment(
+                    key, request.lattice_type_, request.payload_, wt.id(),
+                    serializers.at(request.lattice_type_), stored_key_map,
+                    local_changeset);
+              } else {
+                process_put(key, request.lattice_type_, request.payload_,
+                            serializers.at(request.lattice_type_),
+                            stored_key_map);
+                track_delta(local_changeset[key], request.payload_);
+              }
+
+              if (applied) {
+                key_access_tracker[key].insert(now);
 
-              access_count += 1;
-              local_changeset.insert(key);
+                access_count += 1;
+              } else {
+                log->error("Invalid INCREMENT of {} key {}.",
+                           LatticeType_Name(request.lattice_type_), key);
+              }
             }
           } else {
             log->error("Received a GET request with no response address.");
@@ -145,14 +164,15 @@ void replication_response_handler(
               tp->set_error(1);
             } else {
               auto res =
-                  process_get(key, serializers[stored_key_map[key].type_]);
+                  process_get(key, serializers.at(stored_key_map[key].type_));
               tp->set_lattice_type(stored_key_map[key].type_);
-              tp->set_payload(res.first);
+              tp->set_payload(std::move(res.first));
               tp->set_error(res.second);
             }
           } else {
             if (request.lattice_type_ == LatticeType::NO) {
-              log->error("PUT request missing lattice type.");
+              log->error("{} request missing lattice type.",
+                         RequestType_Name(request.type_));
             } else if (stored_key_map.find(key) != stored_key_map.end() &&
                        stored_key_map[key].type_ != LatticeType::NO &&
                        stored_key_map[key].type_ != request.lattice_type_) {
@@ -161,12 +181,26 @@ void replication_response_handler(
                   "expected.",
                   key, LatticeType_Name(request.lattice_type_),
                   LatticeType_Name(stored_key_map[key].type_));
+              tp->set_error(3);
+            } else if (request.type_ == RequestType::INCREMENT) {
+              if (process_increment(key, request.lattice_type_,
+                                    request.payload_, wt.id(),
+                                    serializers.at(request.lattice_type_),
+                                    stored_key_map, local_changeset)) {
+                tp->set_error(0);
+                tp->set_lattice_type(request.lattice_type_);
+              } else {
+                log->error("Invalid INCREMENT of {} key {}.",
+                           LatticeType_Name(request.lattice_type_), key);
+                tp->set_error(3);
+              }
             } else {
               process_put(key, request.lattice_type_, request.payload_,
-                          serializers[request.lattice_type_], stored_key_map);
+                          serializers.at(request.lattice_type_),
+                          stored_key_map);
+              track_delta(local_changeset[key], request.payload_);
               tp->set_error(0);
               tp->set_lattice_type(request.lattice_type_);
-              local_changeset.insert(key);
             }
           }
           key_access_tracker[key].insert(now);
@@ -174,7 +208,15 @@ void replication_response_handler(
 
           string serialized_response;
           response.SerializeToString(&serialized_response);
-          kZmqUtil->send_string(serialized_response, &pushers[request.addr_]);
+
+          // EBS writes are acknowledged once they have been committed
+          if ((request.type_ == RequestType::PUT ||
+               request.type_ == RequestType::INCREMENT) &&
+              kSelfTierId == kEbsTierId) {
+            uncommitted_responses[request.addr_].push_back(serialized_response);
+          } else {
+            kZmqUtil->send_string(serialized_response, &pushers[request.addr_]);
+          }
         }
       }
     } else {
@@ -204,7 +246,8 @@ void replication_response_handler(
                 LatticeType_Name(stored_key_map[key].type_));
           } else {
             process_put(key, gossip.lattice_type_, gossip.payload_,
-                        serializers[gossip.lattice_type_], stored_key_map);
+                        serializers.at(gossip.lattice_type_), stored_key_map);
+            merkle_changeset.insert(key);
           }
         }
       } else {
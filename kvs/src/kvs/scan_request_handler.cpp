@@ -0,0 +1,77 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "kvs/kvs_handlers.hpp"
+
+void scan_keys(const KeyRequest& request, const KeyIndex& key_index,
+               map<Key, KeyProperty>& stored_key_map, vector<Key>& keys) {
+  Key start = request.tuples_size() > 0 ? request.tuples(0).key() : "";
+
+  // keys are filtered as they are scanned, so that the replication factors
+  // this thread stores and keys without a value do not take up the limit;
+  // clients page through a range by resuming after the last key they got
+  key_index.scan(start, request.scan_end(), request.scan_limit(), keys,
+                 [&stored_key_map](const Key& key) {
+                   if (is_metadata(key)) {
+                     return false;
+                   }
+
+                   auto it = stored_key_map.find(key);
+                   return it != stored_key_map.end() &&
+                          it->second.type_ != LatticeType::NO;
+                 });
+}
+
+void scan_request_handler(const KeyRequest& request, KeyIndex* key_index,
+                          const vector<Key>& keys,
+                          map<Key, KeyProperty>& stored_key_map,
+                          SerializerMap& serializers, SocketCache& pushers) {
+  if (!request.has_response_address()) {
+    return;
+  }
+
+  KeyResponse response;
+  response.set_type(RequestType::SCAN);
+
+  if (request.has_request_id()) {
+    response.set_response_id(request.request_id());
+  }
+
+  if (key_index == nullptr) {
+    // this thread does not keep its keys in order
+    response.set_error(1);
+  } else {
+    for (const Key& key : keys) {
+      // the key may have been removed while its value was being read
+      auto it = stored_key_map.find(key);
+      if (it == stored_key_map.end() || it->second.type_ == LatticeType::NO) {
+        continue;
+      }
+
+      KeyTuple* tp = response.add_tuples();
+      tp->set_key(key);
+      tp->set_lattice_type(it->second.type_);
+
+      if (request.scan_values()) {
+        auto res = process_get(key, serializers.at(it->second.type_));
+        tp->set_payload(std::move(res.first));
+        tp->set_error(res.second);
+      } else {
+        tp->set_error(0);
+      }
+    }
+  }
+
+  send_request<KeyResponse>(response, pushers[request.response_address()]);
+}
@@ -153,17 +153,56 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
     }
   }
 
+  // where the memory threads keep their snapshots, and how often they take
+  // them (in milliseconds); snapshots are off unless a directory is given,
+  // and a period of 0 disables them as well
+  string snapshot_root;
+  unsigned long long snapshot_period = 0;
+
+  if (kSelfTierId == kMemoryTierId) {
+    YAML::Node conf = YAML::LoadFile("conf/kvs-config.yml");
+
+    if (conf["memory-snapshot"]) {
+      snapshot_root = conf["memory-snapshot"].as<string>();
+      snapshot_period = conf["memory-snapshot-period"].as<unsigned>() * 1000;
+
+      if (snapshot_root.back() != '/') {
+        snapshot_root += "/";
+      }
+    }
+  }
+
   // thread 0 notifies other servers that it has joined
   if (thread_id == 0) {
     string msg = std::to_string(kSelfTierId) + ":" + public_ip + ":" +
                  private_ip + ":" + count_str;
 
+    // if every thread has a snapshot to restart from, the other servers only
+    // have to send us the keys that changed since the oldest of them began
+    string join_msg = msg;
+    if (snapshot_period > 0) {
+      unsigned long long snapshot_time = 0;
+      for (unsigned tid = 0; tid < kThreadNum; tid++) {
+        unsigned long long time = Snapshotter::timestamp(
+            snapshot_root + "snapshot_" + std::to_string(tid));
+
+        if (tid == 0 || time < snapshot_time) {
+          snapshot_time = time;
+        }
+      }
+
+      if (snapshot_time > 0) {
+        join_msg += ":" + std::to_string(snapshot_time);
+      }
+    }
+
     for (const auto& pair : global_hash_rings) {
       GlobalHashRing hash_ring = pair.second;
 
       for (const ServerThread& st : hash_ring.get_unique_servers()) {
         if (st.private_ip().compare(private_ip) != 0) {
-          kZmqUtil->send_string(msg, &pushers[st.node_join_connect_address()]);
+          kZmqUtil->send_string(join_msg,
+                                &pushers[st.node_join_connect_address()]);
         }
       }
     }
@@ -185,42 +224,135 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
 
   SerializerMap serializers;
 
-  Serializer* lww_serializer;
-  Serializer* set_serializer;
-  Serializer* ordered_set_serializer;
-  Serializer* causal_serializer;
-  Serializer* cross_causal_serializer;
+  // the append-only log backing all EBS serializers of this thread
+  EBSLog* ebs_log = nullptr;
+
+  // the decoded values of the EBS keys this thread reads most
+  ValueCache* value_cache = nullptr;
+
+  // compresses the values this thread writes to the EBS log, if configured
+  Codec* codec = nullptr;
+
+  // how long EBS writes are buffered before they are committed (in
+  // microseconds)
+  unsigned commit_window = 0;
 
   if (kSelfTierId == kMemoryTierId) {
-    MemoryLWWKVS* lww_kvs = new MemoryLWWKVS();
-    lww_serializer = new MemoryLWWSerializer(lww_kvs);
-    MemorySetKVS* set_kvs = new MemorySetKVS();
-    set_serializer = new MemorySetSerializer(set_kvs);
-    MemoryOrderedSetKVS* ordered_set_kvs = new MemoryOrderedSetKVS();
-    ordered_set_serializer = new MemoryOrderedSetSerializer(ordered_set_kvs);
-    MemoryCausalKVS* causal_kvs = new MemoryCausalKVS();
-    causal_serializer = new MemoryCausalSerializer(causal_kvs);
-    MemoryCrossCausalKVS* cross_causal_kvs = new MemoryCrossCausalKVS();
-    cross_causal_serializer = new MemoryCrossCausalSerializer(cross_causal_kvs);
+    MemorySerializerRegistrar registrar{serializers};
+    register_lattice_types(registrar);
   } else if (kSelfTierId == kEbsTierId) {
-    lww_serializer = new EBSLWWSerializer(thread_id);
-    set_serializer = new EBSSetSerializer(thread_id);
-    ordered_set_serializer = new EBSOrderedSetSerializer(thread_id);
-    causal_serializer = new EBSCausalSerializer(thread_id);
-    cross_causal_serializer = new EBSCrossCausalSerializer(thread_id);
+    YAML::Node conf = YAML::LoadFile("conf/kvs-config.yml");
+    string ebs_root = conf["ebs"].as<string>();
+
+    if (ebs_root.back() != '/') {
+      ebs_root += "/";
+    }
+
+    commit_window = conf["ebs-commit-window"].as<unsigned>();
+    codec = make_codec(conf["ebs-codec"].as<string>(),
+                       conf["ebs-codec-threshold"].as<unsigned>());
+
+    ebs_log =
+        new EBSLog(ebs_root + "ebs_" + std::to_string(thread_id), codec);
+    value_cache = new ValueCache();
+    EBSSerializerRegistrar registrar{serializers, ebs_log, value_cache};
+    register_lattice_types(registrar);
   } else {
     log->error("Invalid node type");
     exit(1);
   }
 
-  serializers[LatticeType::LWW] = lww_serializer;
-  serializers[LatticeType::SET] = set_serializer;
-  serializers[LatticeType::ORDERED_SET] = ordered_set_serializer;
-  serializers[LatticeType::CAUSAL] = causal_serializer;
-  serializers[LatticeType::CROSSCAUSAL] = cross_causal_serializer;
+  // keeps the keys of this thread in order so that they can be scanned
+  KeyIndex* key_index = nullptr;
+
+  YAML::Node conf = YAML::LoadFile("conf/kvs-config.yml");
+
+  // compresses the batches of gossip this thread sends, if configured
+  Codec* gossip_codec =
+      make_codec(conf["gossip-codec"].as<string>(),
+                 conf["gossip-codec-threshold"].as<unsigned>());
+
+  if (conf["key-index"].as<bool>()) {
+    key_index = new KeyIndex();
+
+    for (const LatticeType& type : serializers.types()) {
+      serializers.set(type,
+                      new IndexedSerializer(serializers.at(type), key_index));
+    }
+  }
+
+  // keys recovered from the EBS log are served right away
+  if (ebs_log != nullptr) {
+    for (const auto& key_pair : ebs_log->index()) {
+      stored_key_map[key_pair.first].size_ = ebs_log->size(key_pair.first);
+      stored_key_map[key_pair.first].type_ = key_pair.second.type_;
+
+      if (key_index != nullptr) {
+        key_index->insert(key_pair.first);
+      }
+    }
+
+    log->info("Recovered {} keys from the EBS log.", stored_key_map.size());
+  }
+
+  // periodically snapshots the keys of a memory thread to local disk
+  Snapshotter* snapshotter = nullptr;
+
+  // keys recovered from the last snapshot are served right away as well
+  if (snapshot_period > 0) {
+    string snapshot_path =
+        snapshot_root + "snapshot_" + std::to_string(thread_id);
+    unsigned long long snapshot_time = Snapshotter::load(
+        snapshot_path, serializers, stored_key_map, key_replication_map);
+
+    if (snapshot_time > 0) {
+      log->info("Recovered {} keys from the snapshot taken at {}.",
+                stored_key_map.size(), snapshot_time);
+    }
+
+    snapshotter = new Snapshotter(snapshot_path, snapshot_period);
+  }
 
   // the set of changes made on this thread since the last round of gossip
-  set<Key> local_changeset;
+  map<Key, KeyDelta> local_changeset;
+
+  // the gossip sent to each replica that it has not acknowledged yet, by the
+  // replica's gossip address
+  map<Address, ReplicationStream> replication_streams;
+
+  // for the replication stream of each thread that gossips to this one, by
+  // its acknowledgement address, the next message expected from it
+  map<Address, ReplicationOffset> gossip_offsets;
+
+  // whether any replication stream has gossip to send, either queued or due
+  // to be sent again
+  bool gossip_queued = false;
+
+  // the gossip this thread has sent since its last report
+  GossipStatistics gossip_stats;
+
+  // this thread's Merkle tree for each replica it shares keys with, the keys
+  // whose digests in them are out of date, and the keys that may belong in
+  // other trees, starting with any recovered from a snapshot
+  map<Address, MerkleTree> merkle_trees;
+  set<Key> merkle_changeset;
+  std::deque<Key> merkle_relocations;
+  for (const auto& key_pair : stored_key_map) {
+    merkle_relocations.push_back(key_pair.first);
+  }
+
+  // PUT responses that are released once the next EBS commit is durable
+  map<Address, vector<string>> uncommitted_responses;
+
+  // PUT responses waiting on the EBS commit with the given ticket
+  map<unsigned, map<Address, vector<string>>> committing_responses;
+
+  // GET requests waiting on the EBS reads with the given ticket
+  map<unsigned, string> suspended_requests;
+
+  // SCAN requests waiting on the EBS reads of their values, with the keys
+  // they were found to cover
+  map<unsigned, std::pair<KeyRequest, vector<Key>>> suspended_scans;
 
   // keep track of the key stat
   // the first entry is the size of the key,
@@ -262,6 +394,14 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
   zmq::socket_t cache_ip_response_puller(context, ZMQ_PULL);
   cache_ip_response_puller.bind(wt.cache_ip_response_bind_address());
 
+  // responsible for the anti-entropy exchange with other replicas
+  zmq::socket_t anti_entropy_puller(context, ZMQ_PULL);
+  anti_entropy_puller.bind(wt.anti_entropy_bind_address());
+
+  // responsible for acknowledgements of the gossip this thread sends
+  zmq::socket_t replication_ack_puller(context, ZMQ_PULL);
+  replication_ack_puller.bind(wt.replication_ack_bind_address());
+
   //  Initialize poll set
   vector<zmq::pollitem_t> pollitems = {
       {static_cast<void*>(join_puller), 0, ZMQ_POLLIN, 0},
@@ -271,15 +411,19 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
       {static_cast<void*>(gossip_puller), 0, ZMQ_POLLIN, 0},
       {static_cast<void*>(replication_response_puller), 0, ZMQ_POLLIN, 0},
       {static_cast<void*>(replication_change_puller), 0, ZMQ_POLLIN, 0},
-      {static_cast<void*>(cache_ip_response_puller), 0, ZMQ_POLLIN, 0}};
+      {static_cast<void*>(cache_ip_response_puller), 0, ZMQ_POLLIN, 0},
+      {static_cast<void*>(anti_entropy_puller), 0, ZMQ_POLLIN, 0},
+      {static_cast<void*>(replication_ack_puller), 0, ZMQ_POLLIN, 0}};
 
   auto gossip_start = std::chrono::system_clock::now();
   auto gossip_end = std::chrono::system_clock::now();
   auto report_start = std::chrono::system_clock::now();
   auto report_end = std::chrono::system_clock::now();
+  auto commit_start = std::chrono::system_clock::now();
+  auto anti_entropy_start = std::chrono::system_clock::now();
 
   unsigned long long working_time = 0;
-  unsigned long long working_time_map[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+  unsigned long long working_time_map[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
   unsigned epoch = 0;
 
   // enter event loop
@@ -296,6 +440,12 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
                         key_replication_map, join_remove_set, pushers, wt,
                         join_gossip_map, self_join_count);
 
+      // the keys may have new replicas to compare them with
+      merkle_relocations.clear();
+      for (const auto& key_pair : stored_key_map) {
+        merkle_relocations.push_back(key_pair.first);
+      }
+
       auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
                               std::chrono::system_clock::now() - work_start)
                               .count();
@@ -310,6 +460,11 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
       node_depart_handler(thread_id, public_ip, private_ip, global_hash_rings,
                           log, serialized, pushers);
 
+      merkle_relocations.clear();
+      for (const auto& key_pair : stored_key_map) {
+        merkle_relocations.push_back(key_pair.first);
+      }
+
       auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
                               std::chrono::system_clock::now() - work_start)
                               .count();
@@ -331,11 +486,56 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
       auto work_start = std::chrono::system_clock::now();
 
       string serialized = kZmqUtil->recv_string(&request_puller);
-      user_request_handler(access_count, seed, serialized, log,
-                           global_hash_rings, local_hash_rings,
-                           pending_requests, key_access_tracker, stored_key_map,
-                           key_replication_map, local_changeset, wt,
-                           serializers, pushers);
+
+      KeyRequest request;
+      request.ParseFromString(serialized);
+
+      // keys that are missing, buffered, or cached are served from memory
+      vector<Key> keys;
+      if (ebs_log != nullptr && request.type() == RequestType::GET) {
+        for (const auto& tuple : request.tuples()) {
+          if (ebs_log->logged(tuple.key()) &&
+              !value_cache->contains(tuple.key())) {
+            keys.push_back(tuple.key());
+          }
+        }
+      }
+
+      if (request.type() == RequestType::SCAN) {
+        vector<Key> scanned;
+        if (key_index != nullptr) {
+          scan_keys(request, *key_index, stored_key_map, scanned);
+        }
+
+        // values that are only on disk are read in the background, like
+        // those of GETs
+        if (ebs_log != nullptr && request.scan_values()) {
+          for (const Key& key : scanned) {
+            if (ebs_log->logged(key) && !value_cache->contains(key)) {
+              keys.push_back(key);
+            }
+          }
+        }
+
+        if (keys.size() > 0) {
+          suspended_scans[ebs_log->prefetch(keys)] =
+              std::make_pair(std::move(request), std::move(scanned));
+        } else {
+          scan_request_handler(request, key_index, scanned, stored_key_map,
+                               serializers, pushers);
+        }
+      } else if (keys.size() > 0) {
+        // read the keys in the background and resume the request once the
+        // reads have finished
+        suspended_requests[ebs_log->prefetch(keys)] = std::move(serialized);
+      } else {
+        user_request_handler(access_count, seed, serialized, log,
+                             global_hash_rings, local_hash_rings,
+                             pending_requests, key_access_tracker,
+                             stored_key_map, key_replication_map,
+                             local_changeset, wt, serializers, pushers,
+                             uncommitted_responses);
+      }
 
       auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
                               std::chrono::system_clock::now() - work_start)
@@ -350,8 +550,10 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
 
       string serialized = kZmqUtil->recv_string(&gossip_puller);
       gossip_handler(seed, serialized, global_hash_rings, local_hash_rings,
-                     pending_gossip, stored_key_map, key_replication_map, wt,
+                     pending_gossip, stored_key_map, key_replication_map,
+                     merkle_changeset, gossip_offsets, replication_streams, wt,
                      serializers, pushers, log);
+      gossip_queued = true;
 
       auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
                               std::chrono::system_clock::now() - work_start)
@@ -369,7 +571,8 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
           seed, access_count, log, serialized, global_hash_rings,
           local_hash_rings, pending_requests, pending_gossip,
           key_access_tracker, stored_key_map, key_replication_map,
-          local_changeset, wt, serializers, pushers);
+          local_changeset, merkle_changeset, wt, serializers, pushers,
+          uncommitted_responses);
 
       auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
                               std::chrono::system_clock::now() - work_start)
@@ -386,7 +589,8 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
       replication_change_handler(
           public_ip, private_ip, thread_id, seed, log, serialized,
           global_hash_rings, local_hash_rings, stored_key_map,
-          key_replication_map, local_changeset, wt, serializers, pushers);
+          key_replication_map, local_changeset, merkle_changeset, wt,
+          serializers, pushers);
 
       auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
                               std::chrono::system_clock::now() - work_start)
@@ -409,6 +613,47 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
       working_time_map[7] += time_elapsed;
     }
 
+    // receives a step of an anti-entropy exchange
+    if (pollitems[8].revents & ZMQ_POLLIN) {
+      auto work_start = std::chrono::system_clock::now();
+
+      string serialized = kZmqUtil->recv_string(&anti_entropy_puller);
+
+      // only the keys changed since the trees were last used are digested
+      update_merkle_trees(seed, global_hash_rings, local_hash_rings,
+                          stored_key_map, key_replication_map, wt, serializers,
+                          pushers, merkle_changeset, merkle_trees);
+
+      anti_entropy_handler(serialized, merkle_trees, stored_key_map, wt,
+                           serializers, pushers);
+
+      auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now() - work_start)
+                              .count();
+      working_time += time_elapsed;
+      working_time_map[9] += time_elapsed;
+    }
+
+    // receives an acknowledgement of gossip
+    if (pollitems[9].revents & ZMQ_POLLIN) {
+      auto work_start = std::chrono::system_clock::now();
+
+      string serialized = kZmqUtil->recv_string(&replication_ack_puller);
+      ReplicationAck ack;
+      ack.ParseFromString(serialized);
+
+      auto stream_it = replication_streams.find(ack.address());
+      if (stream_it != replication_streams.end()) {
+        stream_it->second.ack(ack.epoch(), ack.next(), get_time());
+      }
+
+      auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now() - work_start)
+                              .count();
+      working_time += time_elapsed;
+      working_time_map[8] += time_elapsed;
+    }
+
     // gossip updates to other threads
     gossip_end = std::chrono::system_clock::now();
     if (std::chrono::duration_cast<std::chrono::microseconds>(gossip_end -
@@ -419,15 +664,31 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
       if (local_changeset.size() > 0) {
         AddressKeysetMap addr_keyset_map;
 
+        // keys with many replicas are only sent to this thread's children in
+        // their gossip trees, which pass them on
+        AddressKeysetMap tree_keyset_map;
+
+        // caches are always sent whole values, since a cache that has dropped
+        // a key would otherwise be left with just its latest changes
+        AddressKeysetMap cache_keyset_map;
+
         bool succeed;
-        for (const Key& key : local_changeset) {
+        for (const auto& change_pair : local_changeset) {
+          const Key& key = change_pair.first;
+
           // Get the threads that we need to gossip to.
           ServerThreadList threads = kHashRingUtil->get_responsible_threads(
               wt.replication_response_connect_address(), key, is_metadata(key),
               global_hash_rings, local_hash_rings, key_replication_map, pushers,
               kAllTierIds, succeed, seed);
 
-          if (succeed) {
+          if (succeed && threads.size() > kTreeGossipThreshold &&
+              std::find(threads.begin(), threads.end(), wt) != threads.end()) {
+            for (const ServerThread& thread : tree_gossip_children(
+                     threads, wt.gossip_connect_address(), wt)) {
+              tree_keyset_map[thread.gossip_connect_address()].insert(key);
+            }
+          } else if (succeed) {
             for (const ServerThread& thread : threads) {
               if (!(thread == wt)) {
                 addr_keyset_map[thread.gossip_connect_address()].insert(key);
@@ -442,15 +703,63 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
             set<Address>& cache_ips = key_to_cache_ips[key];
             for (const Address& cache_ip : cache_ips) {
               CacheThread ct(cache_ip, 0);
-              addr_keyset_map[ct.cache_update_connect_address()].insert(key);
+              cache_keyset_map[ct.cache_update_connect_address()].insert(key);
             }
           }
         }
 
-        send_gossip(addr_keyset_map, pushers, serializers, stored_key_map);
+        // replicas acknowledge what they receive, so each change is sent once
+        // and only resent if it is not acknowledged
+        map<Address, KeyRequest> gossip_map;
+        prepare_delta_gossip(addr_keyset_map, serializers, stored_key_map,
+                             local_changeset, gossip_map);
+
+        map<Address, KeyRequest> tree_gossip_map;
+        prepare_delta_gossip(tree_keyset_map, serializers, stored_key_map,
+                             local_changeset, tree_gossip_map);
+
+        for (auto& tree_pair : tree_gossip_map) {
+          KeyRequest& request = gossip_map[tree_pair.first];
+          request.set_type(RequestType::PUT);
+
+          for (KeyTuple& tuple : *tree_pair.second.mutable_tuples()) {
+            tuple.set_gossip_root(wt.gossip_connect_address());
+            *request.add_tuples() = std::move(tuple);
+          }
+        }
+        queue_replicated_gossip(gossip_map, replication_streams, wt);
+        gossip_queued = true;
+        send_gossip(cache_keyset_map, pushers, serializers, stored_key_map);
+
+        for (const auto& change_pair : local_changeset) {
+          merkle_changeset.insert(change_pair.first);
+        }
         local_changeset.clear();
       }
 
+      // keys in gossip that was dropped from a full stream are sent whole
+      AddressKeysetMap lost_keyset_map;
+      for (auto& stream_pair : replication_streams) {
+        set<Key> lost_keys = stream_pair.second.take_lost_keys();
+        if (lost_keys.size() > 0) {
+          lost_keyset_map[stream_pair.first] = std::move(lost_keys);
+        }
+      }
+
+      if (lost_keyset_map.size() > 0) {
+        map<Address, KeyRequest> gossip_map;
+        prepare_gossip(lost_keyset_map, serializers, stored_key_map,
+                       gossip_map);
+        queue_replicated_gossip(gossip_map, replication_streams, wt);
+        gossip_queued = true;
+      }
+
+      // gossip that has not been acknowledged in time is sent again, paced
+      // like the rest
+      if (expire_replication_streams(replication_streams)) {
+        gossip_queued = true;
+      }
+
       gossip_start = std::chrono::system_clock::now();
       auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
                               std::chrono::system_clock::now() - work_start)
@@ -460,6 +769,167 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
       working_time_map[8] += time_elapsed;
     }
 
+    // queued gossip is sent a batch per replica at a time, so that a burst of
+    // changes is spread over several iterations instead of stalling both ends
+    if (gossip_queued) {
+      auto work_start = std::chrono::system_clock::now();
+
+      gossip_queued = send_paced_gossip(replication_streams, pushers,
+                                        gossip_codec, gossip_stats);
+
+      auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now() - work_start)
+                              .count();
+      working_time += time_elapsed;
+      working_time_map[8] += time_elapsed;
+    }
+
+    // compare Merkle trees with the other replicas, to repair keys whose
+    // gossip was lost
+    if (std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now() - anti_entropy_start)
+            .count() >= kAntiEntropyPeriod) {
+      auto work_start = std::chrono::system_clock::now();
+
+      // exchanges wait until the keys are in the trees of their replicas
+      if (merkle_relocations.empty()) {
+        update_merkle_trees(seed, global_hash_rings, local_hash_rings,
+                            stored_key_map, key_replication_map, wt,
+                            serializers, pushers, merkle_changeset,
+                            merkle_trees);
+        send_merkle_roots(merkle_trees, wt, pushers);
+      }
+
+      anti_entropy_start = std::chrono::system_clock::now();
+      auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now() - work_start)
+                              .count();
+
+      working_time += time_elapsed;
+      working_time_map[9] += time_elapsed;
+    }
+
+    // move a few keys to the Merkle trees of their current replicas, so that
+    // a membership change is not handled in one go
+    if (!merkle_relocations.empty()) {
+      auto work_start = std::chrono::system_clock::now();
+
+      relocate_merkle_keys(seed, global_hash_rings, local_hash_rings,
+                           stored_key_map, key_replication_map, wt,
+                           serializers, pushers, merkle_relocations,
+                           merkle_trees);
+
+      auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now() - work_start)
+                              .count();
+
+      working_time += time_elapsed;
+      working_time_map[9] += time_elapsed;
+    }
+
+    // resume the GET and SCAN requests whose EBS reads have finished, and
+    // acknowledge the PUTs whose EBS commit is durable
+    if (ebs_log != nullptr) {
+      vector<unsigned> completed;
+      ebs_log->poll(completed);
+
+      for (const unsigned& ticket : completed) {
+        if (suspended_requests.find(ticket) != suspended_requests.end()) {
+          auto work_start = std::chrono::system_clock::now();
+
+          user_request_handler(access_count, seed, suspended_requests[ticket],
+                               log, global_hash_rings, local_hash_rings,
+                               pending_requests, key_access_tracker,
+                               stored_key_map, key_replication_map,
+                               local_changeset, wt, serializers, pushers,
+                               uncommitted_responses);
+
+          ebs_log->release_prefetch(ticket);
+          suspended_requests.erase(ticket);
+
+          auto time_elapsed =
+              std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::system_clock::now() - work_start)
+                  .count();
+          working_time += time_elapsed;
+          working_time_map[3] += time_elapsed;
+        } else if (suspended_scans.find(ticket) != suspended_scans.end()) {
+          auto work_start = std::chrono::system_clock::now();
+
+          const auto& scan = suspended_scans[ticket];
+          scan_request_handler(scan.first, key_index, scan.second,
+                               stored_key_map, serializers, pushers);
+
+          ebs_log->release_prefetch(ticket);
+          suspended_scans.erase(ticket);
+
+          auto time_elapsed =
+              std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::system_clock::now() - work_start)
+                  .count();
+          working_time += time_elapsed;
+          working_time_map[3] += time_elapsed;
+        } else if (committing_responses.find(ticket) !=
+                   committing_responses.end()) {
+          for (const auto& response_pair : committing_responses[ticket]) {
+            for (const string& serialized_response : response_pair.second) {
+              kZmqUtil->send_string(serialized_response,
+                                    &pushers[response_pair.first]);
+            }
+          }
+
+          committing_responses.erase(ticket);
+        }
+      }
+    }
+
+    // commit the EBS writes buffered during the commit window with a single
+    // write and sync in the background; only one commit is in flight at a
+    // time so that PUTs are acknowledged in the order they were logged
+    if (ebs_log != nullptr && !ebs_log->committing() &&
+        (ebs_log->has_uncommitted() || uncommitted_responses.size() > 0) &&
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now() - commit_start)
+                .count() >= commit_window) {
+      vector<Key> committed_keys;
+      ebs_log->uncommitted_keys(committed_keys);
+
+      unsigned ticket = ebs_log->commit_async();
+      committing_responses[ticket] = std::move(uncommitted_responses);
+      uncommitted_responses.clear();
+      commit_start = std::chrono::system_clock::now();
+
+      // once compressed, the committed values may take up less space than the
+      // payloads that were buffered for them
+      for (const Key& key : committed_keys) {
+        if (stored_key_map.find(key) != stored_key_map.end()) {
+          stored_key_map[key].size_ = ebs_log->size(key);
+        }
+      }
+    }
+
+    // reclaim space held by overwritten and deleted values in the EBS log
+    if (ebs_log != nullptr) {
+      auto work_start = std::chrono::system_clock::now();
+      ebs_log->compact();
+
+      auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now() - work_start)
+                              .count();
+      working_time += time_elapsed;
+    }
+
+    // serialize a few more keys into the current snapshot, if one is due
+    if (snapshotter != nullptr) {
+      auto work_start = std::chrono::system_clock::now();
+      snapshotter->advance(serializers, stored_key_map, key_replication_map);
+
+      auto time_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now() - work_start)
+                              .count();
+      working_time += time_elapsed;
+    }
+
     // Collect and store internal statistics,
     // fetch the most recent list of cache IPs,
     // and send out GET requests for the cached keys by cache IP.
@@ -503,6 +973,15 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
       stat.set_epoch(epoch);
       stat.set_access_count(access_count);
 
+      if (value_cache != nullptr) {
+        stat.set_cache_hit_count(value_cache->hit_count());
+        stat.set_cache_miss_count(value_cache->miss_count());
+      }
+
+      stat.set_gossip_bytes(gossip_stats.bytes_);
+      stat.set_gossip_batch_count(gossip_stats.batch_count_);
+      stat.set_max_gossip_batch_bytes(gossip_stats.max_batch_bytes_);
+
       string serialized_stat;
       stat.SerializeToString(&serialized_stat);
 
@@ -654,6 +1133,12 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
       working_time = 0;
       access_count = 0;
       memset(working_time_map, 0, sizeof(working_time_map));
+
+      if (value_cache != nullptr) {
+        value_cache->reset_counts();
+      }
+
+      gossip_stats = GossipStatistics();
     }
 
     // redistribute data after node joins
@@ -696,8 +1181,9 @@ void run(unsigned thread_id, Address public_ip, Address private_ip,
       // remove keys
       if (join_gossip_map.size() == 0) {
         for (const string& key : join_remove_set) {
-          serializers[stored_key_map[key].type_]->remove(key);
+          serializers.at(stored_key_map[key].type_)->remove(key);
           stored_key_map.erase(key);
+          merkle_changeset.insert(key);
         }
       }
     }
@@ -21,8 +21,10 @@ void user_request_handler(
     map<Key, vector<PendingRequest>>& pending_requests,
     map<Key, std::multiset<TimePoint>>& key_access_tracker,
     map<Key, KeyProperty>& stored_key_map,
-    map<Key, KeyReplication>& key_replication_map, set<Key>& local_changeset,
-    ServerThread& wt, SerializerMap& serializers, SocketCache& pushers) {
+    map<Key, KeyReplication>& key_replication_map,
+    map<Key, KeyDelta>& local_changeset, ServerThread& wt,
+    SerializerMap& serializers, SocketCache& pushers,
+    map<Address, vector<string>>& uncommitted_responses) {
   KeyRequest request;
   request.ParseFromString(serialized);
 
@@ -40,6 +42,7 @@ void user_request_handler(
   RequestType request_type = request.type();
   string response_address =
       request.has_response_address() ? request.response_address() : "";
+  bool bulk = request.bulk() && request_type == RequestType::PUT;
 
   for (const auto& tuple : request.tuples()) {
     // first check if the thread is responsible for the key
@@ -53,7 +56,13 @@ void user_request_handler(
 
     if (succeed) {
       if (std::find(threads.begin(), threads.end(), wt) == threads.end()) {
-        if (is_metadata(key)) {
+        if (bulk) {
+          // bulk loads are not parked; the client looks up the responsible
+          // threads again and resends the tuple
+          KeyTuple* tp = response.add_tuples();
+          tp->set_key(key);
+          tp->set_error(2);
+        } else if (is_metadata(key)) {
           log->error("Wrong address for metadata key {}.", key);
           // this means that this node is not responsible for this metadata key
           KeyTuple* tp = response.add_tuples();
@@ -81,14 +90,17 @@ void user_request_handler(
               stored_key_map[key].type_ == LatticeType::NO) {
             tp->set_error(1);
           } else {
-            auto res = process_get(key, serializers[stored_key_map[key].type_]);
+            auto res =
+                process_get(key, serializers.at(stored_key_map[key].type_));
             tp->set_lattice_type(stored_key_map[key].type_);
-            tp->set_payload(res.first);
+            tp->set_payload(std::move(res.first));
             tp->set_error(res.second);
           }
-        } else if (request_type == RequestType::PUT) {
+        } else if (request_type == RequestType::PUT ||
+                   request_type == RequestType::INCREMENT) {
           if (tuple.lattice_type() == LatticeType::NO) {
-            log->error("PUT request missing lattice type.");
+            log->error("{} request missing lattice type.",
+                       RequestType_Name(request_type));
           } else if (stored_key_map.find(key) != stored_key_map.end() &&
                      stored_key_map[key].type_ != LatticeType::NO &&
                      stored_key_map[key].type_ != tuple.lattice_type()) {
@@ -97,11 +109,23 @@ void user_request_handler(
                 "{}.",
                 key, LatticeType_Name(tuple.lattice_type()),
                 LatticeType_Name(stored_key_map[key].type_));
+            tp->set_error(3);
+          } else if (request_type == RequestType::INCREMENT) {
+            if (process_increment(key, tuple.lattice_type(), payload, wt.id(),
+                                  serializers.at(tuple.lattice_type()),
+                                  stored_key_map, local_changeset)) {
+              tp->set_error(0);
+              tp->set_lattice_type(tuple.lattice_type());
+            } else {
+              log->error("Invalid INCREMENT of {} key {}.",
+                         LatticeType_Name(tuple.lattice_type()), key);
+              tp->set_error(3);
+            }
           } else {
             process_put(key, tuple.lattice_type(), payload,
-                        serializers[tuple.lattice_type()], stored_key_map);
+                        serializers.at(tuple.lattice_type()), stored_key_map);
+            track_delta(local_changeset[key], std::move(payload));
 
-            local_changeset.insert(key);
             tp->set_error(0);
             tp->set_lattice_type(tuple.lattice_type());
           }
@@ -116,9 +140,23 @@ void user_request_handler(
           tp->set_invalidate(true);
         }
 
-        key_access_tracker[key].insert(std::chrono::system_clock::now());
         access_count += 1;
+
+        if (bulk) {
+          // only the tuples that were not applied are reported back
+          if (tp->error() == 0 && !tp->invalidate()) {
+            response.mutable_tuples()->RemoveLast();
+          }
+        } else {
+          key_access_tracker[key].insert(std::chrono::system_clock::now());
+        }
       }
+    } else if (bulk) {
+      // the replication factor of the key has been requested, so the client
+      // can retry the tuple shortly
+      KeyTuple* tp = response.add_tuples();
+      tp->set_key(key);
+      tp->set_error(2);
     } else {
       pending_requests[key].push_back(
           PendingRequest(request_type, tuple.lattice_type(), payload,
@@ -126,10 +164,17 @@ void user_request_handler(
     }
   }
 
-  if (response.tuples_size() > 0 && request.has_response_address()) {
-    string serialized_response;
-    response.SerializeToString(&serialized_response);
-    kZmqUtil->send_string(serialized_response,
-                          &pushers[request.response_address()]);
+  if ((response.tuples_size() > 0 || bulk) && request.has_response_address()) {
+    // EBS writes are acknowledged once they have been committed
+    if ((request_type == RequestType::PUT ||
+         request_type == RequestType::INCREMENT) &&
+        kSelfTierId == kEbsTierId) {
+      string serialized_response;
+      response.SerializeToString(&serialized_response);
+      uncommitted_responses[request.response_address()].push_back(
+          std::move(serialized_response));
+    } else {
+      send_request<KeyResponse>(response, pushers[request.response_address()]);
+    }
   }
 }
@@ -14,11 +14,10 @@
 
 #include "kvs/kvs_handlers.hpp"
 
-void send_gossip(AddressKeysetMap& addr_keyset_map, SocketCache& pushers,
-                 SerializerMap& serializers,
-                 map<Key, KeyProperty>& stored_key_map) {
-  map<Address, KeyRequest> gossip_map;
-
+void prepare_gossip(AddressKeysetMap& addr_keyset_map,
+                    SerializerMap& serializers,
+                    map<Key, KeyProperty>& stored_key_map,
+                    map<Address, KeyRequest>& gossip_map) {
   for (const auto& key_pair : addr_keyset_map) {
     string address = key_pair.first;
     RequestType type;
@@ -34,19 +33,316 @@ void send_gossip(AddressKeysetMap& addr_keyset_map, SocketCache& pushers,
         type = stored_key_map[key].type_;
       }
 
-      auto res = process_get(key, serializers[type]);
+      unsigned error = 0;
+      string payload = serializers.at(type)->read(key, error);
+
+      if (error == 0) {
+        prepare_put_tuple(gossip_map[address], key, type, payload);
+      }
+    }
+  }
+}
+
+void send_gossip(AddressKeysetMap& addr_keyset_map, SocketCache& pushers,
+                 SerializerMap& serializers,
+                 map<Key, KeyProperty>& stored_key_map) {
+  map<Address, KeyRequest> gossip_map;
+  prepare_gossip(addr_keyset_map, serializers, stored_key_map, gossip_map);
+
+  // send gossip, in batches of bounded size
+  for (auto& gossip_pair : gossip_map) {
+    for (const KeyRequest& batch : split_gossip(gossip_pair.second)) {
+      string serialized;
+      batch.SerializeToString(&serialized);
+      kZmqUtil->send_string(serialized, &pushers[gossip_pair.first]);
+    }
+  }
+}
+
+void prepare_delta_gossip(AddressKeysetMap& addr_keyset_map,
+                          SerializerMap& serializers,
+                          map<Key, KeyProperty>& stored_key_map,
+                          const map<Key, KeyDelta>& local_changeset,
+                          map<Address, KeyRequest>& gossip_map) {
+  // every replica of a key is sent the same payload, so it is only built once
+  map<Key, string> payloads;
+
+  for (const auto& key_pair : addr_keyset_map) {
+    const Address& address = key_pair.first;
+    gossip_map[address].set_type(RequestType::PUT);
+
+    for (const auto& key : key_pair.second) {
+      auto it = stored_key_map.find(key);
+      if (it == stored_key_map.end()) {
+        // we don't have this key stored, so skip
+        continue;
+      }
+
+      const KeyProperty& property = it->second;
+      auto payload_it = payloads.find(key);
+
+      if (payload_it == payloads.end()) {
+        string payload;
+        auto delta_it = local_changeset.find(key);
+        if (delta_it == local_changeset.end() || delta_it->second.full_ ||
+            delta_it->second.payloads_.size() == 0) {
+          unsigned error = 0;
+          payload = serializers.at(property.type_)->read(key, error);
+          if (error != 0) {
+            continue;
+          }
+        } else {
+          payload = merge_payloads(property.type_, delta_it->second.payloads_);
+        }
+
+        payload_it = payloads.emplace(key, std::move(payload)).first;
+      }
+
+      prepare_put_tuple(gossip_map[address], key, property.type_,
+                        payload_it->second);
+    }
+  }
+}
+
+void queue_replicated_gossip(map<Address, KeyRequest>& gossip_map,
+                             map<Address, ReplicationStream>& streams,
+                             ServerThread& wt) {
+  unsigned long long now = get_time();
+
+  for (auto& gossip_pair : gossip_map) {
+    if (gossip_pair.second.tuples_size() == 0) {
+      continue;
+    }
+
+    streams[gossip_pair.first].append(std::move(gossip_pair.second),
+                                      wt.replication_ack_connect_address(),
+                                      now);
+  }
+}
+
+bool send_paced_gossip(map<Address, ReplicationStream>& streams,
+                       SocketCache& pushers, const Codec* codec,
+                       GossipStatistics& stats) {
+  unsigned long long now = get_time();
+  bool due = false;
+
+  for (auto& stream_pair : streams) {
+    string serialized = stream_pair.second.send(now, codec);
+    if (serialized.size() > 0) {
+      stats.record(serialized.size());
+      kZmqUtil->send_string(serialized, &pushers[stream_pair.first]);
+    }
+
+    due = due || stream_pair.second.has_due(now);
+  }
+
+  return due;
+}
+
+bool expire_replication_streams(map<Address, ReplicationStream>& streams) {
+  unsigned long long now = get_time();
+  bool due = false;
+
+  for (auto it = streams.begin(); it != streams.end();) {
+    if (it->second.stalled(now)) {
+      it = streams.erase(it);
+      continue;
+    }
+
+    due = due || it->second.has_due(now);
+    it++;
+  }
+
+  return due;
+}
+
+void track_delta(KeyDelta& delta, string payload) {
+  if (delta.full_) {
+    return;
+  }
+
+  if (delta.bytes_ + payload.size() > kMaxGossipDeltaBytes) {
+    vector<string>().swap(delta.payloads_);
+    delta.bytes_ = 0;
+    delta.full_ = true;
+    return;
+  }
+
+  delta.bytes_ += payload.size();
+  delta.payloads_.push_back(std::move(payload));
+}
+
+string merge_payloads(LatticeType lattice_type,
+                      const vector<string>& payloads) {
+  if (payloads.size() == 1) {
+    return payloads[0];
+  }
+
+  // built once and only read afterwards, so it is shared by all threads
+  static const LatticeTypeMap<PayloadMerger> mergers = [] {
+    LatticeTypeMap<PayloadMerger> result;
+    PayloadMergerRegistrar registrar{result};
+    register_lattice_types(registrar);
+    return result;
+  }();
+
+  return mergers.at(lattice_type)(payloads);
+}
+
+unsigned long long get_key_digest(const Key& key,
+                                  const KeyProperty& property,
+                                  SerializerMap& serializers) {
+  unsigned error = 0;
+  string payload = serializers.at(property.type_)->read(key, error);
+  if (error != 0) {
+    payload = "";
+  }
+
+  return key_digest(key, payload);
+}
+
+// puts a stored key in this thread's trees for its other current replicas and
+// takes it out of the rest. The key's digest is reused from a tree that has it
+// unless its value has changed, so that keys whose replicas merely moved are
+// not read again.
+static void place_merkle_key(unsigned& seed,
+                             map<TierId, GlobalHashRing>& global_hash_rings,
+                             map<TierId, LocalHashRing>& local_hash_rings,
+                             const Key& key, const KeyProperty& property,
+                             bool changed,
+                             map<Key, KeyReplication>& key_replication_map,
+                             ServerThread& wt, SerializerMap& serializers,
+                             SocketCache& pushers,
+                             map<Address, MerkleTree>& merkle_trees) {
+  bool succeed;
+  ServerThreadList threads = kHashRingUtil->get_responsible_threads(
+      wt.replication_response_connect_address(), key, is_metadata(key),
+      global_hash_rings, local_hash_rings, key_replication_map, pushers,
+      kAllTierIds, succeed, seed);
+
+  set<Address> replicas;
+  if (succeed) {
+    for (const ServerThread& thread : threads) {
+      if (!(thread == wt)) {
+        replicas.insert(thread.anti_entropy_connect_address());
+      }
+    }
+  }
+
+  unsigned long long digest = 0;
+  bool digested = false;
+
+  for (auto& tree_pair : merkle_trees) {
+    unsigned long long tree_digest;
+    if (!tree_pair.second.find(key, tree_digest)) {
+      continue;
+    }
+
+    if (!changed) {
+      digest = tree_digest;
+      digested = true;
+    }
+
+    if (replicas.find(tree_pair.first) == replicas.end()) {
+      tree_pair.second.remove(key);
+    }
+  }
+
+  for (const Address& replica : replicas) {
+    MerkleTree& tree = merkle_trees[replica];
+
+    unsigned long long tree_digest;
+    if (!changed && tree.find(key, tree_digest)) {
+      continue;
+    }
+
+    if (!digested) {
+      digest = get_key_digest(key, property, serializers);
+      digested = true;
+    }
 
-      if (res.second == 0) {
-        prepare_put_tuple(gossip_map[address], key, type, res.first);
+    tree.add(key, digest);
+  }
+}
+
+// drops the trees of replicas this thread no longer shares any keys with
+static void drop_empty_merkle_trees(map<Address, MerkleTree>& merkle_trees) {
+  for (auto it = merkle_trees.begin(); it != merkle_trees.end();) {
+    if (it->second.empty()) {
+      it = merkle_trees.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void update_merkle_trees(unsigned& seed,
+                         map<TierId, GlobalHashRing>& global_hash_rings,
+                         map<TierId, LocalHashRing>& local_hash_rings,
+                         map<Key, KeyProperty>& stored_key_map,
+                         map<Key, KeyReplication>& key_replication_map,
+                         ServerThread& wt, SerializerMap& serializers,
+                         SocketCache& pushers, set<Key>& merkle_changeset,
+                         map<Address, MerkleTree>& merkle_trees) {
+  for (const Key& key : merkle_changeset) {
+    auto key_it = stored_key_map.find(key);
+    if (key_it == stored_key_map.end()) {
+      for (auto& tree_pair : merkle_trees) {
+        tree_pair.second.remove(key);
       }
+      continue;
     }
+
+    place_merkle_key(seed, global_hash_rings, local_hash_rings, key,
+                     key_it->second, true, key_replication_map, wt,
+                     serializers, pushers, merkle_trees);
   }
 
-  // send gossip
-  for (const auto& gossip_pair : gossip_map) {
+  merkle_changeset.clear();
+  drop_empty_merkle_trees(merkle_trees);
+}
+
+void relocate_merkle_keys(unsigned& seed,
+                          map<TierId, GlobalHashRing>& global_hash_rings,
+                          map<TierId, LocalHashRing>& local_hash_rings,
+                          map<Key, KeyProperty>& stored_key_map,
+                          map<Key, KeyReplication>& key_replication_map,
+                          ServerThread& wt, SerializerMap& serializers,
+                          SocketCache& pushers,
+                          std::deque<Key>& merkle_relocations,
+                          map<Address, MerkleTree>& merkle_trees) {
+  for (unsigned i = 0;
+       i < kMerkleRelocationBatch && !merkle_relocations.empty(); i++) {
+    Key key = std::move(merkle_relocations.front());
+    merkle_relocations.pop_front();
+
+    // keys removed since are taken out of the trees through the changeset
+    auto key_it = stored_key_map.find(key);
+    if (key_it != stored_key_map.end()) {
+      place_merkle_key(seed, global_hash_rings, local_hash_rings, key,
+                       key_it->second, false, key_replication_map, wt,
+                       serializers, pushers, merkle_trees);
+    }
+  }
+
+  if (merkle_relocations.empty()) {
+    drop_empty_merkle_trees(merkle_trees);
+  }
+}
+
+void send_merkle_roots(const map<Address, MerkleTree>& merkle_trees,
+                       ServerThread& wt, SocketCache& pushers) {
+  for (const auto& tree_pair : merkle_trees) {
+    MerkleDigest digest;
+    digest.set_address(wt.anti_entropy_connect_address());
+    digest.set_gossip_address(wt.gossip_connect_address());
+    digest.set_level(0);
+    digest.add_nodes(0);
+    digest.add_hashes(tree_pair.second.hash(0, 0));
+
     string serialized;
-    gossip_pair.second.SerializeToString(&serialized);
-    kZmqUtil->send_string(serialized, &pushers[gossip_pair.first]);
+    digest.SerializeToString(&serialized);
+    kZmqUtil->send_string(serialized, &pushers[tree_pair.first]);
   }
 }
 
@@ -62,6 +358,87 @@ void process_put(const Key& key, LatticeType lattice_type,
                  map<Key, KeyProperty>& stored_key_map) {
   stored_key_map[key].size_ = serializer->put(key, payload);
   stored_key_map[key].type_ = std::move(lattice_type);
+  stored_key_map[key].modified_ = get_time();
+}
+
+bool process_increment(const Key& key, LatticeType lattice_type,
+                       const string& payload, const string& replica,
+                       Serializer* serializer,
+                       map<Key, KeyProperty>& stored_key_map,
+                       map<Key, KeyDelta>& local_changeset) {
+  CounterIncrement increment;
+  if (!increment.ParseFromString(payload)) {
+    return false;
+  }
+
+  // the replica's count is read back so that the delta carries its new total;
+  // counts are merged by taking the larger one, so the delta can be gossiped
+  // and replayed like any other value; this is not a read by a user, so it is
+  // kept out of the cache
+  unsigned err_number = 0;
+  string current = serializer->read(key, err_number);
+  string delta;
+
+  if (lattice_type == LatticeType::GCOUNTER) {
+    if (increment.amount() < 0) {
+      return false;
+    }
+
+    GCounterLattice counter = deserialize_gcounter(current).local(replica);
+    counter.increment(replica, increment.amount());
+    delta = serialize(counter);
+  } else if (lattice_type == LatticeType::PNCOUNTER) {
+    PNCounterLattice counter = deserialize_pncounter(current).local(replica);
+    counter.increment(replica, increment.amount());
+    delta = serialize(counter);
+  } else {
+    return false;
+  }
+
+  process_put(key, lattice_type, delta, serializer, stored_key_map);
+  track_delta(local_changeset[key], std::move(delta));
+  return true;
+}
+
+ServerThreadList tree_gossip_children(ServerThreadList threads,
+                                      const Address& root,
+                                      const ServerThread& wt) {
+  // every replica has to lay out the tree the same way
+  std::sort(threads.begin(), threads.end(),
+            [](const ServerThread& l, const ServerThread& r) {
+              return l.id() < r.id();
+            });
+
+  unsigned count = threads.size();
+  unsigned root_index = count;
+  unsigned self_index = count;
+
+  for (unsigned i = 0; i < count; i++) {
+    if (threads[i].gossip_connect_address() == root) {
+      root_index = i;
+    }
+
+    if (threads[i] == wt) {
+      self_index = i;
+    }
+  }
+
+  ServerThreadList children;
+  if (root_index == count || self_index == count) {
+    return children;
+  }
+
+  // the tree is laid out over the replicas starting from the root, with the
+  // children of the replica at position p at p * fanout + 1 onwards
+  unsigned position = (self_index + count - root_index) % count;
+  for (unsigned i = 1; i <= kTreeGossipFanout; i++) {
+    unsigned child = position * kTreeGossipFanout + i;
+    if (child < count) {
+      children.push_back(threads[(root_index + child) % count]);
+    }
+  }
+
+  return children;
 }
 
 bool is_primary_replica(const Key& key,
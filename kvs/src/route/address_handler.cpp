@@ -33,8 +33,32 @@ void address_handler(logger log, string& serialized, SocketCache& pushers,
     num_servers += pair.second.size();
   }
 
+  // lookups for many keys at once (e.g., for bulk loads) are answered right
+  // away with whichever keys we know the replication factors of; the others
+  // are left out, and the client asks again once we have fetched them
+  bool batch = addr_request.keys_size() > 1;
+
   bool respond = false;
-  if (num_servers == 0) {
+  if (addr_request.all_threads()) {
+    // SCANs are sent to every server thread, since keys are partitioned by
+    // hash rather than by range
+    addr_response.set_error(num_servers == 0 ? 1 : 0);
+    KeyAddressResponse_KeyAddress* tp = addr_response.add_addresses();
+    tp->set_key("");
+
+    for (const auto& pair : global_hash_rings) {
+      for (const ServerThread& server : pair.second.get_unique_servers()) {
+        for (const ServerThread& thread :
+             local_hash_rings[pair.first].get_unique_servers()) {
+          tp->add_ips(ServerThread(server.public_ip(), server.private_ip(),
+                                   thread.tid())
+                          .key_request_connect_address());
+        }
+      }
+    }
+
+    respond = true;
+  } else if (num_servers == 0) {
     addr_response.set_error(1);
 
     for (const Key& key : addr_request.keys()) {
@@ -56,6 +80,10 @@ void address_handler(logger log, string& serialized, SocketCache& pushers,
 
         if (!succeed) {  // this means we don't have the replication factor for
                          // the key
+          if (batch) {
+            break;
+          }
+
           pending_requests[key].push_back(std::pair<Address, string>(
               addr_request.response_address(), addr_request.request_id()));
           return;
@@ -64,11 +92,16 @@ void address_handler(logger log, string& serialized, SocketCache& pushers,
         tier_id++;
       }
 
-      KeyAddressResponse_KeyAddress* tp = addr_response.add_addresses();
-      tp->set_key(key);
       respond = true;
       addr_response.set_error(0);
 
+      if (!succeed) {
+        continue;
+      }
+
+      KeyAddressResponse_KeyAddress* tp = addr_response.add_addresses();
+      tp->set_key(key);
+
       for (const ServerThread& thread : threads) {
         tp->add_ips(thread.key_request_connect_address());
       }
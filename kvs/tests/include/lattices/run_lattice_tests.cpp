@@ -18,10 +18,13 @@
 #include <iostream>
 
 #include "test_bool_lattice.hpp"
+#include "test_counter_lattice.hpp"
 #include "test_map_lattice.hpp"
 #include "test_max_lattice.hpp"
 #include "test_ordered_set_lattice.hpp"
 #include "test_set_lattice.hpp"
+#include "test_sorted_set_lattice.hpp"
+#include "test_vector_clock.hpp"
 
 int main(int argc, char *argv[]) {
   testing::InitGoogleTest(&argc, argv);
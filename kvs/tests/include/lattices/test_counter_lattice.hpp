@@ -0,0 +1,82 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+
+#include "gtest/gtest.h"
+#include "lattices/counter_lattice.hpp"
+
+class CounterLatticeTest : public ::testing::Test {
+ protected:
+  GCounterLattice gc1;
+  GCounterLattice gc2;
+
+  CounterLatticeTest() {
+    gc1.increment("n1", 3);
+    gc1.increment("n2", 2);
+    gc2.increment("n2", 5);
+    gc2.increment("n3", 1);
+  }
+};
+
+TEST_F(CounterLatticeTest, Increment) {
+  EXPECT_EQ(5, gc1.value());
+  gc1.increment("n1", 4);
+  EXPECT_EQ(7, gc1.count("n1"));
+  EXPECT_EQ(9, gc1.value());
+  EXPECT_EQ(2, gc1.size().reveal());
+  EXPECT_EQ(0, gc1.count("n3"));
+}
+
+TEST_F(CounterLatticeTest, Merge) {
+  gc1.merge(gc2);
+  EXPECT_EQ(3, gc1.size().reveal());
+  EXPECT_EQ(3, gc1.count("n1"));
+  EXPECT_EQ(5, gc1.count("n2"));
+  EXPECT_EQ(1, gc1.count("n3"));
+  EXPECT_EQ(9, gc1.value());
+
+  // merging is idempotent, so replayed deltas are not counted twice
+  gc1.merge(gc2);
+  EXPECT_EQ(9, gc1.value());
+}
+
+TEST_F(CounterLatticeTest, Local) {
+  GCounterLattice local = gc1.local("n2");
+  EXPECT_EQ(1, local.size().reveal());
+  EXPECT_EQ(2, local.value());
+  EXPECT_EQ(0, gc1.local("n3").size().reveal());
+}
+
+TEST_F(CounterLatticeTest, PNCounter) {
+  PNCounterLattice pn1;
+  PNCounterLattice pn2;
+  pn1.increment("n1", 5);
+  pn1.increment("n1", -7);
+  pn2.increment("n2", -1);
+  EXPECT_EQ(-2, pn1.value());
+
+  pn1.merge(pn2);
+  EXPECT_EQ(-3, pn1.value());
+  EXPECT_EQ(3, pn1.size().reveal());
+
+  // each node's increments and decrements are carried over by its part
+  PNCounterLattice pn3 = pn1.local("n1");
+  pn3.increment("n1", 1);
+  pn2.merge(pn3);
+  EXPECT_EQ(-2, pn2.value());
+}
@@ -64,6 +64,26 @@ TEST_F(MapLatticeTest, MergeByLattice) {
   check_equality(map3);
 }
 
+TEST_F(MapLatticeTest, MergeByMove) {
+  charMaxIntMap m1 = map1;
+  mapl->merge(std::move(m1));
+  check_equality(map1);
+  charMaxIntMap m2 = map2;
+  mapl->merge(std::move(m2));
+  check_equality(map3);
+}
+
+TEST_F(MapLatticeTest, InsertByMove) {
+  MapLattice<string, SetLattice<string>> sets;
+  string key = "key";
+  string value(100, 'a');
+
+  sets.insert(std::move(key), SetLattice<string>(set<string>({value})));
+  sets.insert("key", SetLattice<string>(set<string>({"b"})));
+  EXPECT_EQ(1, sets.size().reveal());
+  EXPECT_EQ(set<string>({value, "b"}), sets.at("key").reveal());
+}
+
 TEST_F(MapLatticeTest, KeySet) {
   mapl->merge(map1);
   SetLattice<char> res = mapl->key_set();
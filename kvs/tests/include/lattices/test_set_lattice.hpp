@@ -64,3 +64,18 @@ TEST_F(SetLatticeTest, Intersection) {
   SetLattice<char> res = sl->intersect(set2);
   EXPECT_EQ(set<char>({'c'}), res.reveal());
 }
+
+TEST_F(SetLatticeTest, MergeByMove) {
+  set<char> small = {'a'};
+  sl->merge(std::move(small));
+  EXPECT_EQ(set<char>({'a'}), sl->reveal());
+
+  // the larger set is kept, and the smaller one merged into it
+  set<char> large = set3;
+  sl->merge(std::move(large));
+  EXPECT_EQ(5, sl->size().reveal());
+  EXPECT_EQ(set3, sl->reveal());
+
+  sl->merge(SetLattice<char>(set<char>({'f'})));
+  EXPECT_EQ(6, sl->size().reveal());
+}
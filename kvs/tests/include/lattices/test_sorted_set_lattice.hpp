@@ -0,0 +1,88 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+
+#include "gtest/gtest.h"
+#include "lattices/core_lattices.hpp"
+
+class SortedSetLatticeTest : public ::testing::Test {
+ protected:
+  SortedSetLattice<char>* sl;
+  vector<char> set1 = {'a', 'b', 'c'};
+  vector<char> set2 = {'c', 'd', 'e'};
+  vector<char> set3 = {'a', 'b', 'c', 'd', 'e'};
+  SortedSetLatticeTest() { sl = new SortedSetLattice<char>; }
+  virtual ~SortedSetLatticeTest() { delete sl; }
+};
+
+TEST_F(SortedSetLatticeTest, Construct) {
+  SortedSetLattice<char> unsorted(vector<char>({'c', 'a', 'b', 'a', 'c'}));
+  EXPECT_EQ(3, unsorted.size().reveal());
+  EXPECT_EQ(set1, unsorted.reveal());
+}
+
+TEST_F(SortedSetLatticeTest, MergeByValue) {
+  EXPECT_EQ(0, sl->size().reveal());
+  sl->merge(set1);
+  EXPECT_EQ(3, sl->size().reveal());
+  EXPECT_EQ(set1, sl->reveal());
+  sl->merge(set2);
+  EXPECT_EQ(5, sl->size().reveal());
+  EXPECT_EQ(set3, sl->reveal());
+}
+
+TEST_F(SortedSetLatticeTest, MergeByLattice) {
+  sl->merge(SortedSetLattice<char>(set2));
+  sl->merge(SortedSetLattice<char>(set1));
+  EXPECT_EQ(set3, sl->reveal());
+}
+
+TEST_F(SortedSetLatticeTest, MergeUnsorted) {
+  sl->merge(set1);
+  sl->merge(vector<char>({'e', 'a', 'd', 'e'}));
+  EXPECT_EQ(set3, sl->reveal());
+
+  vector<char> unsorted = {'f', 'c'};
+  sl->merge(static_cast<const vector<char>&>(unsorted));
+  EXPECT_EQ(6, sl->size().reveal());
+  EXPECT_EQ('f', sl->reveal().back());
+}
+
+TEST_F(SortedSetLatticeTest, Insert) {
+  sl->insert('c');
+  sl->insert('a');
+  sl->insert('c');
+  sl->insert('b');
+  EXPECT_EQ(set1, sl->reveal());
+  EXPECT_TRUE(sl->contains('b'));
+  EXPECT_FALSE(sl->contains('d'));
+}
+
+TEST_F(SortedSetLatticeTest, Intersection) {
+  sl->merge(set1);
+  SortedSetLattice<char> res = sl->intersect(SortedSetLattice<char>(set2));
+  EXPECT_EQ(vector<char>({'c'}), res.reveal());
+}
+
+bool is_vowel(char c) { return c == 'a' || c == 'e'; }
+
+TEST_F(SortedSetLatticeTest, Projection) {
+  sl->merge(set3);
+  SortedSetLattice<char> res = sl->project(is_vowel);
+  EXPECT_EQ(vector<char>({'a', 'e'}), res.reveal());
+}
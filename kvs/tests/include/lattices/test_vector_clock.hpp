@@ -0,0 +1,84 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+
+#include "gtest/gtest.h"
+#include "lattices/vector_clock.hpp"
+
+class VectorClockTest : public ::testing::Test {
+ protected:
+  VectorClock vc1;
+  VectorClock vc2;
+
+  VectorClockTest() {
+    vc1.insert("c1", 1);
+    vc1.insert("c2", 2);
+    vc2.insert("c2", 1);
+    vc2.insert("c3", 3);
+  }
+
+  unsigned version(const VectorClock& vc, const string& node) {
+    for (const auto& entry : vc.reveal()) {
+      if (NodeIds::name(entry.first) == node) {
+        return entry.second;
+      }
+    }
+    return 0;
+  }
+};
+
+TEST_F(VectorClockTest, Insert) {
+  EXPECT_EQ(2, vc1.size().reveal());
+  vc1.insert("c1", 0);
+  EXPECT_EQ(1, version(vc1, "c1"));
+  vc1.insert("c1", 5);
+  EXPECT_EQ(5, version(vc1, "c1"));
+  EXPECT_EQ(2, vc1.size().reveal());
+}
+
+TEST_F(VectorClockTest, Merge) {
+  vc1.merge(vc2);
+  EXPECT_EQ(3, vc1.size().reveal());
+  EXPECT_EQ(1, version(vc1, "c1"));
+  EXPECT_EQ(2, version(vc1, "c2"));
+  EXPECT_EQ(3, version(vc1, "c3"));
+
+  VectorClock inserted;
+  inserted.insert("c3", 3);
+  inserted.insert("c2", 2);
+  inserted.insert("c1", 1);
+  EXPECT_TRUE(vc1 == inserted);
+}
+
+TEST_F(VectorClockTest, Dominates) {
+  EXPECT_FALSE(vc1.dominates(vc2));
+  EXPECT_FALSE(vc2.dominates(vc1));
+  EXPECT_TRUE(vc1.dominates(VectorClock()));
+
+  VectorClock merged = vc1;
+  merged.merge(vc2);
+  EXPECT_TRUE(merged.dominates(vc1));
+  EXPECT_TRUE(merged.dominates(vc2));
+  EXPECT_TRUE(merged.dominates(merged));
+  EXPECT_FALSE(vc1.dominates(merged));
+
+  // a node missing from a clock is not the same as version 0
+  VectorClock zero;
+  zero.insert("c4", 0);
+  EXPECT_FALSE(merged.dominates(zero));
+}
@@ -25,10 +25,20 @@
 #include "types.hpp"
 
 #include "server_handler_base.hpp"
+#include "test_anti_entropy_handler.hpp"
+#include "test_ebs_log.hpp"
+#include "test_flat_kv_store.hpp"
+#include "test_gossip_tree.hpp"
+#include "test_key_index.hpp"
+#include "test_lattice_type_map.hpp"
+#include "test_merkle_tree.hpp"
 #include "test_node_depart_handler.hpp"
 #include "test_node_join_handler.hpp"
+#include "test_replication_stream.hpp"
 #include "test_self_depart_handler.hpp"
+#include "test_snapshot.hpp"
 #include "test_user_request_handler.hpp"
+#include "test_value_cache.hpp"
 
 unsigned kDefaultLocalReplication = 1;
 unsigned kSelfTierId = kMemoryTierId;
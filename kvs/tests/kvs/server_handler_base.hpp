@@ -36,7 +36,10 @@ class ServerHandlerTest : public ::testing::Test {
   map<Key, vector<PendingRequest>> pending_requests;
   map<Key, vector<PendingGossip>> pending_gossip;
   map<Key, std::multiset<TimePoint>> key_access_tracker;
-  set<Key> local_changeset;
+  map<Key, KeyDelta> local_changeset;
+  set<Key> merkle_changeset;
+  map<Address, vector<string>> uncommitted_responses;
+  map<Address, ReplicationStream> replication_streams;
 
   zmq::context_t context;
   SocketCache pushers = SocketCache(&context, ZMQ_PUSH);
@@ -45,10 +48,12 @@ class ServerHandlerTest : public ::testing::Test {
   Serializer* set_serializer;
   Serializer* ordered_set_serializer;
   Serializer* causal_serializer;
+  Serializer* pn_counter_serializer;
   MemoryLWWKVS* lww_kvs;
   MemorySetKVS* set_kvs;
   MemoryOrderedSetKVS* ordered_set_kvs;
   MemoryCausalKVS* causal_kvs;
+  MemoryPNCounterKVS* pn_counter_kvs;
 
   ServerHandlerTest() {
     lww_kvs = new MemoryLWWKVS();
@@ -59,10 +64,13 @@ class ServerHandlerTest : public ::testing::Test {
     ordered_set_serializer = new MemoryOrderedSetSerializer(ordered_set_kvs);
     causal_kvs = new MemoryCausalKVS();
     causal_serializer = new MemoryCausalSerializer(causal_kvs);
-    serializers[LatticeType::LWW] = lww_serializer;
-    serializers[LatticeType::SET] = set_serializer;
-    serializers[LatticeType::ORDERED_SET] = ordered_set_serializer;
-    serializers[LatticeType::CAUSAL] = causal_serializer;
+    pn_counter_kvs = new MemoryPNCounterKVS();
+    pn_counter_serializer = new MemoryPNCounterSerializer(pn_counter_kvs);
+    serializers.set(LatticeType::LWW, lww_serializer);
+    serializers.set(LatticeType::SET, set_serializer);
+    serializers.set(LatticeType::ORDERED_SET, ordered_set_serializer);
+    serializers.set(LatticeType::CAUSAL, causal_serializer);
+    serializers.set(LatticeType::PNCOUNTER, pn_counter_serializer);
 
     wt = ServerThread(ip, ip, thread_id);
     global_hash_rings[kMemoryTierId].insert(ip, ip, 0, thread_id);
@@ -72,9 +80,11 @@ class ServerHandlerTest : public ::testing::Test {
     delete lww_kvs;
     delete set_kvs;
     delete ordered_set_kvs;
-    delete serializers[LatticeType::LWW];
-    delete serializers[LatticeType::SET];
-    delete serializers[LatticeType::ORDERED_SET];
+    delete pn_counter_kvs;
+    delete serializers.at(LatticeType::LWW);
+    delete serializers.at(LatticeType::SET);
+    delete serializers.at(LatticeType::ORDERED_SET);
+    delete serializers.at(LatticeType::PNCOUNTER);
   }
 
  public:
@@ -127,4 +137,22 @@ class ServerHandlerTest : public ::testing::Test {
 
     return request_str;
   }
+
+  string increment_key_request(Key key, LatticeType lattice_type,
+                               long long amount, string ip) {
+    KeyRequest request;
+    request.set_type(RequestType::INCREMENT);
+    request.set_response_address(UserThread(ip, 0).response_connect_address());
+    request.set_request_id(kRequestId);
+
+    KeyTuple* tp = request.add_tuples();
+    tp->set_key(std::move(key));
+    tp->set_lattice_type(std::move(lattice_type));
+    tp->set_payload(serialize_increment(amount));
+
+    string request_str;
+    request.SerializeToString(&request_str);
+
+    return request_str;
+  }
 };
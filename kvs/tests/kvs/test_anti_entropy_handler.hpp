@@ -0,0 +1,220 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "kvs/kvs_handlers.hpp"
+
+ServerThread anti_entropy_peer("127.0.0.2", "127.0.0.2", 0);
+
+string merkle_digest(unsigned level, vector<unsigned> nodes,
+                     vector<unsigned long long> hashes, bool fetch = false) {
+  MerkleDigest digest;
+  digest.set_address(anti_entropy_peer.anti_entropy_connect_address());
+  digest.set_gossip_address(anti_entropy_peer.gossip_connect_address());
+  digest.set_level(level);
+  digest.set_fetch(fetch);
+
+  for (unsigned i = 0; i < nodes.size(); i++) {
+    digest.add_nodes(nodes[i]);
+    digest.add_hashes(hashes[i]);
+  }
+
+  string serialized;
+  digest.SerializeToString(&serialized);
+  return serialized;
+}
+
+TEST_F(ServerHandlerTest, AntiEntropyMatchingRoot) {
+  Key key = "key";
+  process_put(key, LatticeType::LWW, serialize(1, "value"), lww_serializer,
+              stored_key_map);
+
+  map<Address, MerkleTree> merkle_trees;
+  MerkleTree& tree =
+      merkle_trees[anti_entropy_peer.anti_entropy_connect_address()];
+  tree.add(key, get_key_digest(key, stored_key_map[key], serializers));
+
+  string serialized = merkle_digest(0, {0}, {tree.hash(0, 0)});
+  anti_entropy_handler(serialized, merkle_trees, stored_key_map, wt,
+                       serializers, pushers);
+
+  EXPECT_EQ(get_zmq_messages().size(), 0);
+}
+
+TEST_F(ServerHandlerTest, AntiEntropyDescend) {
+  Key key = "key";
+  process_put(key, LatticeType::LWW, serialize(1, "value"), lww_serializer,
+              stored_key_map);
+
+  map<Address, MerkleTree> merkle_trees;
+  MerkleTree& tree =
+      merkle_trees[anti_entropy_peer.anti_entropy_connect_address()];
+  tree.add(key, get_key_digest(key, stored_key_map[key], serializers));
+
+  // the peer does not have the key
+  string serialized = merkle_digest(0, {0}, {0});
+  anti_entropy_handler(serialized, merkle_trees, stored_key_map, wt,
+                       serializers, pushers);
+
+  vector<string> messages = get_zmq_messages();
+  EXPECT_EQ(messages.size(), 1);
+
+  MerkleDigest reply;
+  reply.ParseFromString(messages[0]);
+  EXPECT_EQ(reply.address(), wt.anti_entropy_connect_address());
+  EXPECT_EQ(reply.level(), 1);
+  EXPECT_FALSE(reply.fetch());
+  EXPECT_EQ(reply.nodes_size(), kMerkleFanout);
+
+  for (int i = 0; i < reply.nodes_size(); i++) {
+    EXPECT_EQ(reply.nodes(i), i);
+    EXPECT_EQ(reply.hashes(i), tree.hash(1, i));
+  }
+}
+
+TEST_F(ServerHandlerTest, AntiEntropyDifferingLeaf) {
+  Key key = "key";
+  process_put(key, LatticeType::LWW, serialize(1, "value"), lww_serializer,
+              stored_key_map);
+
+  map<Address, MerkleTree> merkle_trees;
+  MerkleTree& tree =
+      merkle_trees[anti_entropy_peer.anti_entropy_connect_address()];
+  tree.add(key, get_key_digest(key, stored_key_map[key], serializers));
+
+  unsigned leaf = MerkleTree::leaf(key);
+  string serialized = merkle_digest(kMerkleDepth, {leaf}, {0});
+  anti_entropy_handler(serialized, merkle_trees, stored_key_map, wt,
+                       serializers, pushers);
+
+  // the key is gossiped to the peer, which is asked for its keys in the leaf
+  vector<string> messages = get_zmq_messages();
+  EXPECT_EQ(messages.size(), 2);
+
+  KeyRequest gossip;
+  gossip.ParseFromString(messages[0]);
+  EXPECT_EQ(gossip.type(), RequestType::PUT);
+  EXPECT_EQ(gossip.tuples_size(), 1);
+  EXPECT_EQ(gossip.tuples(0).key(), key);
+  EXPECT_EQ(gossip.tuples(0).payload(), serialize(1, "value"));
+
+  MerkleDigest reply;
+  reply.ParseFromString(messages[1]);
+  EXPECT_TRUE(reply.fetch());
+  EXPECT_EQ(reply.level(), kMerkleDepth);
+  EXPECT_EQ(reply.nodes_size(), 1);
+  EXPECT_EQ(reply.nodes(0), leaf);
+}
+
+TEST_F(ServerHandlerTest, AntiEntropyFetch) {
+  Key key = "key";
+  process_put(key, LatticeType::LWW, serialize(1, "value"), lww_serializer,
+              stored_key_map);
+
+  map<Address, MerkleTree> merkle_trees;
+  MerkleTree& tree =
+      merkle_trees[anti_entropy_peer.anti_entropy_connect_address()];
+  tree.add(key, get_key_digest(key, stored_key_map[key], serializers));
+
+  string serialized =
+      merkle_digest(kMerkleDepth, {MerkleTree::leaf(key)}, {0}, true);
+  anti_entropy_handler(serialized, merkle_trees, stored_key_map, wt,
+                       serializers, pushers);
+
+  vector<string> messages = get_zmq_messages();
+  EXPECT_EQ(messages.size(), 1);
+
+  KeyRequest gossip;
+  gossip.ParseFromString(messages[0]);
+  EXPECT_EQ(gossip.tuples_size(), 1);
+  EXPECT_EQ(gossip.tuples(0).key(), key);
+}
+
+TEST_F(ServerHandlerTest, AntiEntropyKeyDigest) {
+  Key key = "key";
+  process_put(key, LatticeType::LWW, serialize(1, "value"), lww_serializer,
+              stored_key_map);
+
+  unsigned long long digest =
+      get_key_digest(key, stored_key_map[key], serializers);
+  EXPECT_EQ(digest, key_digest(key, serialize(1, "value")));
+
+  // a modified key is digested again
+  process_put(key, LatticeType::LWW, serialize(2, "new"), lww_serializer,
+              stored_key_map);
+  EXPECT_EQ(get_key_digest(key, stored_key_map[key], serializers),
+            key_digest(key, serialize(2, "new")));
+}
+
+TEST_F(ServerHandlerTest, AntiEntropyUpdateTrees) {
+  unsigned seed = 0;
+  process_put("a", LatticeType::LWW, serialize(1, "a"), lww_serializer,
+              stored_key_map);
+  process_put("b", LatticeType::LWW, serialize(1, "b"), lww_serializer,
+              stored_key_map);
+
+  map<Address, MerkleTree> merkle_trees;
+  Address peer = anti_entropy_peer.anti_entropy_connect_address();
+  merkle_trees[peer].add("a", 1);
+  merkle_trees[peer].add("b", 2);
+
+  // only changed keys are updated; this thread is now the only replica of
+  // "a", so it is taken out of the peer's tree
+  merkle_changeset.insert("a");
+  update_merkle_trees(seed, global_hash_rings, local_hash_rings,
+                      stored_key_map, key_replication_map, wt, serializers,
+                      pushers, merkle_changeset, merkle_trees);
+
+  EXPECT_EQ(merkle_changeset.size(), 0);
+  EXPECT_EQ(merkle_trees[peer].hash(0, 0), 2);
+
+  // a tree left without keys is dropped
+  merkle_changeset.insert("b");
+  update_merkle_trees(seed, global_hash_rings, local_hash_rings,
+                      stored_key_map, key_replication_map, wt, serializers,
+                      pushers, merkle_changeset, merkle_trees);
+
+  EXPECT_EQ(merkle_trees.size(), 0);
+}
+
+TEST_F(ServerHandlerTest, AntiEntropyRelocateKeys) {
+  unsigned seed = 0;
+  std::deque<Key> merkle_relocations;
+  for (unsigned i = 0; i <= kMerkleRelocationBatch; i++) {
+    Key key = "key" + std::to_string(i);
+    process_put(key, LatticeType::LWW, serialize(1, key), lww_serializer,
+                stored_key_map);
+    merkle_relocations.push_back(key);
+  }
+
+  map<Address, MerkleTree> merkle_trees;
+  Address peer = anti_entropy_peer.anti_entropy_connect_address();
+  merkle_trees[peer].add("key0", 1);
+  merkle_trees[peer].add(merkle_relocations.back(), 2);
+
+  // keys are rechecked a batch at a time; this thread is now the only
+  // replica of each of them, so they are taken out of the peer's tree
+  relocate_merkle_keys(seed, global_hash_rings, local_hash_rings,
+                       stored_key_map, key_replication_map, wt, serializers,
+                       pushers, merkle_relocations, merkle_trees);
+
+  EXPECT_EQ(merkle_relocations.size(), 1);
+  EXPECT_EQ(merkle_trees[peer].hash(0, 0), 2);
+
+  relocate_merkle_keys(seed, global_hash_rings, local_hash_rings,
+                       stored_key_map, key_replication_map, wt, serializers,
+                       pushers, merkle_relocations, merkle_trees);
+
+  EXPECT_EQ(merkle_relocations.size(), 0);
+  EXPECT_EQ(merkle_trees.size(), 0);
+}
@@ -0,0 +1,412 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "kvs/server_utils.hpp"
+
+class EBSLogTest : public ::testing::Test {
+ protected:
+  string directory = "ebs_log_test/";
+  EBSLog* ebs_log;
+  ValueCache value_cache;
+
+  EBSLogTest() { ebs_log = new EBSLog(directory); }
+
+  virtual ~EBSLogTest() {
+    delete ebs_log;
+
+    DIR* dir = opendir(directory.c_str());
+    if (dir != nullptr) {
+      struct dirent* ent;
+      while ((ent = readdir(dir)) != nullptr) {
+        std::remove((directory + ent->d_name).c_str());
+      }
+      closedir(dir);
+    }
+    rmdir(directory.c_str());
+  }
+
+  // simulates a restart of the server thread
+  void reopen(const Codec* codec = nullptr) {
+    delete ebs_log;
+    ebs_log = new EBSLog(directory, codec);
+  }
+};
+
+TEST_F(EBSLogTest, LWWPutGet) {
+  EBSLWWSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+
+  serializer.put("key", serialize(1, "value1"));
+  serializer.put("key", serialize(3, "value3"));
+  serializer.put("key", serialize(2, "value2"));
+
+  EXPECT_EQ(serializer.get("key", error), serialize(3, "value3"));
+  EXPECT_EQ(error, 0);
+
+  // the chain has been replaced by its merged value, which is written by the
+  // next commit
+  vector<string> payloads;
+  EXPECT_TRUE(ebs_log->read("key", payloads));
+  EXPECT_EQ(payloads.size(), 1);
+  EXPECT_TRUE(ebs_log->has_uncommitted());
+
+  reopen();
+  EBSLWWSerializer reopened(ebs_log, &value_cache);
+  EXPECT_EQ(reopened.get("key", error), serialize(3, "value3"));
+  EXPECT_EQ(error, 0);
+}
+
+TEST_F(EBSLogTest, SetPutGet) {
+  EBSSetSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+
+  serializer.put("key", serialize(set<string>({"a", "b"})));
+  serializer.put("key", serialize(set<string>({"b", "c"})));
+
+  SetLattice<string> res = deserialize_set(serializer.get("key", error));
+  EXPECT_EQ(error, 0);
+  EXPECT_EQ(res.reveal(), set<string>({"a", "b", "c"}));
+}
+
+TEST_F(EBSLogTest, GroupCommit) {
+  EBSLWWSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+
+  serializer.put("key", serialize(1, "value1"));
+  serializer.put("key", serialize(2, "value2"));
+  serializer.put("other", serialize(1, "value"));
+
+  // buffered writes are visible before they are committed
+  EXPECT_TRUE(ebs_log->contains("other"));
+  EXPECT_FALSE(ebs_log->logged("other"));
+  EXPECT_TRUE(ebs_log->has_uncommitted());
+
+  // the writes to each key are coalesced into a single record
+  EXPECT_EQ(ebs_log->commit(), 2);
+  EXPECT_TRUE(ebs_log->logged("other"));
+  EXPECT_FALSE(ebs_log->has_uncommitted());
+
+  vector<string> payloads;
+  EXPECT_TRUE(ebs_log->read("key", payloads));
+  EXPECT_EQ(payloads.size(), 1);
+
+  reopen();
+  EBSLWWSerializer reopened(ebs_log, &value_cache);
+  EXPECT_EQ(reopened.get("key", error), serialize(2, "value2"));
+  EXPECT_EQ(reopened.get("other", error), serialize(1, "value"));
+  EXPECT_EQ(error, 0);
+}
+
+TEST_F(EBSLogTest, AsyncCommit) {
+  EBSLWWSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+
+  serializer.put("key", serialize(1, "value"));
+  unsigned ticket = ebs_log->commit_async();
+
+  // the batch is readable while it is being written
+  EXPECT_TRUE(ebs_log->committing());
+  EXPECT_EQ(serializer.get("key", error), serialize(1, "value"));
+
+  vector<unsigned> completed;
+  while (completed.size() == 0) {
+    ebs_log->poll(completed);
+  }
+
+  EXPECT_EQ(completed[0], ticket);
+  EXPECT_FALSE(ebs_log->committing());
+
+  reopen();
+  EBSLWWSerializer reopened(ebs_log, &value_cache);
+  EXPECT_EQ(reopened.get("key", error), serialize(1, "value"));
+  EXPECT_EQ(error, 0);
+}
+
+TEST_F(EBSLogTest, Prefetch) {
+  EBSSetSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+
+  serializer.put("key", serialize(set<string>({"a"})));
+  ebs_log->commit();
+  serializer.put("key", serialize(set<string>({"b"})));
+  ebs_log->commit();
+
+  unsigned ticket = ebs_log->prefetch({"key", "missing"});
+
+  vector<unsigned> completed;
+  while (completed.size() == 0) {
+    ebs_log->poll(completed);
+  }
+  EXPECT_EQ(completed[0], ticket);
+
+  SetLattice<string> res = deserialize_set(serializer.get("key", error));
+  EXPECT_EQ(error, 0);
+  EXPECT_EQ(res.reveal(), set<string>({"a", "b"}));
+
+  serializer.get("missing", error);
+  EXPECT_EQ(error, 1);
+
+  ebs_log->release_prefetch(ticket);
+}
+
+TEST_F(EBSLogTest, CachedGet) {
+  EBSSetSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+
+  serializer.put("key", serialize(set<string>({"a"})));
+
+  // the second read admits the value into the cache
+  serializer.get("key", error);
+  serializer.get("key", error);
+  EXPECT_TRUE(value_cache.contains("key"));
+
+  // PUTs are written through to the cached value
+  serializer.put("key", serialize(set<string>({"b"})));
+  SetLattice<string> res = deserialize_set(serializer.get("key", error));
+  EXPECT_EQ(error, 0);
+  EXPECT_EQ(res.reveal(), set<string>({"a", "b"}));
+  EXPECT_EQ(value_cache.hit_count(), 1);
+
+  serializer.remove("key");
+  EXPECT_FALSE(value_cache.contains("key"));
+}
+
+TEST_F(EBSLogTest, CachedPutSize) {
+  EBSLWWSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+
+  serializer.put("key", serialize(2, "value"));
+  serializer.get("key", error);
+  serializer.get("key", error);
+  unsigned long long size = value_cache.size();
+  EXPECT_GT(size, 0);
+
+  // an older write loses the merge, so the cached value keeps its size
+  serializer.put("key", serialize(1, string(1000, 'x')));
+  EXPECT_EQ(value_cache.size(), size);
+
+  serializer.put("key", serialize(3, "v"));
+  EXPECT_LT(value_cache.size(), size);
+  ebs_log->commit();
+}
+
+TEST_F(EBSLogTest, InternalRead) {
+  EBSSetSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+
+  serializer.put("key", serialize(set<string>({"a"})));
+
+  // reads for the server's own use are neither counted nor cached
+  for (unsigned i = 0; i < 2; i++) {
+    SetLattice<string> res = deserialize_set(serializer.read("key", error));
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(res.reveal(), set<string>({"a"}));
+  }
+
+  EXPECT_FALSE(value_cache.contains("key"));
+  EXPECT_EQ(value_cache.hit_count(), 0);
+  EXPECT_EQ(value_cache.miss_count(), 0);
+
+  serializer.read("missing", error);
+  EXPECT_EQ(error, 1);
+}
+
+TEST_F(EBSLogTest, IncrementRead) {
+  EBSPNCounterSerializer serializer(ebs_log, &value_cache);
+  map<Key, KeyProperty> stored_key_map;
+  map<Key, KeyDelta> local_changeset;
+  unsigned error = 0;
+
+  for (long long amount : {2, -5}) {
+    EXPECT_TRUE(process_increment("key", LatticeType::PNCOUNTER,
+                                  serialize_increment(amount), "replica",
+                                  &serializer, stored_key_map,
+                                  local_changeset));
+  }
+
+  // the count is read back to be incremented without touching the cache
+  EXPECT_FALSE(value_cache.contains("key"));
+  EXPECT_EQ(value_cache.hit_count(), 0);
+  EXPECT_EQ(value_cache.miss_count(), 0);
+
+  EXPECT_EQ(deserialize_pncounter(serializer.read("key", error)).value(), -3);
+  ebs_log->commit();
+}
+
+TEST_F(EBSLogTest, GetEmptyValue) {
+  EBSLWWSerializer lww_serializer(ebs_log, &value_cache);
+  EBSSetSerializer set_serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+
+  lww_serializer.put("lww", serialize(1, ""));
+  lww_serializer.get("lww", error);
+  EXPECT_EQ(error, 1);
+
+  set_serializer.put("empty", serialize(set<string>()));
+  set_serializer.get("empty", error);
+  EXPECT_EQ(error, 1);
+
+  // a set holding the empty string is not empty
+  error = 0;
+  set_serializer.put("set", serialize(set<string>({""})));
+  EXPECT_EQ(set_serializer.get("set", error), serialize(set<string>({""})));
+  EXPECT_EQ(error, 0);
+}
+
+TEST_F(EBSLogTest, GetMissingKey) {
+  EBSLWWSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+
+  EXPECT_EQ(serializer.get("key", error), "");
+  EXPECT_EQ(error, 1);
+}
+
+TEST_F(EBSLogTest, Remove) {
+  EBSLWWSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+
+  serializer.put("key", serialize(1, "value"));
+  serializer.remove("key");
+
+  EXPECT_FALSE(ebs_log->contains("key"));
+  serializer.get("key", error);
+  EXPECT_EQ(error, 1);
+}
+
+TEST_F(EBSLogTest, Recovery) {
+  EBSSetSerializer set_serializer(ebs_log, &value_cache);
+  EBSLWWSerializer lww_serializer(ebs_log, &value_cache);
+  set_serializer.put("set", serialize(set<string>({"a"})));
+  set_serializer.put("set", serialize(set<string>({"b"})));
+  lww_serializer.put("removed", serialize(1, "value"));
+  lww_serializer.remove("removed");
+
+  reopen();
+
+  EXPECT_TRUE(ebs_log->contains("set"));
+  EXPECT_FALSE(ebs_log->contains("removed"));
+  EXPECT_EQ(ebs_log->index().at("set").type_, LatticeType::SET);
+
+  EBSSetSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+  SetLattice<string> res = deserialize_set(serializer.get("set", error));
+  EXPECT_EQ(error, 0);
+  EXPECT_EQ(res.reveal(), set<string>({"a", "b"}));
+}
+
+TEST_F(EBSLogTest, Compaction) {
+  EBSLWWSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+  string large_value(1000 * 1000, 'a');
+
+  // write enough data to seal the first segment, overwriting the same keys
+  for (unsigned i = 0; i < 70; i++) {
+    serializer.put("key" + std::to_string(i % 2), serialize(i, large_value));
+    ebs_log->commit();
+    serializer.get("key" + std::to_string(i % 2), error);
+  }
+  EXPECT_GT(ebs_log->segment_count(), 1);
+
+  // the folded records are synced in the background, and the compacted
+  // segment is only deleted once they are durable
+  unsigned segments = ebs_log->segment_count();
+  while (!ebs_log->committing()) {
+    ebs_log->compact();
+  }
+  EXPECT_EQ(ebs_log->segment_count(), segments);
+
+  vector<unsigned> completed;
+  while (ebs_log->committing()) {
+    ebs_log->poll(completed);
+  }
+  EXPECT_EQ(ebs_log->segment_count(), segments - 1);
+
+  while (ebs_log->segment_count() > 1) {
+    ebs_log->compact();
+    ebs_log->poll(completed);
+  }
+
+  reopen();
+  EBSLWWSerializer reopened(ebs_log, &value_cache);
+  EXPECT_EQ(reopened.get("key0", error), serialize(68, large_value));
+  EXPECT_EQ(reopened.get("key1", error), serialize(69, large_value));
+  EXPECT_EQ(error, 0);
+}
+
+TEST_F(EBSLogTest, Codec) {
+  ZlibCodec codec;
+  string payload(1000, 'a');
+  string compressed;
+  string decompressed;
+
+  EXPECT_TRUE(codec.compress(payload, compressed));
+  EXPECT_LT(compressed.size(), payload.size());
+  EXPECT_TRUE(
+      codec.decompress(compressed.data(), compressed.size(), decompressed));
+  EXPECT_EQ(decompressed, payload);
+
+  // small payloads are not worth compressing
+  EXPECT_FALSE(codec.compress("value", compressed));
+}
+
+TEST_F(EBSLogTest, CompressedValues) {
+  ZlibCodec codec;
+  reopen(&codec);
+
+  EBSLWWSerializer serializer(ebs_log, &value_cache);
+  unsigned error = 0;
+  string value = serialize(1, string(10000, 'a'));
+
+  serializer.put("key", value);
+  serializer.put("small", serialize(1, "value"));
+  ebs_log->commit();
+
+  // the stored size of the key reflects its compressed value
+  EXPECT_LT(ebs_log->size("key"), value.size());
+  EXPECT_EQ(serializer.get("key", error), value);
+
+  reopen(&codec);
+  EBSLWWSerializer reopened(ebs_log, &value_cache);
+  EXPECT_EQ(reopened.get("key", error), value);
+  EXPECT_EQ(reopened.get("small", error), serialize(1, "value"));
+  EXPECT_EQ(error, 0);
+
+  // compressed values are also decoded when read in the background
+  unsigned ticket = ebs_log->prefetch({"key"});
+  vector<unsigned> completed;
+  while (completed.size() == 0) {
+    ebs_log->poll(completed);
+  }
+
+  vector<string> payloads;
+  EXPECT_TRUE(ebs_log->read("key", payloads));
+  EXPECT_EQ(payloads, vector<string>({value}));
+  ebs_log->release_prefetch(ticket);
+}
+
+TEST_F(EBSLogTest, CodecChange) {
+  ZlibCodec codec;
+  reopen(&codec);
+
+  EBSLWWSerializer serializer(ebs_log, &value_cache);
+  string value = serialize(1, string(10000, 'a'));
+  serializer.put("key", value);
+  ebs_log->commit();
+
+  // records compressed before compression was turned off stay readable
+  reopen();
+  vector<string> payloads;
+  EXPECT_TRUE(ebs_log->read("key", payloads));
+  EXPECT_EQ(payloads, vector<string>({value}));
+}
@@ -0,0 +1,164 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "kvs/server_utils.hpp"
+
+TEST_F(ServerHandlerTest, FlatKVStorePutAndGet) {
+  FlatKVStore<LWWPairLattice<string>> store;
+  Key long_key = string(100, 'k');
+
+  store.put("key", LWWPairLattice<string>(TimestampValuePair<string>(1, "a")));
+  store.put(long_key,
+            LWWPairLattice<string>(TimestampValuePair<string>(1, "b")));
+  store.put("", LWWPairLattice<string>(TimestampValuePair<string>(1, "c")));
+
+  // later writes are merged into the stored value
+  store.put("key", LWWPairLattice<string>(TimestampValuePair<string>(2, "d")));
+  store.put("key", LWWPairLattice<string>(TimestampValuePair<string>(0, "e")));
+
+  unsigned error = 0;
+  EXPECT_EQ(store.get("key", error).reveal().value, "d");
+  EXPECT_EQ(store.get(long_key, error).reveal().value, "b");
+  EXPECT_EQ(store.get("", error).reveal().value, "c");
+  EXPECT_EQ(error, 0);
+  EXPECT_EQ(store.size("key"),
+            LWWPairLattice<string>(TimestampValuePair<string>(2, "d"))
+                .size()
+                .reveal());
+  EXPECT_EQ(store.count(), 3);
+
+  store.get("missing", error);
+  EXPECT_EQ(error, 1);
+  EXPECT_FALSE(store.contains("missing"));
+
+  store.remove(long_key);
+  EXPECT_FALSE(store.contains(long_key));
+  EXPECT_EQ(store.count(), 2);
+}
+
+TEST_F(ServerHandlerTest, FlatKVStoreChurn) {
+  FlatKVStore<SetLattice<string>> store;
+  map<Key, string> expected;
+
+  // mix insertions and removals so that the table grows and slots are shifted
+  // back across many probe sequences
+  unsigned seed = 0;
+  for (unsigned i = 0; i < 20000; i++) {
+    Key key = std::to_string(rand_r(&seed) % 5000);
+    if (key.size() % 2 == 0) {
+      key += string(30, 'x');
+    }
+
+    if (rand_r(&seed) % 3 == 0) {
+      store.remove(key);
+      expected.erase(key);
+    } else {
+      string element = std::to_string(i);
+      store.put(key, SetLattice<string>({element}));
+      expected[key] = element;
+    }
+  }
+
+  EXPECT_EQ(store.count(), expected.size());
+
+  for (unsigned i = 0; i < 5000; i++) {
+    for (const Key& key :
+         {std::to_string(i), std::to_string(i) + string(30, 'x')}) {
+      unsigned error = 0;
+      SetLattice<string> value = store.get(key, error);
+
+      auto it = expected.find(key);
+      if (it == expected.end()) {
+        EXPECT_EQ(error, 1);
+      } else {
+        EXPECT_EQ(error, 0);
+        EXPECT_EQ(value.reveal().count(it->second), 1);
+      }
+    }
+  }
+}
+
+TEST_F(ServerHandlerTest, FlatKVStoreSerializedValues) {
+  FlatKVStore<SetLattice<string>> store;
+  store.put("key", SetLattice<string>({"a"}));
+
+  // the serialized form is kept after the second read, and dropped once the
+  // value changes
+  unsigned error = 0;
+  for (unsigned i = 0; i < 3; i++) {
+    EXPECT_EQ(store.borrow("key", error).serialized(),
+              serialize(SetLattice<string>({"a"})));
+  }
+
+  store.put("key", SetLattice<string>({"b"}));
+  SetLattice<string> merged = store.get("key", error);
+  EXPECT_EQ(merged.size().reveal(), 2);
+  EXPECT_EQ(store.borrow("key", error).serialized(), serialize(merged));
+  EXPECT_EQ(error, 0);
+
+  store.remove("key");
+  store.put("key", SetLattice<string>({"c"}));
+  EXPECT_EQ(store.borrow("key", error).serialized(),
+            serialize(SetLattice<string>({"c"})));
+
+  EXPECT_EQ(store.borrow("missing", error).serialized(),
+            serialize(SetLattice<string>()));
+  EXPECT_EQ(error, 1);
+}
+
+TEST_F(ServerHandlerTest, MergeSerialized) {
+  LWWPairLattice<string> lww(TimestampValuePair<string>(2, "b"));
+  merge_serialized(lww, serialize(1, "a"));
+  EXPECT_EQ(lww.reveal().value, "b");
+  merge_serialized(lww, serialize(3, "c"));
+  EXPECT_EQ(lww.reveal().value, "c");
+
+  SetLattice<string> s({"a"});
+  merge_serialized(s, serialize(SetLattice<string>({"b", "c"})));
+  EXPECT_EQ(s.reveal(), set<string>({"a", "b", "c"}));
+
+  typedef VectorClockValuePair<SetLattice<string>> Version;
+  typedef CausalPairLattice<SetLattice<string>> Causal;
+
+  VectorClock clock;
+  clock.insert("a", 1);
+  Causal causal(Version(clock, SetLattice<string>({"1"})));
+  Causal other = causal;
+
+  auto version = [](const VectorClock& vc, const string& element) {
+    return serialize(Causal(Version(vc, SetLattice<string>({element}))));
+  };
+
+  // a dominated version is ignored, a concurrent one is merged, and a
+  // dominating one replaces the value
+  merge_serialized(causal, version(VectorClock(), "0"));
+  EXPECT_EQ(causal.reveal().value.reveal(), set<string>({"1"}));
+
+  VectorClock concurrent;
+  concurrent.insert("b", 1);
+  merge_serialized(causal, version(concurrent, "2"));
+  EXPECT_EQ(causal.reveal().value.reveal(), set<string>({"1", "2"}));
+
+  VectorClock dominating;
+  dominating.insert("a", 2);
+  dominating.insert("b", 2);
+  merge_serialized(causal, version(dominating, "3"));
+  EXPECT_EQ(causal.reveal().value.reveal(), set<string>({"3"}));
+
+  // merging the serialized form agrees with merging the lattice
+  other.merge(Version(concurrent, SetLattice<string>({"2"})));
+  other.merge(Version(dominating, SetLattice<string>({"3"})));
+  EXPECT_EQ(other.reveal().value.reveal(), causal.reveal().value.reveal());
+  EXPECT_EQ(other.reveal().vector_clock, causal.reveal().vector_clock);
+}
@@ -0,0 +1,71 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "kvs/kvs_handlers.hpp"
+
+ServerThreadList gossip_tree_replicas(unsigned count) {
+  ServerThreadList threads;
+  for (unsigned i = 0; i < count; i++) {
+    threads.push_back(ServerThread("127.0.0." + std::to_string(i + 1),
+                                   "127.0.0." + std::to_string(i + 1), 0));
+  }
+  return threads;
+}
+
+TEST(GossipTreeTest, RootChildren) {
+  ServerThreadList threads = gossip_tree_replicas(20);
+  ServerThread root = threads[0];
+
+  ServerThreadList children =
+      tree_gossip_children(threads, root.gossip_connect_address(), root);
+  EXPECT_EQ(children.size(), kTreeGossipFanout);
+}
+
+TEST(GossipTreeTest, EveryReplicaReachedOnce) {
+  ServerThreadList threads = gossip_tree_replicas(30);
+  Address root = threads[7].gossip_connect_address();
+
+  // the replicas may list the threads in any order
+  ServerThreadList shuffled(threads.rbegin(), threads.rend());
+
+  map<string, unsigned> parents;
+  for (const ServerThread& thread : threads) {
+    for (const ServerThread& child :
+         tree_gossip_children(shuffled, root, thread)) {
+      parents[child.id()] += 1;
+    }
+  }
+
+  // every replica but the root has exactly one parent
+  EXPECT_EQ(parents.size(), threads.size() - 1);
+  EXPECT_EQ(parents.find(threads[7].id()), parents.end());
+  for (const auto& pair : parents) {
+    EXPECT_EQ(pair.second, 1);
+  }
+}
+
+TEST(GossipTreeTest, UnknownRoot) {
+  ServerThreadList threads = gossip_tree_replicas(20);
+  ServerThread outsider("127.0.1.1", "127.0.1.1", 0);
+
+  EXPECT_EQ(
+      tree_gossip_children(threads, outsider.gossip_connect_address(),
+                           threads[0])
+          .size(),
+      0);
+  EXPECT_EQ(tree_gossip_children(threads, threads[0].gossip_connect_address(),
+                                 outsider)
+                .size(),
+            0);
+}
@@ -0,0 +1,219 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "kvs/kvs_handlers.hpp"
+
+TEST_F(ServerHandlerTest, KeyIndexInsertAndRemove) {
+  KeyIndex index;
+
+  EXPECT_TRUE(index.insert("key"));
+  EXPECT_TRUE(index.insert("ke"));
+  EXPECT_TRUE(index.insert("keys"));
+  EXPECT_TRUE(index.insert(""));
+  EXPECT_FALSE(index.insert("key"));
+  EXPECT_EQ(index.size(), 4);
+
+  EXPECT_TRUE(index.contains("ke"));
+  EXPECT_TRUE(index.contains(""));
+  EXPECT_FALSE(index.contains("k"));
+  EXPECT_FALSE(index.contains("keyss"));
+
+  EXPECT_TRUE(index.remove("key"));
+  EXPECT_FALSE(index.remove("key"));
+  EXPECT_FALSE(index.contains("key"));
+  EXPECT_TRUE(index.contains("keys"));
+  EXPECT_TRUE(index.contains("ke"));
+  EXPECT_EQ(index.size(), 3);
+}
+
+TEST_F(ServerHandlerTest, KeyIndexScan) {
+  KeyIndex index;
+  ordered_set<Key> expected;
+
+  // enough keys that nodes go through every layout
+  unsigned seed = 0;
+  for (unsigned i = 0; i < 5000; i++) {
+    Key key;
+    unsigned length = rand_r(&seed) % 4 + 1;
+    for (unsigned j = 0; j < length; j++) {
+      key.push_back(static_cast<char>(rand_r(&seed) % 256));
+    }
+
+    EXPECT_EQ(index.insert(key), expected.insert(key).second);
+  }
+  EXPECT_EQ(index.size(), expected.size());
+
+  vector<Key> keys;
+  index.scan("", "", 0, keys);
+  EXPECT_EQ(keys, vector<Key>(expected.begin(), expected.end()));
+
+  Key start = string(1, '\x40');
+  Key end = string(1, '\xa0');
+  keys.clear();
+  index.scan(start, end, 0, keys);
+  EXPECT_EQ(keys, vector<Key>(expected.lower_bound(start),
+                              expected.lower_bound(end)));
+
+  keys.clear();
+  index.scan(start, "", 10, keys);
+  auto it = expected.lower_bound(start);
+  EXPECT_EQ(keys, vector<Key>(it, std::next(it, 10)));
+
+  // remove most of the keys so that nodes shrink back down
+  unsigned count = 0;
+  for (auto key_it = expected.begin(); key_it != expected.end();) {
+    if (count++ % 10 != 0) {
+      EXPECT_TRUE(index.remove(*key_it));
+      key_it = expected.erase(key_it);
+    } else {
+      key_it++;
+    }
+  }
+
+  keys.clear();
+  index.scan("", "", 0, keys);
+  EXPECT_EQ(index.size(), expected.size());
+  EXPECT_EQ(keys, vector<Key>(expected.begin(), expected.end()));
+}
+
+TEST_F(ServerHandlerTest, KeyIndexScanPrefix) {
+  KeyIndex index;
+  index.insert("user");
+  index.insert("user_1");
+  index.insert("user_2");
+  index.insert("users");
+  index.insert("usf");
+  index.insert("apple");
+
+  vector<Key> keys;
+  index.scan_prefix("user_", 0, keys);
+  EXPECT_EQ(keys, vector<Key>({"user_1", "user_2"}));
+
+  keys.clear();
+  index.scan_prefix("user", 0, keys);
+  EXPECT_EQ(keys, vector<Key>({"user", "user_1", "user_2", "users"}));
+
+  keys.clear();
+  index.scan_prefix("user", 2, keys);
+  EXPECT_EQ(keys, vector<Key>({"user", "user_1"}));
+
+  keys.clear();
+  index.scan_prefix("x", 0, keys);
+  EXPECT_EQ(keys.size(), 0);
+
+  EXPECT_EQ(prefix_end("ab"), "ac");
+  EXPECT_EQ(prefix_end("a\xff"), "b");
+  EXPECT_EQ(prefix_end("\xff"), "");
+}
+
+TEST_F(ServerHandlerTest, ScanRequest) {
+  KeyIndex index;
+  SerializerMap indexed_serializers;
+  for (const LatticeType& type : serializers.types()) {
+    indexed_serializers.set(
+        type, new IndexedSerializer(serializers.at(type), &index));
+  }
+
+  process_put("b", LatticeType::LWW, serialize(0, "b"),
+              indexed_serializers.at(LatticeType::LWW), stored_key_map);
+  process_put("a", LatticeType::LWW, serialize(0, "a"),
+              indexed_serializers.at(LatticeType::LWW), stored_key_map);
+  process_put("c", LatticeType::SET, serialize(set<string>({"c"})),
+              indexed_serializers.at(LatticeType::SET), stored_key_map);
+  process_put("d", LatticeType::LWW, serialize(0, "d"),
+              indexed_serializers.at(LatticeType::LWW), stored_key_map);
+  indexed_serializers.at(LatticeType::LWW)->remove("d");
+  stored_key_map.erase("d");
+
+  KeyRequest request;
+  request.set_type(RequestType::SCAN);
+  request.set_response_address(UserThread("127.0.0.1", 0)
+                                   .response_connect_address());
+  request.set_request_id("0");
+  request.add_tuples()->set_key("a");
+  request.set_scan_end("d");
+  request.set_scan_values(true);
+
+  vector<Key> keys;
+  scan_keys(request, index, stored_key_map, keys);
+  scan_request_handler(request, &index, keys, stored_key_map,
+                       indexed_serializers, pushers);
+
+  vector<string> messages = get_zmq_messages();
+  EXPECT_EQ(messages.size(), 1);
+
+  KeyResponse response;
+  response.ParseFromString(messages[0]);
+  EXPECT_EQ(response.response_id(), "0");
+  EXPECT_EQ(response.tuples_size(), 3);
+  EXPECT_EQ(response.tuples(0).key(), "a");
+  EXPECT_EQ(response.tuples(0).payload(), serialize(0, "a"));
+  EXPECT_EQ(response.tuples(1).key(), "b");
+  EXPECT_EQ(response.tuples(2).key(), "c");
+  EXPECT_EQ(response.tuples(2).lattice_type(), LatticeType::SET);
+
+  // threads without an index reject SCANs
+  scan_request_handler(request, nullptr, {}, stored_key_map,
+                       indexed_serializers, pushers);
+  messages = get_zmq_messages();
+  response.ParseFromString(messages[1]);
+  EXPECT_EQ(response.error(), 1);
+
+  for (const LatticeType& type : indexed_serializers.types()) {
+    delete indexed_serializers.at(type);
+  }
+}
+
+TEST_F(ServerHandlerTest, ScanSkipsMetadata) {
+  KeyIndex index;
+  SerializerMap indexed_serializers;
+  for (const LatticeType& type : serializers.types()) {
+    indexed_serializers.set(
+        type, new IndexedSerializer(serializers.at(type), &index));
+  }
+
+  // metadata keys sort before lowercase keys
+  for (const Key& key : {"a", "b", "c"}) {
+    process_put(get_metadata_key(key, MetadataType::replication),
+                LatticeType::LWW, serialize(0, "rf"),
+                indexed_serializers.at(LatticeType::LWW), stored_key_map);
+    process_put(key, LatticeType::LWW, serialize(0, key),
+                indexed_serializers.at(LatticeType::LWW), stored_key_map);
+  }
+
+  KeyRequest request;
+  request.set_type(RequestType::SCAN);
+  request.set_response_address(UserThread("127.0.0.1", 0)
+                                   .response_connect_address());
+  request.set_scan_limit(2);
+
+  // the limit only counts the keys that are returned
+  vector<Key> keys;
+  scan_keys(request, index, stored_key_map, keys);
+  scan_request_handler(request, &index, keys, stored_key_map,
+                       indexed_serializers, pushers);
+
+  vector<string> messages = get_zmq_messages();
+  EXPECT_EQ(messages.size(), 1);
+
+  KeyResponse response;
+  response.ParseFromString(messages[0]);
+  EXPECT_EQ(response.tuples_size(), 2);
+  EXPECT_EQ(response.tuples(0).key(), "a");
+  EXPECT_EQ(response.tuples(1).key(), "b");
+
+  for (const LatticeType& type : indexed_serializers.types()) {
+    delete indexed_serializers.at(type);
+  }
+}
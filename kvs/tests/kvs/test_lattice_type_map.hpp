@@ -0,0 +1,37 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "common.hpp"
+
+TEST(LatticeTypeMapTest, SetAndLookup) {
+  LatticeTypeMap<unsigned> values;
+  values.set(LatticeType::LWW, 1);
+
+  EXPECT_TRUE(values.contains(LatticeType::LWW));
+  EXPECT_EQ(values.at(LatticeType::LWW), 1);
+  EXPECT_EQ(*values.find(LatticeType::LWW), 1);
+
+  // looking up a type that has no value does not give it one
+  EXPECT_EQ(values.at(LatticeType::SET), 0);
+  EXPECT_EQ(values.find(LatticeType::SET), nullptr);
+  EXPECT_FALSE(values.contains(LatticeType::SET));
+
+  // types outside of the enum are never set
+  LatticeType unknown = static_cast<LatticeType>(LatticeType_ARRAYSIZE);
+  values.set(unknown, 2);
+  EXPECT_FALSE(values.contains(unknown));
+  EXPECT_EQ(values.at(unknown), 0);
+
+  EXPECT_EQ(values.types(), vector<LatticeType>{LatticeType::LWW});
+}
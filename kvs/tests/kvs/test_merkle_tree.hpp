@@ -0,0 +1,96 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "kvs/merkle_tree.hpp"
+
+TEST(MerkleTreeTest, KeyDigest) {
+  SetValue forward;
+  forward.add_values("a");
+  forward.add_values("b");
+
+  SetValue backward;
+  backward.add_values("b");
+  backward.add_values("a");
+
+  string forward_serialized, backward_serialized;
+  forward.SerializeToString(&forward_serialized);
+  backward.SerializeToString(&backward_serialized);
+
+  // the same set serialized in a different order has the same digest
+  EXPECT_EQ(key_digest("key", forward_serialized),
+            key_digest("key", backward_serialized));
+
+  EXPECT_NE(key_digest("key", forward_serialized),
+            key_digest("other", forward_serialized));
+  EXPECT_NE(key_digest("key", serialize(1, "a")),
+            key_digest("key", serialize(2, "a")));
+}
+
+TEST(MerkleTreeTest, Add) {
+  MerkleTree tree;
+  tree.add("key", 5);
+
+  unsigned leaf = MerkleTree::leaf("key");
+  EXPECT_EQ(tree.hash(0, 0), 5);
+  EXPECT_EQ(tree.hash(kMerkleDepth, leaf), 5);
+  EXPECT_EQ(tree.hash(1, leaf / (MerkleTree::width(kMerkleDepth - 1))), 5);
+  EXPECT_EQ(tree.keys(leaf), vector<Key>{"key"});
+
+  // nodes that do not exist hash to 0
+  EXPECT_EQ(tree.hash(kMerkleDepth + 1, 0), 0);
+  EXPECT_EQ(tree.hash(0, 1), 0);
+}
+
+TEST(MerkleTreeTest, OrderIndependence) {
+  MerkleTree tree;
+  tree.add("a", 1);
+  tree.add("b", 2);
+
+  MerkleTree other;
+  other.add("b", 2);
+  other.add("a", 1);
+
+  for (unsigned level = 0; level <= kMerkleDepth; level++) {
+    for (unsigned node = 0; node < MerkleTree::width(level); node++) {
+      EXPECT_EQ(tree.hash(level, node), other.hash(level, node));
+    }
+  }
+}
+
+TEST(MerkleTreeTest, UpdateAndRemove) {
+  MerkleTree tree;
+  tree.add("a", 1);
+  tree.add("b", 2);
+
+  // adding a key again replaces its digest
+  tree.add("a", 3);
+  EXPECT_EQ(tree.hash(0, 0), 5);
+
+  unsigned long long digest = 0;
+  EXPECT_TRUE(tree.find("a", digest));
+  EXPECT_EQ(digest, 3);
+  EXPECT_FALSE(tree.find("missing", digest));
+  EXPECT_EQ(tree.hash(kMerkleDepth, MerkleTree::leaf("a")),
+            MerkleTree::leaf("a") == MerkleTree::leaf("b") ? 5 : 3);
+
+  tree.remove("a");
+  tree.remove("missing");
+  EXPECT_EQ(tree.hash(0, 0), 2);
+  EXPECT_EQ(tree.keys(MerkleTree::leaf("a")).size(),
+            MerkleTree::leaf("a") == MerkleTree::leaf("b") ? 1 : 0);
+
+  tree.remove("b");
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.hash(0, 0), 0);
+}
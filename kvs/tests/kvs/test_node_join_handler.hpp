@@ -59,3 +59,49 @@ TEST_F(ServerHandlerTest, DuplicateNodeJoin) {
   EXPECT_EQ(global_hash_rings[kMemoryTierId].size(), 3000);
   EXPECT_EQ(global_hash_rings[kMemoryTierId].get_unique_servers().size(), 1);
 }
+
+TEST_F(ServerHandlerTest, RejoinFromSnapshot) {
+  unsigned seed = 0;
+  set<Key> join_remove_set;
+  AddressKeysetMap join_gossip_map;
+  unsigned long long snapshot_time = get_time() + 2 * kSnapshotClockSkew;
+
+  stored_key_map["old"].modified_ = snapshot_time - 2 * kSnapshotClockSkew;
+  stored_key_map["new"].modified_ = snapshot_time;
+  stored_key_map["moved"].modified_ = snapshot_time - 2 * kSnapshotClockSkew;
+  key_replication_map["moved"].changed_ = snapshot_time;
+
+  // only the keys that changed since the snapshot began, or whose replicas
+  // did, are sent to the rejoining node
+  string serialized = std::to_string(kMemoryTierId) + ":" + ip + ":" + ip +
+                      ":1:" + std::to_string(snapshot_time);
+  node_join_handler(thread_id, seed, ip, ip, log_, serialized,
+                    global_hash_rings, local_hash_rings, stored_key_map,
+                    key_replication_map, join_remove_set, pushers, wt,
+                    join_gossip_map, 0);
+
+  EXPECT_EQ(join_gossip_map.size(), 1);
+  EXPECT_EQ(join_gossip_map.begin()->second, set<Key>({"new", "moved"}));
+  EXPECT_EQ(join_remove_set.size(), 0);
+}
+
+TEST_F(ServerHandlerTest, RejoinAfterRingChange) {
+  unsigned seed = 0;
+  set<Key> join_remove_set;
+  AddressKeysetMap join_gossip_map;
+  unsigned long long snapshot_time = get_time();
+
+  stored_key_map["old"].modified_ = snapshot_time - 2 * kSnapshotClockSkew;
+
+  // the ring changed after the snapshot began, so keys may have moved to the
+  // rejoining node since and are all sent
+  string serialized = std::to_string(kMemoryTierId) + ":" + ip + ":" + ip +
+                      ":1:" + std::to_string(snapshot_time);
+  node_join_handler(thread_id, seed, ip, ip, log_, serialized,
+                    global_hash_rings, local_hash_rings, stored_key_map,
+                    key_replication_map, join_remove_set, pushers, wt,
+                    join_gossip_map, 0);
+
+  EXPECT_EQ(join_gossip_map.size(), 1);
+  EXPECT_EQ(join_gossip_map.begin()->second, set<Key>({"old"}));
+}
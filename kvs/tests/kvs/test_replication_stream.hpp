@@ -0,0 +1,296 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "kvs/kvs_handlers.hpp"
+
+KeyRequest gossip_request(Key key, string payload) {
+  KeyRequest request;
+  request.set_type(RequestType::PUT);
+  prepare_put_tuple(request, key, LatticeType::LWW, payload);
+  return request;
+}
+
+TEST(ReplicationStreamTest, AppendAndAck) {
+  ReplicationStream stream;
+  unsigned long long first = stream.next();
+  unsigned long long epoch = stream.epoch();
+
+  stream.append(gossip_request("a", serialize(1, "a")), "ack", 0);
+  stream.append(gossip_request("b", serialize(1, "b")), "ack", 0);
+  EXPECT_EQ(stream.size(), 2);
+
+  // batches are sent one at a time
+  KeyRequest sent;
+  sent.ParseFromString(stream.send(0, nullptr));
+  EXPECT_EQ(sent.sequence(), first);
+  EXPECT_EQ(sent.first(), first);
+  EXPECT_EQ(sent.ack_address(), "ack");
+  EXPECT_EQ(sent.epoch(), epoch);
+  EXPECT_TRUE(stream.has_unsent());
+
+  sent.ParseFromString(stream.send(0, nullptr));
+  EXPECT_EQ(sent.sequence(), first + 1);
+  EXPECT_FALSE(stream.has_unsent());
+  EXPECT_EQ(stream.send(0, nullptr), "");
+
+  stream.ack(epoch, first + 1, 0);
+  EXPECT_EQ(stream.size(), 1);
+  EXPECT_EQ(stream.first(), first + 1);
+
+  // acknowledgements of an earlier stream are ignored
+  stream.ack(epoch - 1, first + 2, 0);
+  EXPECT_EQ(stream.size(), 1);
+
+  stream.ack(epoch, first + 2, 0);
+  EXPECT_EQ(stream.size(), 0);
+  EXPECT_EQ(stream.first(), first + 2);
+}
+
+TEST(ReplicationStreamTest, Resend) {
+  ReplicationStream stream;
+  unsigned long long first = stream.next();
+  stream.append(gossip_request("a", serialize(1, "a")), "ack", 0);
+  stream.append(gossip_request("b", serialize(1, "b")), "ack", 0);
+  stream.send(0, nullptr);
+  stream.send(10, nullptr);
+
+  EXPECT_FALSE(stream.has_due(kReplicationResendTimeout - 1));
+  EXPECT_EQ(stream.send(kReplicationResendTimeout - 1, nullptr), "");
+
+  // only the batch that has waited long enough is sent again
+  EXPECT_TRUE(stream.has_due(kReplicationResendTimeout));
+  KeyRequest resent;
+  resent.ParseFromString(stream.send(kReplicationResendTimeout, nullptr));
+  EXPECT_EQ(resent.sequence(), first);
+  EXPECT_EQ(resent.tuples(0).key(), "a");
+  EXPECT_EQ(stream.send(kReplicationResendTimeout, nullptr), "");
+
+  // overdue batches are sent again one at a time, oldest first, ahead of
+  // those that have not been sent yet
+  stream.append(gossip_request("c", serialize(1, "c")), "ack", 0);
+  unsigned long long later = 3 * kReplicationResendTimeout;
+  resent.ParseFromString(stream.send(later, nullptr));
+  EXPECT_EQ(resent.sequence(), first);
+  resent.ParseFromString(stream.send(later, nullptr));
+  EXPECT_EQ(resent.sequence(), first + 1);
+  resent.ParseFromString(stream.send(later, nullptr));
+  EXPECT_EQ(resent.sequence(), first + 2);
+  EXPECT_FALSE(stream.has_due(later));
+
+  EXPECT_FALSE(stream.stalled(kReplicationStreamTimeout - 1));
+  EXPECT_TRUE(stream.stalled(kReplicationStreamTimeout));
+}
+
+TEST(ReplicationStreamTest, Overflow) {
+  ReplicationStream stream(1);
+  unsigned long long first = stream.next();
+  stream.append(gossip_request("a", serialize(1, "a")), "ack", 0);
+  stream.append(gossip_request("b", serialize(1, "b")), "ack", 0);
+
+  // the oldest batch is dropped, and its keys have to be sent whole
+  EXPECT_EQ(stream.size(), 1);
+  EXPECT_EQ(stream.first(), first + 1);
+  EXPECT_EQ(stream.take_lost_keys(), set<Key>({"a"}));
+  EXPECT_EQ(stream.take_lost_keys().size(), 0);
+}
+
+TEST(ReplicationStreamTest, Batches) {
+  string value(kMaxGossipBatchBytes / 2, 'x');
+
+  KeyRequest request;
+  request.set_type(RequestType::PUT);
+  for (const Key& key : {"a", "b", "c"}) {
+    prepare_put_tuple(request, key, LatticeType::LWW, serialize(1, value));
+  }
+
+  // no two of the values fit in a batch together
+  vector<KeyRequest> batches = split_gossip(request);
+  EXPECT_EQ(batches.size(), 3);
+  for (const KeyRequest& batch : batches) {
+    EXPECT_EQ(batch.type(), RequestType::PUT);
+    EXPECT_EQ(batch.tuples_size(), 1);
+    EXPECT_LE(batch.ByteSizeLong(), kMaxGossipBatchBytes);
+  }
+
+  KeyRequest small;
+  small.set_type(RequestType::PUT);
+  for (const Key& key : {"a", "b", "c"}) {
+    prepare_put_tuple(small, key, LatticeType::LWW, serialize(1, "a"));
+  }
+  EXPECT_EQ(split_gossip(small).size(), 1);
+}
+
+TEST(ReplicationStreamTest, Compression) {
+  ZlibCodec codec;
+  ReplicationStream stream;
+  stream.append(gossip_request("a", serialize(1, string(10000, 'x'))), "ack",
+                0);
+
+  string serialized = stream.send(0, &codec);
+  EXPECT_LT(serialized.size(), 10000);
+
+  KeyRequest sent;
+  sent.ParseFromString(serialized);
+  EXPECT_EQ(sent.tuples_size(), 0);
+  EXPECT_EQ(sent.codec(), codec.id());
+
+  // a resend reuses the compressed batch
+  EXPECT_EQ(stream.send(kReplicationResendTimeout, &codec), serialized);
+}
+
+TEST_F(ServerHandlerTest, GossipCompressed) {
+  unsigned seed = 0;
+  map<Address, ReplicationOffset> gossip_offsets;
+  string value(10000, 'x');
+
+  ZlibCodec codec;
+  ReplicationStream stream;
+  stream.append(gossip_request("key", serialize(1, value)), "ack", 0);
+  string serialized = stream.send(0, &codec);
+
+  gossip_handler(seed, serialized, global_hash_rings, local_hash_rings,
+                 pending_gossip, stored_key_map, key_replication_map,
+                 merkle_changeset, gossip_offsets, replication_streams, wt,
+                 serializers, pushers, log_);
+
+  EXPECT_EQ(process_get("key", lww_serializer).first, serialize(1, value));
+  EXPECT_EQ(merkle_changeset.count("key"), 1);
+  EXPECT_EQ(gossip_offsets["ack"].epoch_, stream.epoch());
+  EXPECT_EQ(gossip_offsets["ack"].next_, stream.next());
+}
+
+TEST_F(ServerHandlerTest, PacedGossip) {
+  GossipStatistics stats;
+  map<Address, KeyRequest> gossip_map;
+  gossip_map["replica"] = gossip_request("a", serialize(1, "a"));
+  prepare_put_tuple(gossip_map["replica"], "b", LatticeType::LWW,
+                    serialize(1, string(kMaxGossipBatchBytes, 'x')));
+
+  queue_replicated_gossip(gossip_map, replication_streams, wt);
+  EXPECT_EQ(get_zmq_messages().size(), 0);
+
+  // each replica is sent one batch at a time
+  EXPECT_TRUE(send_paced_gossip(replication_streams, pushers, nullptr, stats));
+  EXPECT_EQ(get_zmq_messages().size(), 1);
+  EXPECT_FALSE(
+      send_paced_gossip(replication_streams, pushers, nullptr, stats));
+  EXPECT_EQ(get_zmq_messages().size(), 2);
+
+  EXPECT_EQ(stats.batch_count_, 2);
+  EXPECT_EQ(stats.bytes_, get_zmq_messages()[0].size() +
+                              get_zmq_messages()[1].size());
+  EXPECT_EQ(stats.max_batch_bytes_, get_zmq_messages()[1].size());
+}
+
+string sequenced_gossip(Key key, string payload, unsigned long long sequence,
+                        unsigned long long first,
+                        unsigned long long epoch = 1) {
+  KeyRequest request = gossip_request(key, payload);
+  request.set_sequence(sequence);
+  request.set_first(first);
+  request.set_ack_address("ack");
+  request.set_epoch(epoch);
+
+  string serialized;
+  request.SerializeToString(&serialized);
+  return serialized;
+}
+
+TEST_F(ServerHandlerTest, GossipInOrder) {
+  unsigned seed = 0;
+  map<Address, ReplicationOffset> gossip_offsets;
+
+  string serialized = sequenced_gossip("key", serialize(1, "a"), 5, 5);
+  gossip_handler(seed, serialized, global_hash_rings, local_hash_rings,
+                 pending_gossip, stored_key_map, key_replication_map,
+                 merkle_changeset, gossip_offsets, replication_streams, wt,
+                 serializers, pushers, log_);
+
+  EXPECT_EQ(gossip_offsets["ack"].next_, 6);
+  EXPECT_EQ(process_get("key", lww_serializer).first, serialize(1, "a"));
+
+  vector<string> messages = get_zmq_messages();
+  EXPECT_EQ(messages.size(), 1);
+
+  ReplicationAck ack;
+  ack.ParseFromString(messages[0]);
+  EXPECT_EQ(ack.address(), wt.gossip_connect_address());
+  EXPECT_EQ(ack.next(), 6);
+  EXPECT_EQ(ack.epoch(), 1);
+
+  // a duplicate is acknowledged but not applied again
+  serialized = sequenced_gossip("key", serialize(2, "b"), 5, 5);
+  gossip_handler(seed, serialized, global_hash_rings, local_hash_rings,
+                 pending_gossip, stored_key_map, key_replication_map,
+                 merkle_changeset, gossip_offsets, replication_streams, wt,
+                 serializers, pushers, log_);
+
+  EXPECT_EQ(gossip_offsets["ack"].next_, 6);
+  EXPECT_EQ(process_get("key", lww_serializer).first, serialize(1, "a"));
+  EXPECT_EQ(get_zmq_messages().size(), 2);
+}
+
+TEST_F(ServerHandlerTest, GossipOutOfOrder) {
+  unsigned seed = 0;
+  map<Address, ReplicationOffset> gossip_offsets;
+  gossip_offsets["ack"].epoch_ = 1;
+  gossip_offsets["ack"].next_ = 5;
+
+  // message 5 was lost, so 6 is dropped until 5 is resent
+  string serialized = sequenced_gossip("key", serialize(2, "b"), 6, 5);
+  gossip_handler(seed, serialized, global_hash_rings, local_hash_rings,
+                 pending_gossip, stored_key_map, key_replication_map,
+                 merkle_changeset, gossip_offsets, replication_streams, wt,
+                 serializers, pushers, log_);
+
+  EXPECT_EQ(gossip_offsets["ack"].next_, 5);
+  EXPECT_EQ(stored_key_map.find("key"), stored_key_map.end());
+
+  ReplicationAck ack;
+  ack.ParseFromString(get_zmq_messages()[0]);
+  EXPECT_EQ(ack.next(), 5);
+
+  // once the sender no longer has message 5, the receiver skips ahead
+  serialized = sequenced_gossip("key", serialize(2, "b"), 6, 6);
+  gossip_handler(seed, serialized, global_hash_rings, local_hash_rings,
+                 pending_gossip, stored_key_map, key_replication_map,
+                 merkle_changeset, gossip_offsets, replication_streams, wt,
+                 serializers, pushers, log_);
+
+  EXPECT_EQ(gossip_offsets["ack"].next_, 7);
+  EXPECT_EQ(process_get("key", lww_serializer).first, serialize(2, "b"));
+}
+
+TEST_F(ServerHandlerTest, GossipNewEpoch) {
+  unsigned seed = 0;
+  map<Address, ReplicationOffset> gossip_offsets;
+  gossip_offsets["ack"].epoch_ = 1;
+  gossip_offsets["ack"].next_ = 5;
+
+  // the sender restarted and numbers its new stream from 0 again
+  string serialized = sequenced_gossip("key", serialize(1, "a"), 0, 0, 2);
+  gossip_handler(seed, serialized, global_hash_rings, local_hash_rings,
+                 pending_gossip, stored_key_map, key_replication_map,
+                 merkle_changeset, gossip_offsets, replication_streams, wt,
+                 serializers, pushers, log_);
+
+  EXPECT_EQ(gossip_offsets["ack"].epoch_, 2);
+  EXPECT_EQ(gossip_offsets["ack"].next_, 1);
+  EXPECT_EQ(process_get("key", lww_serializer).first, serialize(1, "a"));
+
+  ReplicationAck ack;
+  ack.ParseFromString(get_zmq_messages()[0]);
+  EXPECT_EQ(ack.next(), 1);
+  EXPECT_EQ(ack.epoch(), 2);
+}
@@ -0,0 +1,107 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "kvs/kvs_handlers.hpp"
+
+TEST_F(ServerHandlerTest, SnapshotAndLoad) {
+  string path = "snapshot_test";
+  process_put("lww", LatticeType::LWW, serialize(1, "value"), lww_serializer,
+              stored_key_map);
+  process_put("set", LatticeType::SET, serialize(set<string>({"a", "b"})),
+              set_serializer, stored_key_map);
+  key_replication_map["lww"].global_replication_[kMemoryTierId] = 2;
+  key_replication_map["lww"].local_replication_[kMemoryTierId] = 1;
+
+  {
+    Snapshotter snapshotter(path, 0);
+    while (Snapshotter::timestamp(path) == 0) {
+      snapshotter.advance(serializers, stored_key_map, key_replication_map);
+    }
+  }
+
+  // load the snapshot into a fresh set of stores
+  MemoryLWWKVS lww_kvs;
+  MemorySetKVS set_kvs;
+  MemoryLWWSerializer lww_serializer(&lww_kvs);
+  MemorySetSerializer set_serializer(&set_kvs);
+  SerializerMap loaded_serializers;
+  loaded_serializers.set(LatticeType::LWW, &lww_serializer);
+  loaded_serializers.set(LatticeType::SET, &set_serializer);
+
+  map<Key, KeyProperty> loaded_key_map;
+  map<Key, KeyReplication> loaded_replication_map;
+  unsigned long long time = Snapshotter::load(
+      path, loaded_serializers, loaded_key_map, loaded_replication_map);
+  std::remove(path.c_str());
+
+  EXPECT_GT(time, 0);
+  EXPECT_EQ(loaded_key_map.size(), 2);
+  EXPECT_EQ(loaded_key_map["set"].type_, LatticeType::SET);
+  EXPECT_EQ(loaded_key_map["set"].modified_, time);
+
+  unsigned error = 0;
+  EXPECT_EQ(lww_serializer.get("lww", error), serialize(1, "value"));
+  EXPECT_EQ(deserialize_set(set_serializer.get("set", error)).reveal(),
+            set<string>({"a", "b"}));
+  EXPECT_EQ(error, 0);
+
+  EXPECT_EQ(loaded_replication_map.size(), 1);
+  EXPECT_EQ(loaded_replication_map["lww"], key_replication_map["lww"]);
+}
+
+TEST_F(ServerHandlerTest, LoadMissingSnapshot) {
+  EXPECT_EQ(Snapshotter::load("missing_snapshot", serializers, stored_key_map,
+                              key_replication_map),
+            0);
+  EXPECT_EQ(stored_key_map.size(), 0);
+}
+
+TEST_F(ServerHandlerTest, SnapshotInChunks) {
+  string path = "snapshot_chunks_test";
+  unsigned key_count = kSnapshotBudget * 5 / 2;
+  for (unsigned i = 0; i < key_count; i++) {
+    process_put("key" + std::to_string(i), LatticeType::LWW,
+                serialize(1, std::to_string(i)), lww_serializer,
+                stored_key_map);
+  }
+
+  // the snapshot takes several calls, each of which writes out a chunk
+  {
+    Snapshotter snapshotter(path, 0);
+    snapshotter.advance(serializers, stored_key_map, key_replication_map);
+    EXPECT_EQ(Snapshotter::timestamp(path), 0);
+
+    while (Snapshotter::timestamp(path) == 0) {
+      snapshotter.advance(serializers, stored_key_map, key_replication_map);
+    }
+  }
+
+  MemoryLWWKVS lww_kvs;
+  MemoryLWWSerializer lww_serializer(&lww_kvs);
+  SerializerMap loaded_serializers;
+  loaded_serializers.set(LatticeType::LWW, &lww_serializer);
+
+  map<Key, KeyProperty> loaded_key_map;
+  map<Key, KeyReplication> loaded_replication_map;
+  EXPECT_GT(Snapshotter::load(path, loaded_serializers, loaded_key_map,
+                              loaded_replication_map),
+            0);
+  std::remove(path.c_str());
+
+  EXPECT_EQ(loaded_key_map.size(), key_count);
+
+  unsigned error = 0;
+  EXPECT_EQ(lww_serializer.get("key1234", error), serialize(1, "1234"));
+  EXPECT_EQ(error, 0);
+}
@@ -17,7 +17,7 @@
 TEST_F(ServerHandlerTest, UserGetLWWTest) {
   Key key = "key";
   string value = "value";
-  serializers[LatticeType::LWW]->put(key, serialize(0, value));
+  serializers.at(LatticeType::LWW)->put(key, serialize(0, value));
   stored_key_map[key].type_ = LatticeType::LWW;
 
   string get_request = get_key_request(key, ip);
@@ -30,7 +30,7 @@ TEST_F(ServerHandlerTest, UserGetLWWTest) {
   user_request_handler(access_count, seed, get_request, log_, global_hash_rings,
                        local_hash_rings, pending_requests, key_access_tracker,
                        stored_key_map, key_replication_map, local_changeset, wt,
-                       serializers, pushers);
+                       serializers, pushers, uncommitted_responses);
 
   vector<string> messages = get_zmq_messages();
   EXPECT_EQ(messages.size(), 1);
@@ -58,7 +58,7 @@ TEST_F(ServerHandlerTest, UserGetSetTest) {
   s.emplace("value1");
   s.emplace("value2");
   s.emplace("value3");
-  serializers[LatticeType::SET]->put(key, serialize(SetLattice<string>(s)));
+  serializers.at(LatticeType::SET)->put(key, serialize(SetLattice<string>(s)));
   stored_key_map[key].type_ = LatticeType::SET;
 
   string get_request = get_key_request(key, ip);
@@ -71,7 +71,7 @@ TEST_F(ServerHandlerTest, UserGetSetTest) {
   user_request_handler(access_count, seed, get_request, log_, global_hash_rings,
                        local_hash_rings, pending_requests, key_access_tracker,
                        stored_key_map, key_replication_map, local_changeset, wt,
-                       serializers, pushers);
+                       serializers, pushers, uncommitted_responses);
 
   vector<string> messages = get_zmq_messages();
   EXPECT_EQ(messages.size(), 1);
@@ -85,7 +85,8 @@ TEST_F(ServerHandlerTest, UserGetSetTest) {
   KeyTuple rtp = response.tuples(0);
 
   EXPECT_EQ(rtp.key(), key);
-  EXPECT_EQ(rtp.payload(), serialize(SetLattice<string>(s)));
+  // sets are unordered, so their serialized elements may come in any order
+  EXPECT_EQ(deserialize_set(rtp.payload()).reveal(), s);
   EXPECT_EQ(rtp.error(), 0);
 
   EXPECT_EQ(local_changeset.size(), 0);
@@ -99,7 +100,7 @@ TEST_F(ServerHandlerTest, UserGetOrderedSetTest) {
   s.emplace("value1");
   s.emplace("value2");
   s.emplace("value3");
-  serializers[LatticeType::ORDERED_SET]->put(
+  serializers.at(LatticeType::ORDERED_SET)->put(
       key, serialize(OrderedSetLattice<string>(s)));
   stored_key_map[key].type_ = LatticeType::ORDERED_SET;
 
@@ -113,7 +114,7 @@ TEST_F(ServerHandlerTest, UserGetOrderedSetTest) {
   user_request_handler(access_count, seed, get_request, log_, global_hash_rings,
                        local_hash_rings, pending_requests, key_access_tracker,
                        stored_key_map, key_replication_map, local_changeset, wt,
-                       serializers, pushers);
+                       serializers, pushers, uncommitted_responses);
 
   vector<string> messages = get_zmq_messages();
   EXPECT_EQ(messages.size(), 1);
@@ -144,7 +145,7 @@ TEST_F(ServerHandlerTest, UserGetCausalTest) {
   p.value.insert("value2");
   p.value.insert("value3");
 
-  serializers[LatticeType::CAUSAL]->put(
+  serializers.at(LatticeType::CAUSAL)->put(
       key, serialize(CausalPairLattice<SetLattice<string>>(p)));
   stored_key_map[key].type_ = LatticeType::CAUSAL;
 
@@ -158,7 +159,7 @@ TEST_F(ServerHandlerTest, UserGetCausalTest) {
   user_request_handler(access_count, seed, get_request, log_, global_hash_rings,
                        local_hash_rings, pending_requests, key_access_tracker,
                        stored_key_map, key_replication_map, local_changeset, wt,
-                       serializers, pushers);
+                       serializers, pushers, uncommitted_responses);
 
   vector<string> messages = get_zmq_messages();
   EXPECT_EQ(messages.size(), 1);
@@ -210,6 +211,119 @@ TEST_F(ServerHandlerTest, UserGetCausalTest) {
   EXPECT_EQ(key_access_tracker[key].size(), 1);
 }
 
+TEST_F(ServerHandlerTest, UserIncrementAndGetCounterTest) {
+  Key key = "key";
+  unsigned access_count = 0;
+  unsigned seed = 0;
+
+  // an increment made at another replica arrives by gossip
+  PNCounterLattice remote;
+  remote.increment("remote", 10);
+  process_put(key, LatticeType::PNCOUNTER, serialize(remote),
+              serializers.at(LatticeType::PNCOUNTER), stored_key_map);
+
+  vector<long long> amounts = {5, -2};
+  for (long long amount : amounts) {
+    string increment_request =
+        increment_key_request(key, LatticeType::PNCOUNTER, amount, ip);
+    user_request_handler(access_count, seed, increment_request, log_,
+                         global_hash_rings, local_hash_rings, pending_requests,
+                         key_access_tracker, stored_key_map,
+                         key_replication_map, local_changeset, wt, serializers,
+                         pushers, uncommitted_responses);
+  }
+
+  // an INCREMENT of a key that is not a counter is rejected
+  string bad_request = increment_key_request(key, LatticeType::LWW, 1, ip);
+  user_request_handler(access_count, seed, bad_request, log_,
+                       global_hash_rings, local_hash_rings, pending_requests,
+                       key_access_tracker, stored_key_map, key_replication_map,
+                       local_changeset, wt, serializers, pushers,
+                       uncommitted_responses);
+
+  string get_request = get_key_request(key, ip);
+  user_request_handler(access_count, seed, get_request, log_, global_hash_rings,
+                       local_hash_rings, pending_requests, key_access_tracker,
+                       stored_key_map, key_replication_map, local_changeset, wt,
+                       serializers, pushers, uncommitted_responses);
+
+  vector<string> messages = get_zmq_messages();
+  EXPECT_EQ(messages.size(), 4);
+
+  KeyResponse response;
+  response.ParseFromString(messages[0]);
+  EXPECT_EQ(response.type(), RequestType::INCREMENT);
+  EXPECT_EQ(response.tuples(0).error(), 0);
+  EXPECT_EQ(response.tuples(0).lattice_type(), LatticeType::PNCOUNTER);
+
+  response.ParseFromString(messages[2]);
+  EXPECT_EQ(response.type(), RequestType::INCREMENT);
+  EXPECT_EQ(response.tuples(0).error(), 3);
+
+  response.ParseFromString(messages[3]);
+  KeyTuple rtp = response.tuples(0);
+  EXPECT_EQ(rtp.error(), 0);
+  EXPECT_EQ(rtp.lattice_type(), LatticeType::PNCOUNTER);
+
+  PNCounterLattice counter = deserialize_pncounter(rtp.payload());
+  EXPECT_EQ(counter.value(), 13);
+  EXPECT_EQ(counter.reveal().increments.count(wt.id()), 5);
+  EXPECT_EQ(counter.reveal().decrements.count(wt.id()), 2);
+
+  EXPECT_EQ(stored_key_map[key].type_, LatticeType::PNCOUNTER);
+  EXPECT_EQ(local_changeset.size(), 1);
+  EXPECT_EQ(access_count, 4);
+}
+
+TEST_F(ServerHandlerTest, UserPutDeltaGossipTest) {
+  Key key = "key";
+  Address replica = "tcp://127.0.0.2:6560";
+  unsigned access_count = 0;
+  unsigned seed = 0;
+
+  // the key's existing value arrived before the last round of gossip
+  process_put(key, LatticeType::SET, serialize(set<string>({"a", "b"})),
+              serializers.at(LatticeType::SET), stored_key_map);
+
+  vector<string> values = {"c", "d"};
+  for (const string& value : values) {
+    string put_request = put_key_request(
+        key, LatticeType::SET, serialize(set<string>({value})), ip);
+    user_request_handler(access_count, seed, put_request, log_,
+                         global_hash_rings, local_hash_rings, pending_requests,
+                         key_access_tracker, stored_key_map,
+                         key_replication_map, local_changeset, wt, serializers,
+                         pushers, uncommitted_responses);
+  }
+
+  EXPECT_EQ(local_changeset[key].payloads_.size(), 2);
+
+  // only the changes are gossiped
+  AddressKeysetMap addr_keyset_map;
+  addr_keyset_map[replica].insert(key);
+  map<Address, KeyRequest> gossip_map;
+  prepare_delta_gossip(addr_keyset_map, serializers, stored_key_map,
+                       local_changeset, gossip_map);
+
+  KeyRequest gossip = gossip_map[replica];
+  EXPECT_EQ(gossip.tuples_size(), 1);
+  EXPECT_EQ(gossip.tuples(0).lattice_type(), LatticeType::SET);
+  EXPECT_EQ(deserialize_set(gossip.tuples(0).payload()).reveal(),
+            set<string>({"c", "d"}));
+
+  // changes that are too large to keep are replaced by the whole value
+  track_delta(local_changeset[key], string(kMaxGossipDeltaBytes, 'x'));
+  EXPECT_TRUE(local_changeset[key].full_);
+  EXPECT_EQ(local_changeset[key].payloads_.size(), 0);
+
+  gossip_map.clear();
+  prepare_delta_gossip(addr_keyset_map, serializers, stored_key_map,
+                       local_changeset, gossip_map);
+  gossip = gossip_map[replica];
+  EXPECT_EQ(deserialize_set(gossip.tuples(0).payload()).reveal(),
+            set<string>({"a", "b", "c", "d"}));
+}
+
 TEST_F(ServerHandlerTest, UserPutAndGetLWWTest) {
   Key key = "key";
   string value = "value";
@@ -224,7 +338,7 @@ TEST_F(ServerHandlerTest, UserPutAndGetLWWTest) {
   user_request_handler(access_count, seed, put_request, log_, global_hash_rings,
                        local_hash_rings, pending_requests, key_access_tracker,
                        stored_key_map, key_replication_map, local_changeset, wt,
-                       serializers, pushers);
+                       serializers, pushers, uncommitted_responses);
 
   vector<string> messages = get_zmq_messages();
   EXPECT_EQ(messages.size(), 1);
@@ -249,7 +363,7 @@ TEST_F(ServerHandlerTest, UserPutAndGetLWWTest) {
   user_request_handler(access_count, seed, get_request, log_, global_hash_rings,
                        local_hash_rings, pending_requests, key_access_tracker,
                        stored_key_map, key_replication_map, local_changeset, wt,
-                       serializers, pushers);
+                       serializers, pushers, uncommitted_responses);
 
   messages = get_zmq_messages();
   EXPECT_EQ(messages.size(), 2);
@@ -270,6 +384,42 @@ TEST_F(ServerHandlerTest, UserPutAndGetLWWTest) {
   EXPECT_EQ(key_access_tracker[key].size(), 2);
 }
 
+TEST_F(ServerHandlerTest, UserPutEbsTest) {
+  kSelfTierId = kEbsTierId;
+
+  Key key = "key";
+  string value = "value";
+  string put_request =
+      put_key_request(key, LatticeType::LWW, serialize(0, value), ip);
+
+  unsigned access_count = 0;
+  unsigned seed = 0;
+
+  user_request_handler(access_count, seed, put_request, log_, global_hash_rings,
+                       local_hash_rings, pending_requests, key_access_tracker,
+                       stored_key_map, key_replication_map, local_changeset, wt,
+                       serializers, pushers, uncommitted_responses);
+
+  // the response is held back until the write has been committed
+  vector<string> messages = get_zmq_messages();
+  EXPECT_EQ(messages.size(), 0);
+
+  Address response_address = UserThread(ip, 0).response_connect_address();
+  EXPECT_EQ(uncommitted_responses.size(), 1);
+  EXPECT_EQ(uncommitted_responses[response_address].size(), 1);
+
+  KeyResponse response;
+  response.ParseFromString(uncommitted_responses[response_address][0]);
+
+  EXPECT_EQ(response.response_id(), kRequestId);
+  EXPECT_EQ(response.tuples().size(), 1);
+  EXPECT_EQ(response.tuples(0).key(), key);
+  EXPECT_EQ(response.tuples(0).error(), 0);
+
+  EXPECT_EQ(local_changeset.size(), 1);
+  EXPECT_EQ(access_count, 1);
+}
+
 TEST_F(ServerHandlerTest, UserPutAndGetSetTest) {
   Key key = "key";
   set<string> s;
@@ -287,7 +437,7 @@ TEST_F(ServerHandlerTest, UserPutAndGetSetTest) {
   user_request_handler(access_count, seed, put_request, log_, global_hash_rings,
                        local_hash_rings, pending_requests, key_access_tracker,
                        stored_key_map, key_replication_map, local_changeset, wt,
-                       serializers, pushers);
+                       serializers, pushers, uncommitted_responses);
 
   vector<string> messages = get_zmq_messages();
   EXPECT_EQ(messages.size(), 1);
@@ -312,7 +462,7 @@ TEST_F(ServerHandlerTest, UserPutAndGetSetTest) {
   user_request_handler(access_count, seed, get_request, log_, global_hash_rings,
                        local_hash_rings, pending_requests, key_access_tracker,
                        stored_key_map, key_replication_map, local_changeset, wt,
-                       serializers, pushers);
+                       serializers, pushers, uncommitted_responses);
 
   messages = get_zmq_messages();
   EXPECT_EQ(messages.size(), 2);
@@ -325,7 +475,8 @@ TEST_F(ServerHandlerTest, UserPutAndGetSetTest) {
   rtp = response.tuples(0);
 
   EXPECT_EQ(rtp.key(), key);
-  EXPECT_EQ(rtp.payload(), serialize(SetLattice<string>(s)));
+  // sets are unordered, so their serialized elements may come in any order
+  EXPECT_EQ(deserialize_set(rtp.payload()).reveal(), s);
   EXPECT_EQ(rtp.error(), 0);
 
   EXPECT_EQ(local_changeset.size(), 1);
@@ -350,7 +501,7 @@ TEST_F(ServerHandlerTest, UserPutAndGetOrderedSetTest) {
   user_request_handler(access_count, seed, put_request, log_, global_hash_rings,
                        local_hash_rings, pending_requests, key_access_tracker,
                        stored_key_map, key_replication_map, local_changeset, wt,
-                       serializers, pushers);
+                       serializers, pushers, uncommitted_responses);
 
   vector<string> messages = get_zmq_messages();
   EXPECT_EQ(messages.size(), 1);
@@ -375,7 +526,7 @@ TEST_F(ServerHandlerTest, UserPutAndGetOrderedSetTest) {
   user_request_handler(access_count, seed, get_request, log_, global_hash_rings,
                        local_hash_rings, pending_requests, key_access_tracker,
                        stored_key_map, key_replication_map, local_changeset, wt,
-                       serializers, pushers);
+                       serializers, pushers, uncommitted_responses);
 
   messages = get_zmq_messages();
   EXPECT_EQ(messages.size(), 2);
@@ -388,7 +539,9 @@ TEST_F(ServerHandlerTest, UserPutAndGetOrderedSetTest) {
   rtp = response.tuples(0);
 
   EXPECT_EQ(rtp.key(), key);
-  EXPECT_EQ(rtp.payload(), serialize(OrderedSetLattice<string>(s)));
+  // ordered sets stored as sets may come back in any order
+  EXPECT_EQ(deserialize_set(rtp.payload()).reveal(),
+            set<string>(s.begin(), s.end()));
   EXPECT_EQ(rtp.error(), 0);
 
   EXPECT_EQ(local_changeset.size(), 1);
@@ -416,7 +569,7 @@ TEST_F(ServerHandlerTest, UserPutAndGetCausalTest) {
   user_request_handler(access_count, seed, put_request, log_, global_hash_rings,
                        local_hash_rings, pending_requests, key_access_tracker,
                        stored_key_map, key_replication_map, local_changeset, wt,
-                       serializers, pushers);
+                       serializers, pushers, uncommitted_responses);
 
   vector<string> messages = get_zmq_messages();
   EXPECT_EQ(messages.size(), 1);
@@ -441,7 +594,7 @@ TEST_F(ServerHandlerTest, UserPutAndGetCausalTest) {
   user_request_handler(access_count, seed, get_request, log_, global_hash_rings,
                        local_hash_rings, pending_requests, key_access_tracker,
                        stored_key_map, key_replication_map, local_changeset, wt,
-                       serializers, pushers);
+                       serializers, pushers, uncommitted_responses);
 
   messages = get_zmq_messages();
   EXPECT_EQ(messages.size(), 2);
@@ -495,3 +648,42 @@ TEST_F(ServerHandlerTest, UserPutAndGetCausalTest) {
 // TODO: Test key address cache invalidation
 // TODO: Test replication factor request and making the request pending
 // TODO: Test metadata operations -- does this matter?
+
+TEST_F(ServerHandlerTest, UserBulkPutTest) {
+  KeyRequest request;
+  request.set_type(RequestType::PUT);
+  request.set_response_address(UserThread(ip, 0).response_connect_address());
+  request.set_request_id(kRequestId);
+  request.set_bulk(true);
+
+  for (unsigned i = 0; i < 3; i++) {
+    KeyTuple* tp = request.add_tuples();
+    tp->set_key("key" + std::to_string(i));
+    tp->set_lattice_type(LatticeType::LWW);
+    tp->set_payload(serialize(i, "value"));
+  }
+
+  string request_str;
+  request.SerializeToString(&request_str);
+
+  unsigned access_count = 0;
+  unsigned seed = 0;
+  user_request_handler(access_count, seed, request_str, log_, global_hash_rings,
+                       local_hash_rings, pending_requests, key_access_tracker,
+                       stored_key_map, key_replication_map, local_changeset, wt,
+                       serializers, pushers, uncommitted_responses);
+
+  // the response only reports tuples that were not applied
+  vector<string> messages = get_zmq_messages();
+  EXPECT_EQ(messages.size(), 1);
+
+  KeyResponse response;
+  response.ParseFromString(messages[0]);
+  EXPECT_EQ(response.response_id(), kRequestId);
+  EXPECT_EQ(response.tuples_size(), 0);
+
+  EXPECT_EQ(stored_key_map.size(), 3);
+  EXPECT_EQ(local_changeset.size(), 3);
+  EXPECT_EQ(key_access_tracker.size(), 0);
+  EXPECT_EQ(access_count, 3);
+}
@@ -0,0 +1,67 @@
+//  Copyright 2018 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "kvs/value_cache.hpp"
+
+TEST(ValueCacheTest, Admission) {
+  ValueCache cache;
+
+  // a key is only admitted on its second miss
+  EXPECT_FALSE(cache.admit("key"));
+  EXPECT_TRUE(cache.admit("key"));
+  EXPECT_FALSE(cache.admit("other"));
+}
+
+TEST(ValueCacheTest, GetAndCounts) {
+  ValueCache cache;
+  cache.insert("key", LatticeType::LWW, deserialize_lww(serialize(1, "a")), 10);
+
+  LWWPairLattice<string>* value =
+      cache.get<LWWPairLattice<string>>("key", LatticeType::LWW);
+  EXPECT_NE(value, nullptr);
+  EXPECT_EQ(value->reveal().value, "a");
+
+  EXPECT_EQ(cache.get<LWWPairLattice<string>>("missing", LatticeType::LWW),
+            nullptr);
+  EXPECT_EQ(cache.get<SetLattice<string>>("key", LatticeType::SET), nullptr);
+
+  EXPECT_EQ(cache.hit_count(), 1);
+  EXPECT_EQ(cache.miss_count(), 2);
+
+  cache.reset_counts();
+  EXPECT_EQ(cache.hit_count(), 0);
+  EXPECT_EQ(cache.miss_count(), 0);
+}
+
+TEST(ValueCacheTest, Eviction) {
+  ValueCache cache(25);
+  cache.insert("a", LatticeType::LWW, deserialize_lww(serialize(1, "a")), 10);
+  cache.insert("b", LatticeType::LWW, deserialize_lww(serialize(1, "b")), 10);
+
+  // using a makes b the least recently used key
+  cache.get<LWWPairLattice<string>>("a", LatticeType::LWW);
+  cache.insert("c", LatticeType::LWW, deserialize_lww(serialize(1, "c")), 10);
+
+  EXPECT_TRUE(cache.contains("a"));
+  EXPECT_FALSE(cache.contains("b"));
+  EXPECT_TRUE(cache.contains("c"));
+  EXPECT_EQ(cache.size(), 20);
+
+  cache.resize("c", 20);
+  EXPECT_FALSE(cache.contains("a"));
+  EXPECT_EQ(cache.size(), 20);
+
+  cache.resize("c", 5);
+  EXPECT_EQ(cache.size(), 5);
+}
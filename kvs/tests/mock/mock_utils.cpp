@@ -18,6 +18,11 @@ void MockZmqUtil::send_string(const string& s, zmq::socket_t* socket) {
   sent_messages.push_back(s);
 }
 
+void MockZmqUtil::send_message(zmq::message_t& message,
+                               zmq::socket_t* socket) {
+  sent_messages.push_back(message_to_string(message));
+}
+
 string MockZmqUtil::recv_string(zmq::socket_t* socket) { return ""; }
 
 int MockZmqUtil::poll(long timeout, vector<zmq::pollitem_t>* items) {
@@ -23,6 +23,7 @@ class MockZmqUtil : public ZmqUtilInterface {
   vector<string> sent_messages;
 
   virtual void send_string(const string& s, zmq::socket_t* socket);
+  virtual void send_message(zmq::message_t& message, zmq::socket_t* socket);
   virtual string recv_string(zmq::socket_t* socket);
   virtual int poll(long timeout, vector<zmq::pollitem_t>* items);
 };
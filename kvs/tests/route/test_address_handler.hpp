@@ -50,3 +50,67 @@ TEST_F(RoutingHandlerTest, Address) {
     }
   }
 }
+
+TEST_F(RoutingHandlerTest, BatchAddress) {
+  unsigned seed = 0;
+
+  KeyAddressRequest req;
+  req.set_request_id("1");
+  req.set_response_address("tcp://127.0.0.1:5000");
+  req.add_keys("key");
+  req.add_keys("other");
+
+  string serialized;
+  req.SerializeToString(&serialized);
+
+  address_handler(log_, serialized, pushers, rt, global_hash_rings,
+                  local_hash_rings, key_replication_map, pending_requests,
+                  seed);
+
+  vector<string> messages = get_zmq_messages();
+  EXPECT_EQ(messages.size(), 1);
+
+  KeyAddressResponse resp;
+  resp.ParseFromString(messages[0]);
+
+  EXPECT_EQ(resp.response_id(), "1");
+  EXPECT_EQ(resp.error(), 0);
+  EXPECT_EQ(resp.addresses_size(), 2);
+  EXPECT_EQ(pending_requests.size(), 0);
+}
+
+TEST_F(RoutingHandlerTest, AllThreadsAddress) {
+  unsigned seed = 0;
+
+  local_hash_rings[kMemoryTierId].insert(ip, ip, 0, 0);
+  local_hash_rings[kMemoryTierId].insert(ip, ip, 0, 1);
+
+  KeyAddressRequest req;
+  req.set_request_id("1");
+  req.set_response_address("tcp://127.0.0.1:5000");
+  req.set_all_threads(true);
+
+  string serialized;
+  req.SerializeToString(&serialized);
+
+  address_handler(log_, serialized, pushers, rt, global_hash_rings,
+                  local_hash_rings, key_replication_map, pending_requests,
+                  seed);
+
+  vector<string> messages = get_zmq_messages();
+  EXPECT_EQ(messages.size(), 1);
+
+  KeyAddressResponse resp;
+  resp.ParseFromString(messages[0]);
+
+  EXPECT_EQ(resp.error(), 0);
+  EXPECT_EQ(resp.addresses_size(), 1);
+
+  set<string> ips(resp.addresses(0).ips().begin(),
+                  resp.addresses(0).ips().end());
+  EXPECT_EQ(ips.size(), 2);
+  EXPECT_EQ(ips.count(ServerThread(ip, ip, 0).key_request_connect_address()),
+            1);
+  EXPECT_EQ(ips.count(ServerThread(ip, ip, 1).key_request_connect_address()),
+            1);
+}
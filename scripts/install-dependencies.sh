@@ -71,11 +71,11 @@ fi
 
 
 if [ "$DIST" = "debian" ]; then
-  echo -e "Installing the following packages via $PKG_MGR:\n\t* autoconf\n\t* automake\n\t* libtool\n\t* build-essential \n\t* unzip \n\t* pkg-config\n\t* wget\n\t* make\n\t* libc++-dev\n\t* libc++abi-dev"
-  sudo $PKG_MGR install -y build-essential autoconf automake libtool unzip pkg-config wget make libc++-dev libc++abi-dev > /dev/null
+  echo -e "Installing the following packages via $PKG_MGR:\n\t* autoconf\n\t* automake\n\t* libtool\n\t* build-essential \n\t* unzip \n\t* pkg-config\n\t* wget\n\t* make\n\t* libc++-dev\n\t* libc++abi-dev\n\t* zlib1g-dev"
+  sudo $PKG_MGR install -y build-essential autoconf automake libtool unzip pkg-config wget make libc++-dev libc++abi-dev zlib1g-dev > /dev/null
 elif [ "$DIST" = "fedora" ]; then
-  echo -e "Installing the following packages via $PKG_MGR:\n\t* autoconf\n\t* automake\n\t* libtool\n\t* build-essential \n\t* make"
-  sudo $PKG_MGR install -y build-essential autoconf automake libtool make > /dev/null
+  echo -e "Installing the following packages via $PKG_MGR:\n\t* autoconf\n\t* automake\n\t* libtool\n\t* build-essential \n\t* make\n\t* zlib-devel"
+  sudo $PKG_MGR install -y build-essential autoconf automake libtool make zlib-devel > /dev/null
 else
   exit 1
 fi